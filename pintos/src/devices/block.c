@@ -20,6 +20,8 @@ struct block
 
     unsigned long long read_cnt;        /* Number of sectors read. */
     unsigned long long write_cnt;       /* Number of sectors written. */
+    block_sector_t head;                /* Sector after the last access. */
+    unsigned long long seek_distance;   /* Total sectors skipped over. */
   };
 
 /* List of all block devices. */
@@ -40,6 +42,14 @@ long long fs_num_writes (void)
   return fs_device->write_cnt;
 }
 
+/* Returns the total distance, in sectors, that the file system
+   device's head has moved between accesses.  A run of accesses to
+   consecutive sectors adds nothing. */
+long long fs_seek_distance (void) 
+{
+  return fs_device->seek_distance;
+}
+
 /* Returns a human-readable name for the given block device
    TYPE. */
 const char *
@@ -124,6 +134,15 @@ check_sector (struct block *block, block_sector_t sector)
     }
 }
 
+/* Records an access to SECTOR in BLOCK's seek trace. */
+static void
+trace_seek (struct block *block, block_sector_t sector)
+{
+  block->seek_distance += (sector > block->head
+                           ? sector - block->head : block->head - sector);
+  block->head = sector + 1;
+}
+
 /* Reads sector SECTOR from BLOCK into BUFFER, which must
    have room for BLOCK_SECTOR_SIZE bytes.
    Internally synchronizes accesses to block devices, so external
@@ -134,6 +153,7 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
   check_sector (block, sector);
   block->ops->read (block->aux, sector, buffer);
   block->read_cnt++;
+  trace_seek (block, sector);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -148,6 +168,7 @@ block_write (struct block *block, block_sector_t sector, const void *buffer)
   ASSERT (block->type != BLOCK_FOREIGN);
   block->ops->write (block->aux, sector, buffer);
   block->write_cnt++;
+  trace_seek (block, sector);
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -211,6 +232,8 @@ block_register (const char *name, enum block_type type,
   block->aux = aux;
   block->read_cnt = 0;
   block->write_cnt = 0;
+  block->head = 0;
+  block->seek_distance = 0;
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
@@ -59,6 +59,7 @@ enum block_type block_type (struct block *);
 /* File system. */
 long long fs_num_reads (void); 
 long long fs_num_writes (void);
+long long fs_seek_distance (void);
 
 /* Statistics. */
 void block_print_stats (void);
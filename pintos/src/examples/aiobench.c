@@ -0,0 +1,119 @@
+/* aiobench.c
+
+   Runs a read-then-compute pipeline over a file twice: once with
+   pread(), which leaves the process idle while each block comes
+   off the disk, and once with aio_read(), which starts reading the
+   next block before computing on the current one so that the disk
+   and the processor work at the same time.  The cache is emptied
+   before each pass.  Reports cycles per block for each and checks
+   that both computed the same checksum.
+
+   Usage: aiobench [BLOCKS [WORK]] (defaults 64 and 20).  WORK
+   scales the computation done on each block. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Bytes per block. */
+#define BLOCK 4096
+
+/* Returns the processor's time-stamp counter. */
+static long long
+rdtsc (void)
+{
+  long long tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* The compute stage: mixes BUF into SUM, WORK times over. */
+static unsigned
+compute (const unsigned char *buf, int work, unsigned sum)
+{
+  int i, j;
+
+  for (i = 0; i < work; i++)
+    for (j = 0; j < BLOCK; j++)
+      sum = sum * 31 + buf[j] + i;
+  return sum;
+}
+
+/* Runs the pipeline over BLOCKS blocks of FD, with aio_read() if
+   USE_AIO is true and with pread() otherwise, and prints the cost.
+   Returns the checksum, or 0 if a read failed. */
+static unsigned
+run (int fd, bool use_aio, int blocks, int work)
+{
+  static unsigned char bufs[2][BLOCK];
+  unsigned sum = 1;
+  long long tsc;
+  int i, id = -1;
+
+  reset_cache ();
+  tsc = rdtsc ();
+  if (use_aio)
+    id = aio_read (fd, bufs[0], BLOCK, 0);
+  for (i = 0; i < blocks; i++)
+    {
+      unsigned char *buf = bufs[i % 2];
+
+      if (!use_aio)
+        {
+          if (pread (fd, buf, BLOCK, i * BLOCK) != BLOCK)
+            return 0;
+        }
+      else
+        {
+          if (aio_wait (id) != BLOCK)
+            return 0;
+          if (i + 1 < blocks)
+            id = aio_read (fd, bufs[(i + 1) % 2], BLOCK, (i + 1) * BLOCK);
+        }
+      sum = compute (buf, work, sum);
+    }
+  tsc = rdtsc () - tsc;
+
+  printf ("%-6s %lld cycles/block (checksum %08x)\n",
+          use_aio ? "aio" : "pread", tsc / blocks, sum);
+  return sum;
+}
+
+int
+main (int argc, char *argv[])
+{
+  static unsigned char block[BLOCK];
+  int blocks = argc > 1 ? atoi (argv[1]) : 64;
+  int work = argc > 2 ? atoi (argv[2]) : 20;
+  unsigned sync_sum;
+  int fd, i, j;
+
+  if (blocks < 1)
+    blocks = 64;
+  if (!create ("aiobench.dat", 0) || (fd = open ("aiobench.dat")) < 0)
+    {
+      printf ("aiobench.dat: setup failed\n");
+      return EXIT_FAILURE;
+    }
+  for (i = 0; i < blocks; i++)
+    {
+      for (j = 0; j < BLOCK; j++)
+        block[j] = i * 7 + j / 3;
+      if (write (fd, block, BLOCK) != BLOCK)
+        {
+          printf ("aiobench.dat: write failed\n");
+          return EXIT_FAILURE;
+        }
+    }
+
+  sync_sum = run (fd, false, blocks, work);
+  if (sync_sum == 0 || run (fd, true, blocks, work) != sync_sum)
+    {
+      printf ("aiobench.dat: pipelines disagree\n");
+      return EXIT_FAILURE;
+    }
+  close (fd);
+  remove ("aiobench.dat");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,108 @@
+/* argbench.c
+
+   Measures the cost of system calls dominated by copying their
+   arguments in from user memory: practice() and a one-byte pread(),
+   whose one and four argument words are copied in, and open(),
+   close(), create() and remove() with a short and a long path,
+   whose path strings are copied in as well.  Reports cycles per
+   call for each.
+
+   Usage: argbench [CALLS] (default 2000). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Returns the processor's time-stamp counter. */
+static long long
+rdtsc (void)
+{
+  long long tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Prints the cycles per call of CALLS calls that took TSC cycles. */
+static void
+report (const char *what, long long tsc, int calls)
+{
+  printf ("%-28s %8lld cycles/call\n", what, tsc / calls);
+}
+
+/* Times CALLS opens and closes of PATH, then CALLS creates and
+   removes of PATH, labelled with LABEL. */
+static void
+time_paths (const char *label, const char *path, int calls)
+{
+  char what[64];
+  long long tsc;
+  int i;
+
+  if (!create (path, 0))
+    {
+      printf ("%s: create failed\n", path);
+      exit (EXIT_FAILURE);
+    }
+  tsc = rdtsc ();
+  for (i = 0; i < calls; i++)
+    close (open (path));
+  snprintf (what, sizeof what, "open+close, %s path", label);
+  report (what, rdtsc () - tsc, calls);
+  remove (path);
+
+  tsc = rdtsc ();
+  for (i = 0; i < calls; i++)
+    {
+      create (path, 0);
+      remove (path);
+    }
+  snprintf (what, sizeof what, "create+remove, %s path", label);
+  report (what, rdtsc () - tsc, calls);
+}
+
+int
+main (int argc, char *argv[])
+{
+  int calls = argc > 1 ? atoi (argv[1]) : 2000;
+  char long_path[256];
+  long long tsc;
+  char byte;
+  int fd, i;
+
+  if (calls < 1)
+    calls = 2000;
+
+  tsc = rdtsc ();
+  for (i = 0; i < calls; i++)
+    practice (i);
+  report ("practice (1 argument)", rdtsc () - tsc, calls);
+
+  if (!create ("argbench.dat", 1) || (fd = open ("argbench.dat")) < 0)
+    {
+      printf ("argbench.dat: create failed\n");
+      return EXIT_FAILURE;
+    }
+  tsc = rdtsc ();
+  for (i = 0; i < calls; i++)
+    pread (fd, &byte, 1, 0);
+  report ("pread (4 arguments)", rdtsc () - tsc, calls);
+  close (fd);
+  remove ("argbench.dat");
+
+  /* A path longer than the kernel's small string buffers. */
+  if (!mkdir ("argbench.d"))
+    {
+      printf ("argbench.d: mkdir failed\n");
+      return EXIT_FAILURE;
+    }
+  strlcpy (long_path, "argbench.d", sizeof long_path);
+  for (i = 0; i < 80; i++)
+    strlcat (long_path, "/.", sizeof long_path);
+  strlcat (long_path, "/file", sizeof long_path);
+
+  time_paths ("short", "argbench.f", calls);
+  time_paths ("long", long_path, calls);
+  remove ("argbench.d");
+  return EXIT_SUCCESS;
+}
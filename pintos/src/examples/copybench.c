@@ -0,0 +1,140 @@
+/* copybench.c
+
+   Compares copying a large file through a user buffer, with read()
+   and write(), against copying it inside the kernel with
+   copy_file_range().  Writes a source file of KB kilobytes, copies
+   it each way and reports the system calls, cycles and device
+   reads and writes each copy took, then checks both copies.
+
+   Usage: copybench [KB] (default 256). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Bytes per read() and write() in the user-buffer copy, as cp used. */
+#define CHUNK 1024
+
+/* Returns the processor's time-stamp counter. */
+static long long
+rdtsc (void)
+{
+  long long tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Returns the byte expected at offset OFS of the source file. */
+static char
+expected (int ofs)
+{
+  return ofs * 13 + ofs / 509;
+}
+
+/* Copies SIZE bytes of "copybench.src" to NAME, in the kernel if
+   IN_KERNEL is true, and prints the cost.  Returns false on
+   failure. */
+static bool
+run (const char *name, int size, bool in_kernel)
+{
+  static char buffer[CHUNK];
+  long long tsc, reads, writes;
+  int in_fd, out_fd, done, calls = 0;
+
+  if (!create (name, 0) || (out_fd = open (name)) < 0
+      || (in_fd = open ("copybench.src")) < 0)
+    return false;
+
+  reset_cache ();
+  reads = number_device_reads ();
+  writes = number_device_writes ();
+  tsc = rdtsc ();
+  for (done = 0; done < size; )
+    {
+      int n;
+
+      if (in_kernel)
+        {
+          n = copy_file_range (in_fd, out_fd, size - done);
+          calls++;
+        }
+      else
+        {
+          n = read (in_fd, buffer, CHUNK);
+          if (n > 0 && write (out_fd, buffer, n) != n)
+            n = -1;
+          calls += 2;
+        }
+      if (n <= 0)
+        return false;
+      done += n;
+    }
+  reset_cache ();
+  tsc = rdtsc () - tsc;
+  reads = number_device_reads () - reads;
+  writes = number_device_writes () - writes;
+  close (in_fd);
+  close (out_fd);
+
+  printf ("%-16s %d syscalls, %lld kcycles, %lld device reads, "
+          "%lld device writes\n",
+          in_kernel ? "copy_file_range" : "read+write", calls,
+          tsc / 1000, reads, writes);
+  return true;
+}
+
+/* Returns true if NAME holds SIZE bytes matching the source. */
+static bool
+check (const char *name, int size)
+{
+  static char buffer[CHUNK];
+  int fd, ofs, i, n;
+  bool ok = true;
+
+  if ((fd = open (name)) < 0 || filesize (fd) != size)
+    return false;
+  for (ofs = 0; ok && ofs < size; ofs += n)
+    {
+      n = read (fd, buffer, CHUNK);
+      ok = n > 0;
+      for (i = 0; ok && i < n; i++)
+        ok = buffer[i] == expected (ofs + i);
+    }
+  close (fd);
+  remove (name);
+  return ok;
+}
+
+int
+main (int argc, char *argv[])
+{
+  static char buffer[CHUNK];
+  int size = (argc > 1 ? atoi (argv[1]) : 256) * 1024;
+  int fd, ofs, i;
+
+  if (size <= 0)
+    size = 256 * 1024;
+  if (!create ("copybench.src", 0) || (fd = open ("copybench.src")) < 0)
+    {
+      printf ("copybench.src: create failed\n");
+      return EXIT_FAILURE;
+    }
+  for (ofs = 0; ofs < size; ofs += CHUNK)
+    {
+      for (i = 0; i < CHUNK; i++)
+        buffer[i] = expected (ofs + i);
+      write (fd, buffer, CHUNK);
+    }
+  close (fd);
+
+  if (!run ("copybench.rw", size, false) || !check ("copybench.rw", size)
+      || !run ("copybench.cfr", size, true)
+      || !check ("copybench.cfr", size))
+    {
+      printf ("copybench: copy failed\n");
+      return EXIT_FAILURE;
+    }
+  remove ("copybench.src");
+  return EXIT_SUCCESS;
+}
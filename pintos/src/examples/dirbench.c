@@ -0,0 +1,95 @@
+/* dirbench.c
+
+   Measures how the cost of creating and looking up files grows
+   with the size of the directory holding them.  For each size,
+   makes a directory, creates that many files in it, then opens
+   and closes every one of them, and reports the average cycles
+   and cache accesses per create and per lookup.
+
+   Usage: dirbench [MAX] (default 1024).  Sizes run from 16 up to
+   MAX, doubling each time. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+/* Returns the processor's time-stamp counter. */
+static long long
+rdtsc (void)
+{
+  long long tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+static void
+file_name (char *name, size_t size, int dir_size, int file)
+{
+  snprintf (name, size, "d%d/f%d", dir_size, file);
+}
+
+int
+main (int argc, char *argv[])
+{
+  int max = argc > 1 ? atoi (argv[1]) : 1024;
+  char name[32];
+  int n, i;
+
+  printf ("%8s %14s %14s %14s %14s\n", "entries", "create cycles",
+          "create access", "lookup cycles", "lookup access");
+  for (n = 16; n <= max; n *= 2)
+    {
+      long long create_tsc, create_acc, lookup_tsc, lookup_acc;
+
+      snprintf (name, sizeof name, "d%d", n);
+      if (!mkdir (name))
+        {
+          printf ("%s: mkdir failed\n", name);
+          return EXIT_FAILURE;
+        }
+
+      create_acc = number_cache_accesses ();
+      create_tsc = rdtsc ();
+      for (i = 0; i < n; i++)
+        {
+          file_name (name, sizeof name, n, i);
+          if (!create (name, 0))
+            {
+              printf ("%s: create failed\n", name);
+              return EXIT_FAILURE;
+            }
+        }
+      create_tsc = rdtsc () - create_tsc;
+      create_acc = number_cache_accesses () - create_acc;
+
+      lookup_acc = number_cache_accesses ();
+      lookup_tsc = rdtsc ();
+      for (i = 0; i < n; i++)
+        {
+          int fd;
+
+          file_name (name, sizeof name, n, i);
+          fd = open (name);
+          if (fd < 0)
+            {
+              printf ("%s: open failed\n", name);
+              return EXIT_FAILURE;
+            }
+          close (fd);
+        }
+      lookup_tsc = rdtsc () - lookup_tsc;
+      lookup_acc = number_cache_accesses () - lookup_acc;
+
+      printf ("%8d %14lld %14lld %14lld %14lld\n", n,
+              create_tsc / n, create_acc / n, lookup_tsc / n, lookup_acc / n);
+
+      for (i = 0; i < n; i++)
+        {
+          file_name (name, sizeof name, n, i);
+          remove (name);
+        }
+      snprintf (name, sizeof name, "d%d", n);
+      remove (name);
+    }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,117 @@
+/* dirconc.c
+
+   Runs several processes against one shared directory at once
+   and reports how long they take, to measure how well directory
+   operations proceed concurrently.  The lookup workload has every
+   process open and close files that already exist; the mixed
+   workload has half of them do that while the other half create
+   new files in the same directory.
+
+   Usage: dirconc [PROCS [OPS]] (defaults 4 and 200).
+   The program runs itself as "dirconc lookup|create ID OPS" for
+   each worker process. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Files created in the shared directory for lookups. */
+#define LOOKUP_FILES 32
+
+/* Returns the processor's time-stamp counter. */
+static long long
+rdtsc (void)
+{
+  long long tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Worker: performs OPS lookups or creates as process ID. */
+static int
+worker (const char *op, int id, int ops)
+{
+  char name[32];
+  int i;
+
+  for (i = 0; i < ops; i++)
+    if (!strcmp (op, "create"))
+      {
+        snprintf (name, sizeof name, "shared/c%d-%d", id, i);
+        if (!create (name, 0))
+          return EXIT_FAILURE;
+      }
+    else
+      {
+        int fd;
+
+        snprintf (name, sizeof name, "shared/f%d",
+                  (id * 7 + i) % LOOKUP_FILES);
+        fd = open (name);
+        if (fd < 0)
+          return EXIT_FAILURE;
+        close (fd);
+      }
+  return EXIT_SUCCESS;
+}
+
+/* Runs PROCS workers doing OPS operations each, the first
+   CREATORS of them creating files and the rest looking them up,
+   and prints how long they took in all. */
+static void
+run (const char *title, int procs, int creators, int ops)
+{
+  pid_t pids[64];
+  char cmd[64];
+  long long tsc;
+  int i, failed = 0;
+
+  tsc = rdtsc ();
+  for (i = 0; i < procs; i++)
+    {
+      snprintf (cmd, sizeof cmd, "dirconc %s %d %d",
+                i < creators ? "create" : "lookup", i, ops);
+      pids[i] = exec (cmd);
+    }
+  for (i = 0; i < procs; i++)
+    if (pids[i] == PID_ERROR || wait (pids[i]) != EXIT_SUCCESS)
+      failed++;
+  tsc = rdtsc () - tsc;
+
+  printf ("%s: %d processes, %lld cycles/op", title, procs,
+          tsc / (procs * ops));
+  if (failed)
+    printf (" (%d failed)", failed);
+  printf ("\n");
+}
+
+int
+main (int argc, char *argv[])
+{
+  int procs, ops, i;
+  char name[32];
+
+  if (argc == 4)
+    return worker (argv[1], atoi (argv[2]), atoi (argv[3]));
+
+  procs = argc > 1 ? atoi (argv[1]) : 4;
+  ops = argc > 2 ? atoi (argv[2]) : 200;
+  if (procs > 64)
+    procs = 64;
+
+  if (!mkdir ("shared"))
+    {
+      printf ("shared: mkdir failed\n");
+      return EXIT_FAILURE;
+    }
+  for (i = 0; i < LOOKUP_FILES; i++)
+    {
+      snprintf (name, sizeof name, "shared/f%d", i);
+      create (name, 0);
+    }
+
+  run ("lookup", procs, 0, ops);
+  run ("mixed", procs, procs / 2, ops);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+/* fdbench.c
+
+   Measures how the cost of system calls that take a file handle
+   depends on how many files the process has open.  Opens files up
+   to each of several counts, then times tell() on the newest and
+   the oldest handle and a close() and open() pair, and reports
+   cycles per call at each count.
+
+   Usage: fdbench [MAX] (default 512). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+/* Calls timed per measurement. */
+#define CALLS 1000
+
+/* Most handles the program will hold. */
+#define MAX_FDS 1024
+
+/* Returns the processor's time-stamp counter. */
+static long long
+rdtsc (void)
+{
+  long long tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Returns the average cycles of tell(FD). */
+static long long
+time_tell (int fd)
+{
+  long long tsc = rdtsc ();
+  int i;
+
+  for (i = 0; i < CALLS; i++)
+    tell (fd);
+  return (rdtsc () - tsc) / CALLS;
+}
+
+int
+main (int argc, char *argv[])
+{
+  static int fds[MAX_FDS];
+  int max = argc > 1 ? atoi (argv[1]) : 512;
+  int open_cnt = 0, target, i;
+
+  if (max < 1 || max > MAX_FDS)
+    max = 512;
+  if (!create ("fdbench.dat", 0))
+    {
+      printf ("fdbench.dat: create failed\n");
+      return EXIT_FAILURE;
+    }
+
+  printf ("%8s %12s %12s %12s\n", "open", "tell newest", "tell oldest",
+          "close+open");
+  for (target = 1; target <= max; target *= 2)
+    {
+      long long tsc;
+
+      while (open_cnt < target)
+        {
+          fds[open_cnt] = open ("fdbench.dat");
+          if (fds[open_cnt] < 0)
+            {
+              printf ("fdbench.dat: open %d failed\n", open_cnt + 1);
+              return EXIT_FAILURE;
+            }
+          open_cnt++;
+        }
+
+      /* Close and reopen the newest handle; it comes back the same. */
+      tsc = rdtsc ();
+      for (i = 0; i < CALLS; i++)
+        {
+          close (fds[open_cnt - 1]);
+          fds[open_cnt - 1] = open ("fdbench.dat");
+        }
+      tsc = (rdtsc () - tsc) / CALLS;
+
+      printf ("%8d %12lld %12lld %12lld\n", open_cnt,
+              time_tell (fds[open_cnt - 1]), time_tell (fds[0]), tsc);
+    }
+
+  for (i = 0; i < open_cnt; i++)
+    close (fds[i]);
+  remove ("fdbench.dat");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,112 @@
+/* fsyncbench.c
+
+   Measures the cost of making newly created files durable.  Each
+   operation creates a file, writes a line to it and then either
+   calls fsync(), which writes only that file's blocks and the
+   journal commit covering the create, or reset_cache(), which
+   writes out every dirty block in the cache.  Reports cycles and
+   device writes per operation for each, first from one process and
+   then from several at once, whose fsync() calls share journal
+   commits.
+
+   Usage: fsyncbench [OPS [PROCS]] (defaults 50 and 4).
+   The program runs itself as "fsyncbench fsync|flush ID OPS" for
+   each worker process. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Returns the processor's time-stamp counter. */
+static long long
+rdtsc (void)
+{
+  long long tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Worker: performs OPS creates as process ID, making each durable
+   as OP says. */
+static int
+worker (const char *op, int id, int ops)
+{
+  static const char line[] = "durable\n";
+  char name[32];
+  int i;
+
+  for (i = 0; i < ops; i++)
+    {
+      int fd;
+
+      snprintf (name, sizeof name, "%s%d-%d", op, id, i);
+      if (!create (name, 0))
+        return EXIT_FAILURE;
+      fd = open (name);
+      if (fd < 0)
+        return EXIT_FAILURE;
+      write (fd, line, sizeof line - 1);
+      if (!strcmp (op, "fsync"))
+        fsync (fd);
+      else
+        reset_cache ();
+      close (fd);
+    }
+  return EXIT_SUCCESS;
+}
+
+/* Runs PROCS workers doing OPS creates each, made durable as OP
+   says, and prints what they cost in all. */
+static void
+run (const char *op, int procs, int ops)
+{
+  pid_t pids[64];
+  char cmd[64];
+  long long tsc, writes;
+  int i, failed = 0;
+
+  writes = number_device_writes ();
+  tsc = rdtsc ();
+  if (procs == 1)
+    failed = worker (op, 0, ops) != EXIT_SUCCESS;
+  else
+    {
+      for (i = 0; i < procs; i++)
+        {
+          snprintf (cmd, sizeof cmd, "fsyncbench %s %d %d", op, i + 1, ops);
+          pids[i] = exec (cmd);
+        }
+      for (i = 0; i < procs; i++)
+        if (pids[i] == PID_ERROR || wait (pids[i]) != EXIT_SUCCESS)
+          failed++;
+    }
+  tsc = rdtsc () - tsc;
+  writes = number_device_writes () - writes;
+
+  printf ("%s: %d processes, %lld cycles/op, %lld device writes/op", op,
+          procs, tsc / (procs * ops), writes / (procs * ops));
+  if (failed)
+    printf (" (%d failed)", failed);
+  printf ("\n");
+}
+
+int
+main (int argc, char *argv[])
+{
+  int ops, procs;
+
+  if (argc == 4)
+    return worker (argv[1], atoi (argv[2]), atoi (argv[3]));
+
+  ops = argc > 1 ? atoi (argv[1]) : 50;
+  procs = argc > 2 ? atoi (argv[2]) : 4;
+  if (procs > 64)
+    procs = 64;
+
+  run ("fsync", 1, ops);
+  run ("flush", 1, ops);
+  run ("fsync", procs, ops);
+  run ("flush", procs, ops);
+  return EXIT_SUCCESS;
+}
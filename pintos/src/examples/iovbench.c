@@ -0,0 +1,162 @@
+/* iovbench.c
+
+   Measures a log writer that emits records made of a small header
+   and a small payload.  Writes RECORDS records three ways: one
+   write() per fragment, one writev() per record, and one writev()
+   per batch of records filling IOV_MAX buffers.  Reports the
+   system calls and cycles per record for each, then reads the log
+   back with readv() and checks it.
+
+   Usage: iovbench [RECORDS [PAYLOAD]] (defaults 1000 and 24). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Largest PAYLOAD. */
+#define MAX_PAYLOAD 256
+
+/* Header written before each payload. */
+struct header
+  {
+    int seq;                    /* Record number. */
+    int len;                    /* Payload length. */
+  };
+
+/* Buffers per record. */
+#define FRAGS 2
+
+/* Records per writev() in batched mode. */
+#define BATCH (IOV_MAX / FRAGS)
+
+/* Returns the processor's time-stamp counter. */
+static long long
+rdtsc (void)
+{
+  long long tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Fills in header H and payload P for record SEQ. */
+static void
+make_record (struct header *h, char *p, int seq, int payload)
+{
+  int i;
+
+  h->seq = seq;
+  h->len = payload;
+  for (i = 0; i < payload; i++)
+    p[i] = 'a' + (seq + i) % 26;
+}
+
+/* Writes RECORDS records to a new file NAME, sending BATCH_RECS
+   records per writev() call, or one write() per fragment if
+   BATCH_RECS is 0, and prints the cost. */
+static bool
+run (const char *name, int records, int payload, int batch_recs)
+{
+  static struct header heads[BATCH];
+  static char payloads[BATCH][MAX_PAYLOAD];
+  struct iovec iov[IOV_MAX];
+  long long tsc;
+  int fd, seq, calls = 0;
+  bool ok = true;
+
+  if (!create (name, 0) || (fd = open (name)) < 0)
+    return false;
+
+  tsc = rdtsc ();
+  for (seq = 0; seq < records; )
+    {
+      int n = batch_recs > 0 ? batch_recs : 1;
+      int i;
+
+      if (n > records - seq)
+        n = records - seq;
+      for (i = 0; i < n; i++)
+        {
+          make_record (&heads[i], payloads[i], seq + i, payload);
+          iov[i * FRAGS].iov_base = &heads[i];
+          iov[i * FRAGS].iov_len = sizeof heads[i];
+          iov[i * FRAGS + 1].iov_base = payloads[i];
+          iov[i * FRAGS + 1].iov_len = payload;
+        }
+      if (batch_recs == 0)
+        {
+          ok &= write (fd, &heads[0], sizeof heads[0])
+                == (int) sizeof heads[0];
+          ok &= write (fd, payloads[0], payload) == payload;
+          calls += 2;
+        }
+      else
+        {
+          ok &= (writev (fd, iov, n * FRAGS)
+                 == n * (int) (sizeof *heads + payload));
+          calls++;
+        }
+      seq += n;
+    }
+  tsc = rdtsc () - tsc;
+  close (fd);
+
+  printf ("%-16s %d.%02d syscalls/record, %lld cycles/record\n",
+          batch_recs == 0 ? "write"
+          : batch_recs == 1 ? "writev" : "writev batched",
+          calls / records, calls * 100 / records % 100, tsc / records);
+  return ok;
+}
+
+/* Reads back the log in NAME with readv() and checks that it holds
+   RECORDS records with PAYLOAD-byte payloads. */
+static bool
+verify (const char *name, int records, int payload)
+{
+  struct header h, want;
+  char p[MAX_PAYLOAD], want_p[MAX_PAYLOAD];
+  struct iovec iov[FRAGS];
+  int fd, seq;
+  bool ok = true;
+
+  if ((fd = open (name)) < 0)
+    return false;
+  iov[0].iov_base = &h;
+  iov[0].iov_len = sizeof h;
+  iov[1].iov_base = p;
+  iov[1].iov_len = payload;
+  for (seq = 0; ok && seq < records; seq++)
+    {
+      make_record (&want, want_p, seq, payload);
+      ok = (readv (fd, iov, FRAGS) == (int) sizeof h + payload
+            && h.seq == want.seq && h.len == want.len
+            && !memcmp (p, want_p, payload));
+    }
+  ok = ok && readv (fd, iov, FRAGS) == 0;
+  close (fd);
+  remove (name);
+  return ok;
+}
+
+int
+main (int argc, char *argv[])
+{
+  int records = argc > 1 ? atoi (argv[1]) : 1000;
+  int payload = argc > 2 ? atoi (argv[2]) : 24;
+  static const char *names[] = {"iovlog.0", "iovlog.1", "iovlog.2"};
+  int batches[] = {0, 1, BATCH};
+  int i;
+
+  if (records < 1)
+    records = 1000;
+  if (payload < 1 || payload > MAX_PAYLOAD)
+    payload = 24;
+  for (i = 0; i < 3; i++)
+    if (!run (names[i], records, payload, batches[i])
+        || !verify (names[i], records, payload))
+      {
+        printf ("%s: log is wrong\n", names[i]);
+        return EXIT_FAILURE;
+      }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,93 @@
+/* pathbench.c
+
+   Measures open() latency for nested paths.  Builds the same tree
+   as the dir-mk-tree test, /0/0/0/0 through /3/2/2/3, then opens
+   and closes every file in it ROUNDS times, and reports for each
+   round the average cycles and cache accesses per open along with
+   how many directory lookups the dentry cache answered.
+
+   Usage: pathbench [ROUNDS] (default 4). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+#define AT 4
+#define BT 3
+#define CT 3
+#define DT 4
+
+/* Returns the processor's time-stamp counter. */
+static long long
+rdtsc (void)
+{
+  long long tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+int
+main (int argc, char *argv[])
+{
+  int rounds = argc > 1 ? atoi (argv[1]) : 4;
+  char name[32];
+  int a, b, c, d, r;
+
+  for (a = 0; a < AT; a++)
+    {
+      snprintf (name, sizeof name, "/%d", a);
+      mkdir (name);
+      for (b = 0; b < BT; b++)
+        {
+          snprintf (name, sizeof name, "/%d/%d", a, b);
+          mkdir (name);
+          for (c = 0; c < CT; c++)
+            {
+              snprintf (name, sizeof name, "/%d/%d/%d", a, b, c);
+              mkdir (name);
+              for (d = 0; d < DT; d++)
+                {
+                  snprintf (name, sizeof name, "/%d/%d/%d/%d", a, b, c, d);
+                  create (name, 0);
+                }
+            }
+        }
+    }
+
+  for (r = 0; r < rounds; r++)
+    {
+      int opens = AT * BT * CT * DT;
+      long long tsc, acc;
+      int hits, misses;
+
+      hits = number_dcache_hits ();
+      misses = number_dcache_misses ();
+      acc = number_cache_accesses ();
+      tsc = rdtsc ();
+      for (a = 0; a < AT; a++)
+        for (b = 0; b < BT; b++)
+          for (c = 0; c < CT; c++)
+            for (d = 0; d < DT; d++)
+              {
+                int fd;
+
+                snprintf (name, sizeof name, "/%d/%d/%d/%d", a, b, c, d);
+                fd = open (name);
+                if (fd < 0)
+                  {
+                    printf ("%s: open failed\n", name);
+                    return EXIT_FAILURE;
+                  }
+                close (fd);
+              }
+      tsc = rdtsc () - tsc;
+      acc = number_cache_accesses () - acc;
+      hits = number_dcache_hits () - hits;
+      misses = number_dcache_misses () - misses;
+
+      printf ("round %d: %lld cycles/open, %lld cache accesses/open, "
+              "%d dentry hits, %d misses\n",
+              r, tsc / opens, acc / opens, hits, misses);
+    }
+  return EXIT_SUCCESS;
+}
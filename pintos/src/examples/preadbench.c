@@ -0,0 +1,105 @@
+/* preadbench.c
+
+   Compares random reads done with seek() followed by read() against
+   the same reads done with pread(), which takes one system call
+   instead of two.  Writes a test file, then reads READS randomly
+   chosen blocks of BLOCK bytes from it each way and reports the
+   system calls and cycles per read.  Both passes read the same
+   blocks in the same order and check what they read.
+
+   Usage: preadbench [READS [BLOCK]] (defaults 2000 and 64). */
+
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Size of the test file. */
+#define FILE_SIZE (64 * 1024)
+
+/* Largest BLOCK. */
+#define MAX_BLOCK 4096
+
+/* Returns the processor's time-stamp counter. */
+static long long
+rdtsc (void)
+{
+  long long tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Returns the byte expected at offset OFS of the test file. */
+static char
+expected (unsigned ofs)
+{
+  return ofs * 7 + ofs / 251;
+}
+
+/* Reads READS random blocks of BLOCK bytes from FD, with pread() if
+   USE_PREAD is true and with seek() and read() otherwise, and
+   prints the cost.  Returns false if a read came back wrong. */
+static bool
+run (int fd, bool use_pread, int reads, int block)
+{
+  static char buf[MAX_BLOCK];
+  long long tsc;
+  int i, j;
+
+  random_init (0);
+  tsc = rdtsc ();
+  for (i = 0; i < reads; i++)
+    {
+      unsigned ofs = random_ulong () % (FILE_SIZE - block);
+      int n;
+
+      if (use_pread)
+        n = pread (fd, buf, block, ofs);
+      else
+        {
+          seek (fd, ofs);
+          n = read (fd, buf, block);
+        }
+      if (n != block)
+        return false;
+      for (j = 0; j < block; j++)
+        if (buf[j] != expected (ofs + j))
+          return false;
+    }
+  tsc = rdtsc () - tsc;
+
+  printf ("%-10s %d syscalls/read, %lld cycles/read\n",
+          use_pread ? "pread" : "seek+read", use_pread ? 1 : 2, tsc / reads);
+  return true;
+}
+
+int
+main (int argc, char *argv[])
+{
+  static char data[FILE_SIZE];
+  int reads = argc > 1 ? atoi (argv[1]) : 2000;
+  int block = argc > 2 ? atoi (argv[2]) : 64;
+  unsigned i;
+  int fd;
+
+  if (block < 1 || block > MAX_BLOCK)
+    block = 64;
+  for (i = 0; i < FILE_SIZE; i++)
+    data[i] = expected (i);
+  if (!create ("preadbench.dat", 0) || (fd = open ("preadbench.dat")) < 0
+      || pwrite (fd, data, FILE_SIZE, 0) != FILE_SIZE)
+    {
+      printf ("preadbench.dat: setup failed\n");
+      return EXIT_FAILURE;
+    }
+
+  if (!run (fd, false, reads, block) || !run (fd, true, reads, block))
+    {
+      printf ("preadbench.dat: read returned wrong data\n");
+      return EXIT_FAILURE;
+    }
+  close (fd);
+  remove ("preadbench.dat");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+/* prealloc.c
+
+   Compares files whose space is reserved up front with fallocate()
+   against files that grow one write at a time.  Two files are
+   written alternately, as two programs logging at once would, then
+   read back.  Reports CPU cycles and device I/O for each phase and
+   the number of extents each file ended up in.
+
+   Usage: prealloc [KB], where KB is the size of each file
+   (default 128). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+#define CHUNK 512
+
+static const char *names[2] = {"prealloc-a", "prealloc-b"};
+static char buf[CHUNK];
+
+static inline unsigned long long
+rdtsc (void)
+{
+  unsigned long long tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+static int
+open_or_die (const char *name)
+{
+  int fd = open (name);
+  if (fd < 0)
+    {
+      printf ("%s: open failed\n", name);
+      exit (EXIT_FAILURE);
+    }
+  return fd;
+}
+
+static void
+run (const char *label, bool prealloc, int size)
+{
+  unsigned long long start, write_cycles, read_cycles;
+  long long writes, reads;
+  int fd[2], extents[2];
+  int i, ofs;
+
+  for (i = 0; i < 2; i++)
+    {
+      remove (names[i]);
+      if (!create (names[i], 0))
+        {
+          printf ("%s: create failed\n", names[i]);
+          exit (EXIT_FAILURE);
+        }
+      fd[i] = open_or_die (names[i]);
+      if (prealloc && !fallocate (fd[i], 0, size))
+        {
+          printf ("%s: fallocate failed\n", names[i]);
+          exit (EXIT_FAILURE);
+        }
+    }
+
+  /* Write both files, including the flush to disk. */
+  reset_cache ();
+  writes = number_device_writes ();
+  start = rdtsc ();
+  for (ofs = 0; ofs < size; ofs += CHUNK)
+    for (i = 0; i < 2; i++)
+      if (write (fd[i], buf, CHUNK) != CHUNK)
+        {
+          printf ("%s: write failed\n", names[i]);
+          exit (EXIT_FAILURE);
+        }
+  for (i = 0; i < 2; i++)
+    close (fd[i]);
+  reset_cache ();
+  write_cycles = rdtsc () - start;
+  writes = number_device_writes () - writes;
+
+  /* Read them back from a cold cache. */
+  for (i = 0; i < 2; i++)
+    fd[i] = open_or_die (names[i]);
+  reset_cache ();
+  reads = number_device_reads ();
+  start = rdtsc ();
+  for (i = 0; i < 2; i++)
+    for (ofs = 0; ofs < size; ofs += CHUNK)
+      read (fd[i], buf, CHUNK);
+  read_cycles = rdtsc () - start;
+  reads = number_device_reads () - reads;
+
+  for (i = 0; i < 2; i++)
+    {
+      extents[i] = number_extents (fd[i]);
+      close (fd[i]);
+      remove (names[i]);
+    }
+
+  printf ("%-12s write %12llu cycles %6lld sectors, "
+          "read %12llu cycles %6lld sectors, extents %d/%d\n",
+          label, write_cycles, writes, read_cycles, reads,
+          extents[0], extents[1]);
+}
+
+int
+main (int argc, char *argv[])
+{
+  int size = (argc > 1 ? atoi (argv[1]) : 128) * 1024;
+
+  run ("incremental", false, size);
+  run ("fallocate", true, size);
+  return EXIT_SUCCESS;
+}
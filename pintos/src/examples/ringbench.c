@@ -0,0 +1,169 @@
+/* ringbench.c
+
+   Compares small writes and reads made one system call at a time
+   against the same calls queued on a submission ring and run
+   RING_SIZE at a time by ring_enter().  Writes OPS records of
+   RECORD bytes to a file and reads them back each way, checking
+   what comes back, and reports the traps and cycles per call.
+
+   Usage: ringbench [OPS [RECORD]] (defaults 2000 and 16). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include <syscall-nr.h>
+
+/* Largest RECORD. */
+#define MAX_RECORD 512
+
+static struct ring ring;
+
+/* Returns the processor's time-stamp counter. */
+static long long
+rdtsc (void)
+{
+  long long tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Fills BUF, of SIZE bytes, with the contents of record I. */
+static void
+fill (char *buf, int size, int i)
+{
+  int j;
+
+  for (j = 0; j < size; j++)
+    buf[j] = i * 13 + j;
+}
+
+/* Queues system call CALL_NR on the ring with arguments A0...A2.
+   If the ring is full, runs what is queued first.  Returns false
+   if a completed call did not move RECORD bytes. */
+static bool
+queue (unsigned call_nr, int a0, int a1, int a2, int record)
+{
+  bool ok = true;
+
+  if (ring.sq_tail - ring.sq_head == RING_SIZE)
+    {
+      ring_enter (RING_SIZE);
+      while (ring.cq_head != ring.cq_tail)
+        if (ring.cq[ring.cq_head++ % RING_SIZE].result != record)
+          ok = false;
+    }
+  ring.sq[ring.sq_tail % RING_SIZE].call_nr = call_nr;
+  ring.sq[ring.sq_tail % RING_SIZE].args[0] = a0;
+  ring.sq[ring.sq_tail % RING_SIZE].args[1] = a1;
+  ring.sq[ring.sq_tail % RING_SIZE].args[2] = a2;
+  ring.sq_tail++;
+  return ok;
+}
+
+/* Runs whatever is left on the ring.  Returns false if a call did
+   not move RECORD bytes. */
+static bool
+drain (int record)
+{
+  bool ok = true;
+
+  ring_enter (ring.sq_tail - ring.sq_head);
+  while (ring.cq_head != ring.cq_tail)
+    if (ring.cq[ring.cq_head++ % RING_SIZE].result != record)
+      ok = false;
+  return ok;
+}
+
+/* Writes OPS records of RECORD bytes to FD and reads them back,
+   through the ring if USE_RING is true and with one write() or
+   read() each otherwise, and prints the cost.  Returns false if
+   anything came back wrong. */
+static bool
+run (int fd, bool use_ring, int ops, int record)
+{
+  static char data[MAX_RECORD * 64], back[MAX_RECORD * 64];
+  char expect[MAX_RECORD];
+  long long tsc;
+  bool ok = true;
+  int i;
+
+  /* Records cycle through DATA and BACK 64 at a time, so a whole
+     ring's worth of reads has somewhere to land before it is
+     checked. */
+  for (i = 0; i < 64; i++)
+    fill (data + i * record, record, i);
+
+  seek (fd, 0);
+  tsc = rdtsc ();
+  for (i = 0; i < ops; i++)
+    {
+      char *src = data + i % 64 * record;
+
+      if (!use_ring)
+        ok = write (fd, src, record) == record && ok;
+      else
+        ok = queue (SYS_WRITE, fd, (int) src, record, record) && ok;
+    }
+  if (use_ring)
+    ok = drain (record) && ok;
+
+  seek (fd, 0);
+  for (i = 0; i < ops; i++)
+    {
+      char *dst = back + i % 64 * record;
+
+      if (!use_ring)
+        ok = read (fd, dst, record) == record && ok;
+      else
+        ok = queue (SYS_READ, fd, (int) dst, record, record) && ok;
+      if (!use_ring || i % 64 == 63 || i == ops - 1)
+        {
+          int first = use_ring ? i - i % 64 : i, j;
+
+          if (use_ring)
+            ok = drain (record) && ok;
+          for (j = first; j <= i; j++)
+            {
+              fill (expect, record, j % 64);
+              if (memcmp (back + j % 64 * record, expect, record))
+                ok = false;
+            }
+        }
+    }
+  tsc = rdtsc () - tsc;
+
+  printf ("%-8s %d traps, %lld cycles/call\n",
+          use_ring ? "ring" : "direct",
+          use_ring ? 2 * ((ops + RING_SIZE - 1) / RING_SIZE) : 2 * ops,
+          tsc / (2 * ops));
+  return ok;
+}
+
+int
+main (int argc, char *argv[])
+{
+  int ops = argc > 1 ? atoi (argv[1]) : 2000;
+  int record = argc > 2 ? atoi (argv[2]) : 16;
+  int fd;
+
+  if (ops < 1)
+    ops = 2000;
+  if (record < 1 || record > MAX_RECORD)
+    record = 16;
+  if (!create ("ringbench.dat", 0) || (fd = open ("ringbench.dat")) < 0
+      || !ring_setup (&ring))
+    {
+      printf ("ringbench.dat: setup failed\n");
+      return EXIT_FAILURE;
+    }
+
+  if (!run (fd, false, ops, record) || !run (fd, true, ops, record))
+    {
+      printf ("ringbench.dat: read returned wrong data\n");
+      return EXIT_FAILURE;
+    }
+  close (fd);
+  remove ("ringbench.dat");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,100 @@
+/* seekdist.c
+
+   Measures how far the disk head travels to read files back.
+   Creates DIRS directories and fills them with FILES files each,
+   writing to every directory in turn, as several programs working
+   in different directories at once would.  Then reads every file
+   from a cold cache, one directory at a time, and reports the
+   average seek distance per file read, in sectors.
+
+   Usage: seekdist [DIRS [FILES]] (defaults 4 and 16). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+#define FILE_SIZE 4096
+#define CHUNK 512
+
+static char buf[CHUNK];
+
+static void
+file_name (char *name, size_t size, int dir, int file)
+{
+  snprintf (name, size, "seek%d/f%d", dir, file);
+}
+
+int
+main (int argc, char *argv[])
+{
+  int dirs = argc > 1 ? atoi (argv[1]) : 4;
+  int files = argc > 2 ? atoi (argv[2]) : 16;
+  char name[32];
+  long long distance;
+  int d, f, ofs;
+
+  for (d = 0; d < dirs; d++)
+    {
+      snprintf (name, sizeof name, "seek%d", d);
+      if (!mkdir (name))
+        {
+          printf ("%s: mkdir failed\n", name);
+          return EXIT_FAILURE;
+        }
+    }
+
+  /* Files in every directory grow at the same time. */
+  for (f = 0; f < files; f++)
+    for (d = 0; d < dirs; d++)
+      {
+        file_name (name, sizeof name, d, f);
+        if (!create (name, 0))
+          {
+            printf ("%s: create failed\n", name);
+            return EXIT_FAILURE;
+          }
+      }
+  for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK)
+    for (f = 0; f < files; f++)
+      for (d = 0; d < dirs; d++)
+        {
+          int fd;
+
+          file_name (name, sizeof name, d, f);
+          fd = open (name);
+          seek (fd, ofs);
+          write (fd, buf, CHUNK);
+          close (fd);
+        }
+
+  /* Read them back a directory at a time. */
+  reset_cache ();
+  distance = number_seek_distance ();
+  for (d = 0; d < dirs; d++)
+    for (f = 0; f < files; f++)
+      {
+        int fd;
+
+        file_name (name, sizeof name, d, f);
+        fd = open (name);
+        for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK)
+          read (fd, buf, CHUNK);
+        close (fd);
+      }
+  distance = number_seek_distance () - distance;
+
+  printf ("%d files read, %lld sectors of seeking, %lld per file\n",
+          dirs * files, distance, distance / (dirs * files));
+
+  for (d = 0; d < dirs; d++)
+    {
+      for (f = 0; f < files; f++)
+        {
+          file_name (name, sizeof name, d, f);
+          remove (name);
+        }
+      snprintf (name, sizeof name, "seek%d", d);
+      remove (name);
+    }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+/* systop.c
+
+   Prints a top-style summary of where system call time goes,
+   busiest system call first: calls, total and average cycles,
+   share of all system call cycles, and the latency under which
+   half and 99% of the calls finished, read from the kernel's
+   histograms.
+
+   Usage: systop [COMMAND [ARG...]]
+   With no arguments, reports every process's calls since boot.
+   Otherwise runs COMMAND, waits for it, and reports only the calls
+   made while it ran. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+static struct syscall_stat before[SYSCALL_STATS_MAX];
+static struct syscall_stat after[SYSCALL_STATS_MAX];
+
+/* Fills STATS with system-wide accounting.  Returns the number of
+   entries, or -1 on failure. */
+static int
+snapshot (struct syscall_stat *stats)
+{
+  int cnt = syscall_stats (SYSCALL_STATS_ALL, stats, SYSCALL_STATS_MAX);
+  return cnt > SYSCALL_STATS_MAX ? SYSCALL_STATS_MAX : cnt;
+}
+
+/* Prints into BUF, of SIZE bytes, the latency under which PCT
+   percent of the calls ST counts finished. */
+static void
+percentile (char *buf, size_t size, const struct syscall_stat *st, int pct)
+{
+  unsigned want = (st->calls * pct + 99) / 100;
+  unsigned seen = 0;
+  int i;
+
+  for (i = 0; i < SYSCALL_HIST_CNT - 1; i++)
+    {
+      seen += st->hist[i];
+      if (seen >= want)
+        {
+          snprintf (buf, size, "<%u", 1u << (SYSCALL_HIST_SHIFT + i));
+          return;
+        }
+    }
+  snprintf (buf, size, ">=%u", 1u << (SYSCALL_HIST_SHIFT + i - 1));
+}
+
+int
+main (int argc, char *argv[])
+{
+  int order[SYSCALL_STATS_MAX];
+  long long total = 0;
+  int cnt, shown, i, j;
+
+  if (argc > 1)
+    {
+      char cmd[128];
+      pid_t pid;
+
+      cmd[0] = '\0';
+      for (i = 1; i < argc; i++)
+        {
+          if (i > 1)
+            strlcat (cmd, " ", sizeof cmd);
+          strlcat (cmd, argv[i], sizeof cmd);
+        }
+      if (snapshot (before) < 0)
+        return EXIT_FAILURE;
+      pid = exec (cmd);
+      if (pid == PID_ERROR)
+        {
+          printf ("%s: exec failed\n", argv[1]);
+          return EXIT_FAILURE;
+        }
+      wait (pid);
+    }
+  cnt = snapshot (after);
+  if (cnt < 0)
+    return EXIT_FAILURE;
+
+  /* Subtract the starting counts, if any, and sort by cycles. */
+  shown = 0;
+  for (i = 0; i < cnt; i++)
+    {
+      struct syscall_stat *st = &after[i];
+
+      st->calls -= before[i].calls;
+      st->cycles -= before[i].cycles;
+      for (j = 0; j < SYSCALL_HIST_CNT; j++)
+        st->hist[j] -= before[i].hist[j];
+      if (st->calls == 0)
+        continue;
+      total += st->cycles;
+      for (j = shown++; j > 0 && after[order[j - 1]].cycles < st->cycles; j--)
+        order[j] = order[j - 1];
+      order[j] = i;
+    }
+
+  printf ("%-18s %8s %12s %9s %6s %9s %9s\n",
+          "SYSCALL", "CALLS", "CYCLES", "AVG", "%TIME", "P50", "P99");
+  for (i = 0; i < shown; i++)
+    {
+      const struct syscall_stat *st = &after[order[i]];
+      int tenths = total > 0 ? st->cycles * 1000 / total : 0;
+      char p50[16], p99[16];
+
+      percentile (p50, sizeof p50, st, 50);
+      percentile (p99, sizeof p99, st, 99);
+      printf ("%-18s %8u %12lld %9lld %4d.%d %9s %9s\n", st->name, st->calls,
+              st->cycles, st->cycles / st->calls, tenths / 10, tenths % 10,
+              p50, p99);
+    }
+  return EXIT_SUCCESS;
+}
@@ -1,5 +1,6 @@
 #include "filesys/cache.h"
 #include "filesys/filesys.h"
+#include <debug.h>
 #include <string.h>
 
 struct list lru;
@@ -15,9 +16,7 @@ struct lock number_of_hits_lock;
 struct lock number_of_cache_accesses_lock;
 
 struct cache_block *cache_get_block(block_sector_t sector); 
-void lru_move_front(struct cache_block *block);
-void new_block_read(struct block *device, struct cache_block *block, block_sector_t sector, void *buffer, off_t offset, size_t chunk_size);
-void new_block_write(struct block *device, struct cache_block *block, block_sector_t sector, const void *buffer, off_t offset, size_t chunk_size);
+static struct cache_block *cache_get_locked (struct block *device, block_sector_t sector, bool load);
 void increment_number_hits (void);
 void increment_number_cache_accesses (void);
 
@@ -73,154 +72,149 @@ struct cache_block *cache_get_block(block_sector_t sector) {
     return NULL;
 }
 
-/* Pushes most recently used block to front of lru list 
- The block is in the list already, so remove it from the list first 
- This function is only used if the block is in the cache
-*/
-void lru_move_front(struct cache_block *block) {
-    lock_acquire(&cache_lock);
-    list_remove(&(block->elem));
-    list_push_front(&lru, &(block->elem));
-    lock_release(&cache_lock);
-}
-/* Performs new block operations when block is pulled into the cache
-*/
-
-void new_block_read(struct block *device, struct cache_block *block, block_sector_t sector, void *buffer, off_t offset, size_t chunk_size) {
-    block_read(device, sector, block->data);
-    block->valid = true;
-    block->sector = sector;
-    memcpy(buffer, block->data + offset, chunk_size);
-}
-
-void new_block_write(struct block *device, struct cache_block *block, block_sector_t sector, const void *buffer, off_t offset, size_t chunk_size) {
-    block_read(device, sector, block->data);
-    block->valid = true;
-    block->sector = sector;
-    memcpy(block->data + offset, buffer, chunk_size);
-    block->dirty = true;
-}
-
-void cache_read (struct block *block, block_sector_t sector, void *buffer, off_t offset, int chunk_size) {
+/* Returns the cache block holding SECTOR, with its cache_block_lock
+   held by the caller, and marks it most recently used.
+   On a miss an empty or least recently used block is taken over,
+   writing it back first if it is dirty.  The missing sector is only
+   read from DEVICE if LOAD is true; otherwise the caller is about to
+   overwrite the whole block and the old contents are left as-is. */
+static struct cache_block *
+cache_get_locked (struct block *device, block_sector_t sector, bool load)
+{
+    struct cache_block *cache_blk;
 
     increment_number_cache_accesses();
 
-    /* We must acquire a lock to start reading the cache. */
     lock_acquire(&cache_lock);
-    /* Check if block is in cache */
-    struct cache_block *cache_blk = cache_get_block(sector);
-    /* If in the cache */
-    if ((cache_blk != NULL) && (cache_blk->sector == sector)) {
-        lock_release(&cache_lock);
-        /* thread can block between here, which means the cache_blk can change */
+    cache_blk = cache_get_block(sector);
+    if (cache_blk != NULL) {
+        /* Reorder while cache_lock still keeps the block from being evicted. */
+        list_remove(&(cache_blk->elem));
+        list_push_front(&lru, &(cache_blk->elem));
         lock_acquire(&(cache_blk->cache_block_lock));
-
-        if (cache_blk->sector != sector) { // case where block has changed 
-            struct cache_block *cache_blk = cache_get_block(sector);
-            if (cache_blk == NULL) {
-                goto cache_miss;
-            }
-        }
-
+        lock_release(&cache_lock);
         increment_number_hits();
-
-        /* Read into buffer */
-        memcpy(buffer, cache_blk->data + offset, chunk_size);
-        lock_release(&(cache_blk->cache_block_lock));
-        lru_move_front(cache_blk);
-        return;
+        return cache_blk;
     }
-    /* Could not find the block, so we need to read it into the cache */
-    cache_miss: 
-    /* Load block into empty cache blocks, if any */
+
+    /* Load block into empty cache blocks, if any, else evict the LRU block. */
+    cache_blk = NULL;
     for (int i = 0; i < MAX_CACHE_BLOCKS; i++) {
         if (!(cache[i].valid)) {
-            lock_acquire(&(cache[i].cache_block_lock));
-
-            new_block_read(block, &cache[i], sector, buffer, offset, chunk_size);
-            list_push_front(&lru, &(cache[i].elem));
-    
-            lock_release(&(cache[i].cache_block_lock));
-            lock_release(&cache_lock);
-            return;
+            cache_blk = &cache[i];
+            break;
+        }
+    }
+    if (cache_blk == NULL) {
+        /* Blocks still waiting for a sector cannot be evicted, nor can
+           blocks the journal has not committed yet. */
+        struct list_elem *e = list_rbegin(&lru);
+        while (list_entry(e, struct cache_block, elem)->sector >= CACHE_DELAYED_SECTOR
+               || list_entry(e, struct cache_block, elem)->pinned) {
+            e = list_prev(e);
+            ASSERT (e != list_rend(&lru));
         }
-    } 
-    /* Evict a cache block to load in the new block */
-    struct cache_block *evicted_blk = list_entry(list_pop_back(&lru), struct cache_block, elem);
-    lock_acquire(&(evicted_blk->cache_block_lock));
-
-    /* Need to write block to memory if block is dirty */ 
-    if (evicted_blk->dirty) {
-        block_write(block, evicted_blk->sector, evicted_blk->data);
+        cache_blk = list_entry(e, struct cache_block, elem);
+        list_remove(e);
     }
-    /* Read in new block */
-    new_block_read(block, evicted_blk, sector, buffer, offset, chunk_size);
-    list_push_front(&lru, &(evicted_blk->elem));
+    lock_acquire(&(cache_blk->cache_block_lock));
+
+    /* Need to write block to memory if block is dirty */
+    if (cache_blk->valid && cache_blk->dirty) {
+        block_write(device, cache_blk->sector, cache_blk->data);
+    }
+    if (load) {
+        block_read(device, sector, cache_blk->data);
+    }
+    cache_blk->valid = true;
+    cache_blk->dirty = false;
+    cache_blk->pinned = false;
+    cache_blk->owner = CACHE_NO_OWNER;
+    cache_blk->sector = sector;
+    list_push_front(&lru, &(cache_blk->elem));
 
-    lock_release(&(evicted_blk->cache_block_lock));
     lock_release(&cache_lock);
+    return cache_blk;
 }
 
-void cache_write (struct block *block, block_sector_t sector, const void *buffer, off_t offset, int chunk_size) {
-
-    increment_number_cache_accesses();
-    
-    /* We must acquire a lock to start reading the cache. */
-    lock_acquire(&cache_lock);
-    /* Check if block is in cache */
-    struct cache_block *cache_blk = cache_get_block(sector);
-    /* If in the cache */
-    if ((cache_blk != NULL) && (cache_blk->sector == sector)) {
-        lock_release(&cache_lock);
-        /* thread can block between here, which means the cache_blk can change */
-        lock_acquire(&(cache_blk->cache_block_lock));
+void cache_read (struct block *block, block_sector_t sector, void *buffer, off_t offset, int chunk_size) {
+    struct cache_block *cache_blk = cache_get_locked(block, sector, true);
 
-        if (cache_blk->sector != sector) { // case where block has changed
-            struct cache_block *cache_blk = cache_get_block(sector);
-            if (cache_blk == NULL) {
-                goto cache_miss;
-            }
-        }
+    /* Read into buffer */
+    memcpy(buffer, cache_blk->data + offset, chunk_size);
+    lock_release(&(cache_blk->cache_block_lock));
+}
 
-        increment_number_hits();
+/* Writes into the cached copy of SECTOR.  OWNER is the inode
+   sector of the file SECTOR belongs to, which lets
+   cache_write_back_owned() find the file's dirty blocks, or
+   CACHE_NO_OWNER. */
+void cache_write (struct block *block, block_sector_t sector, const void *buffer, off_t offset, int chunk_size,
+                  block_sector_t owner) {
+    /* A write covering the whole sector does not need the old contents. */
+    bool whole_sector = offset == 0 && chunk_size == BLOCK_SECTOR_SIZE;
+    struct cache_block *cache_blk = cache_get_locked(block, sector, !whole_sector);
+
+    memcpy(cache_blk->data + offset, buffer, chunk_size);
+    cache_blk->dirty = true;
+    cache_blk->owner = owner;
+    lock_release(&(cache_blk->cache_block_lock));
+}
 
-        memcpy(cache_blk->data + offset, buffer, chunk_size);
-        cache_blk->dirty = true;
-        lock_release(&(cache_blk->cache_block_lock));
-        lru_move_front(cache_blk);
-        return;
-    }
-    /* Could not find the block, so we need to read it into the cache */
-    cache_miss: 
-    /* Load block into empty cache blocks, if any */
-    for (int i = 0; i < MAX_CACHE_BLOCKS; i++) {
-        if (!(cache[i].valid)) {
-            lock_acquire(&(cache[i].cache_block_lock));
+/* Fills SECTOR with zeros in the cache without reading it from the
+   device.  Used for freshly allocated sectors, whose old on-disk
+   contents are meaningless.  OWNER is as for cache_write(). */
+void cache_zero (struct block *block, block_sector_t sector, block_sector_t owner) {
+    struct cache_block *cache_blk = cache_get_locked(block, sector, false);
 
-            new_block_write(block, &cache[i], sector, buffer, offset, chunk_size);
-            list_push_front(&lru, &(cache[i].elem));
+    memset(cache_blk->data, 0, BLOCK_SECTOR_SIZE);
+    cache_blk->dirty = true;
+    cache_blk->owner = owner;
+    lock_release(&(cache_blk->cache_block_lock));
+}
 
-            lock_release(&(cache[i].cache_block_lock));
-            lock_release(&cache_lock);
-            return;
-        }
-    } 
-    /* Evict a cache block to load in the new block */
-    struct cache_block *evicted_blk = list_entry(list_pop_back(&lru), struct cache_block, elem);
-    lock_acquire(&(evicted_blk->cache_block_lock));
-    /* evict block by replacing block fields */
-
-    if (evicted_blk->dirty) {
-        block_write(block, evicted_blk->sector, evicted_blk->data);
+/* Moves the cached block for OLD_SECTOR, which must be cached, to
+   NEW_SECTOR.  Any stale copy of NEW_SECTOR is dropped first. */
+void cache_rename (block_sector_t old_sector, block_sector_t new_sector) {
+    lock_acquire(&cache_lock);
+    struct cache_block *stale = cache_get_block(new_sector);
+    if (stale != NULL) {
+        lock_acquire(&(stale->cache_block_lock));
+        list_remove(&(stale->elem));
+        stale->valid = false;
+        stale->dirty = false;
+        stale->sector = 0;
+        lock_release(&(stale->cache_block_lock));
     }
+    struct cache_block *cache_blk = cache_get_block(old_sector);
+    ASSERT (cache_blk != NULL);
+    lock_acquire(&(cache_blk->cache_block_lock));
+    cache_blk->sector = new_sector;
+    cache_blk->dirty = true;
+    lock_release(&(cache_blk->cache_block_lock));
+    lock_release(&cache_lock);
+}
 
-    new_block_write(block, evicted_blk, sector, buffer, offset, chunk_size);
-    list_push_front(&lru, &(evicted_blk->elem));
-
-    lock_release(&(evicted_blk->cache_block_lock));
+/* Drops SECTOR from the cache without writing it back. */
+void cache_discard (block_sector_t sector) {
+    lock_acquire(&cache_lock);
+    struct cache_block *cache_blk = cache_get_block(sector);
+    if (cache_blk != NULL) {
+        lock_acquire(&(cache_blk->cache_block_lock));
+        list_remove(&(cache_blk->elem));
+        cache_blk->valid = false;
+        cache_blk->dirty = false;
+        cache_blk->sector = 0;
+        lock_release(&(cache_blk->cache_block_lock));
+    }
     lock_release(&cache_lock);
 }
 
+/* Writes every dirty block back to disk and empties the cache.
+   Blocks that have no sector yet stay cached; write back their
+   inodes first (inode_flush_all) to get them onto the disk.
+   Pinned blocks stay cached too; commit the journal first
+   (journal_sync) to write them. */
 void cache_flush (void) {
     lock_acquire(&number_of_cache_accesses_lock);
     number_of_cache_accesses = 0;
@@ -230,25 +224,94 @@ void cache_flush (void) {
     number_of_hits = 0;
     lock_release(&number_of_hits_lock);
 
-
-    /* TODO: block_write all blocks in cache to disk */
     lock_acquire(&cache_lock);
     for (int i = 0; i < MAX_CACHE_BLOCKS; i++) {
+        if (!cache[i].valid || cache[i].sector >= CACHE_DELAYED_SECTOR
+            || cache[i].pinned) {
+            continue;
+        }
+        lock_acquire(&(cache[i].cache_block_lock));
         if (cache[i].dirty) {
-            lock_acquire(&(cache[i].cache_block_lock));
             block_write(fs_device, cache[i].sector, cache[i].data);
-            lock_release(&(cache[i].cache_block_lock));
         }
+        list_remove(&(cache[i].elem));
+        cache[i].valid = false;
+        cache[i].dirty = false;
+        cache[i].sector = 0;
+        lock_release(&(cache[i].cache_block_lock));
     }
+    lock_release(&cache_lock);
+}
 
-    /* Empty the LRU list. */
-    while (!list_empty(&lru)) {
-        list_pop_front(&lru);
+/* Keeps SECTOR from being written back or evicted until
+   cache_unpin(), reading it in first if it is not cached.  The
+   journal pins the metadata sectors of a transaction until the
+   transaction is committed, so that no change reaches its home
+   location before its log record. */
+void cache_pin (block_sector_t sector) {
+    lock_acquire(&cache_lock);
+    struct cache_block *cache_blk = cache_get_block(sector);
+    if (cache_blk != NULL) {
+        cache_blk->pinned = true;
+        lock_release(&cache_lock);
+        return;
     }
-    memset(cache, 0, MAX_CACHE_BLOCKS * sizeof(struct cache_block));
+    lock_release(&cache_lock);
 
+    cache_blk = cache_get_locked(fs_device, sector, true);
+    cache_blk->pinned = true;
+    lock_release(&(cache_blk->cache_block_lock));
+}
+
+/* Lets SECTOR be written back and evicted again.  Does nothing if
+   SECTOR is not cached, as after cache_discard(). */
+void cache_unpin (block_sector_t sector) {
+    lock_acquire(&cache_lock);
+    struct cache_block *cache_blk = cache_get_block(sector);
+    if (cache_blk != NULL)
+        cache_blk->pinned = false;
+    lock_release(&cache_lock);
+}
+
+/* Writes SECTOR back to disk now if it is cached, dirty and not
+   pinned.  It stays cached. */
+void cache_write_back (block_sector_t sector) {
+    lock_acquire(&cache_lock);
+    struct cache_block *cache_blk = cache_get_block(sector);
+    if (cache_blk != NULL) {
+        lock_acquire(&(cache_blk->cache_block_lock));
+        if (cache_blk->dirty && !cache_blk->pinned) {
+            block_write(fs_device, sector, cache_blk->data);
+            cache_blk->dirty = false;
+        }
+        lock_release(&(cache_blk->cache_block_lock));
+    }
+    lock_release(&cache_lock);
+}
+
+/* Writes back every dirty, unpinned block that belongs to OWNER,
+   in sector order, so that the disk sweeps across them once.  The
+   blocks stay cached, and the rest of the cache is left alone. */
+void cache_write_back_owned (block_sector_t owner) {
+    block_sector_t sectors[MAX_CACHE_BLOCKS];
+    int cnt = 0;
+
+    lock_acquire(&cache_lock);
     for (int i = 0; i < MAX_CACHE_BLOCKS; i++) {
-        lock_init(&(cache[i].cache_block_lock));
+        if (cache[i].valid && cache[i].dirty && !cache[i].pinned
+            && cache[i].owner == owner && cache[i].sector < CACHE_DELAYED_SECTOR) {
+            /* Insertion sort; there are few of them. */
+            int j = cnt++;
+            while (j > 0 && sectors[j - 1] > cache[i].sector) {
+                sectors[j] = sectors[j - 1];
+                j--;
+            }
+            sectors[j] = cache[i].sector;
+        }
     }
     lock_release(&cache_lock);
-}
\ No newline at end of file
+
+    for (int i = 0; i < cnt; i++) {
+        cache_write_back(sectors[i]);
+    }
+}
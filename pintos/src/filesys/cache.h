@@ -7,6 +7,16 @@
 
 #define MAX_CACHE_BLOCKS 64
 
+/* Sector numbers from here up do not exist on disk.  They name
+   cached data that has not been given a sector yet (see delayed
+   allocation in inode.c).  The cache never evicts or writes back
+   such a block; its owner must cache_rename() it to a real sector
+   or cache_discard() it. */
+#define CACHE_DELAYED_SECTOR 0x80000000
+
+/* Owner of a cache block that belongs to no file in particular. */
+#define CACHE_NO_OWNER ((block_sector_t) -1)
+
 /* List showing lru order of cache*/
 struct list lru;
 
@@ -21,6 +31,8 @@ struct cache_block {
     struct lock cache_block_lock; // Cache block operations need to be serialized
     bool valid; // valid bit
     bool dirty; // dirty bit
+    bool pinned; // held in the cache until its journal commit
+    block_sector_t owner; // inode sector of the file it belongs to
     uint8_t data[BLOCK_SECTOR_SIZE]; // data
 };
 
@@ -30,7 +42,15 @@ struct cache_block cache[MAX_CACHE_BLOCKS];
 void cache_init (void);
 /* Cache read/write similar to block read/write */
 void cache_read (struct block *block, block_sector_t sector, void *buffer, off_t offset, int chunk_size);
-void cache_write (struct block *block, block_sector_t sector, const void *buffer, off_t offset, int chunk_size);
+void cache_write (struct block *block, block_sector_t sector, const void *buffer, off_t offset, int chunk_size,
+                  block_sector_t owner);
+void cache_zero (struct block *block, block_sector_t sector, block_sector_t owner);
+void cache_rename (block_sector_t old_sector, block_sector_t new_sector);
+void cache_discard (block_sector_t sector);
 void cache_flush (void);
+void cache_pin (block_sector_t sector);
+void cache_unpin (block_sector_t sector);
+void cache_write_back (block_sector_t sector);
+void cache_write_back_owned (block_sector_t owner);
 int num_cache_hits(void);
 int num_cache_accesses(void);
@@ -0,0 +1,221 @@
+#include "filesys/dcache.h"
+#include <hash.h>
+#include <list.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Most entries kept at once.  Past this, the least recently used
+   entry is dropped to make room. */
+#define DCACHE_MAX_ENTRIES 256
+
+/* A cached lookup. */
+struct dentry
+  {
+    struct hash_elem hash_elem;         /* Element in DENTRIES. */
+    struct list_elem lru_elem;          /* Element in LRU. */
+    block_sector_t dir;                 /* Directory's inode sector. */
+    block_sector_t sector;              /* Inode sector, or DCACHE_ABSENT. */
+    char name[NAME_MAX + 1];            /* Name within DIR. */
+  };
+
+static struct hash dentries;            /* All entries, by DIR and NAME. */
+static struct list lru;                 /* All entries, most recent first. */
+static size_t dentry_cnt;               /* Number of entries. */
+static struct lock dcache_lock;         /* Guards all of the above. */
+
+/* Bumped by every invalidation.  A lookup that missed only caches
+   its result if nothing was invalidated while it searched the
+   directory, since its result might predate the change. */
+static unsigned generation;
+
+static int hits;
+static int misses;
+
+static hash_hash_func dentry_hash;
+static hash_less_func dentry_less;
+static hash_action_func dentry_free;
+
+/* Initializes the dentry cache, or empties it if it was already
+   initialized. */
+void
+dcache_init (void)
+{
+  static bool initialized;
+
+  if (initialized)
+    hash_clear (&dentries, dentry_free);
+  else
+    {
+      hash_init (&dentries, dentry_hash, dentry_less, NULL);
+      lock_init (&dcache_lock);
+      initialized = true;
+    }
+  list_init (&lru);
+  dentry_cnt = 0;
+  hits = misses = 0;
+}
+
+/* Returns the entry for NAME in DIR, or a null pointer if there is
+   none.  The caller must hold DCACHE_LOCK. */
+static struct dentry *
+find (block_sector_t dir, const char *name)
+{
+  struct dentry key;
+  struct hash_elem *e;
+
+  if (strlen (name) > NAME_MAX)
+    return NULL;
+  key.dir = dir;
+  strlcpy (key.name, name, sizeof key.name);
+  e = hash_find (&dentries, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct dentry, hash_elem) : NULL;
+}
+
+/* Removes D from the cache and frees it.  The caller must hold
+   DCACHE_LOCK. */
+static void
+evict (struct dentry *d)
+{
+  hash_delete (&dentries, &d->hash_elem);
+  list_remove (&d->lru_elem);
+  dentry_cnt--;
+  free (d);
+}
+
+/* Looks up NAME in directory DIR.  On a hit, returns true and sets
+   *SECTORP to the inode sector NAME refers to, or to DCACHE_ABSENT
+   if NAME is known not to exist.  On a miss, returns false and sets
+   *GENP to pass to dcache_insert() once the directory itself has
+   been searched. */
+bool
+dcache_lookup (block_sector_t dir, const char *name,
+               block_sector_t *sectorp, unsigned *genp)
+{
+  struct dentry *d;
+
+  lock_acquire (&dcache_lock);
+  d = find (dir, name);
+  if (d != NULL)
+    {
+      list_remove (&d->lru_elem);
+      list_push_front (&lru, &d->lru_elem);
+      *sectorp = d->sector;
+      hits++;
+    }
+  else
+    {
+      *genp = generation;
+      misses++;
+    }
+  lock_release (&dcache_lock);
+  return d != NULL;
+}
+
+/* Records that NAME in directory DIR refers to inode SECTOR, or
+   does not exist if SECTOR is DCACHE_ABSENT.  GEN is the value
+   dcache_lookup() returned on the miss that led to the search. */
+void
+dcache_insert (block_sector_t dir, const char *name, block_sector_t sector,
+               unsigned gen)
+{
+  struct dentry *d;
+
+  if (strlen (name) > NAME_MAX)
+    return;
+
+  lock_acquire (&dcache_lock);
+  if (gen == generation && find (dir, name) == NULL)
+    {
+      if (dentry_cnt >= DCACHE_MAX_ENTRIES)
+        evict (list_entry (list_back (&lru), struct dentry, lru_elem));
+      d = malloc (sizeof *d);
+      if (d != NULL)
+        {
+          d->dir = dir;
+          d->sector = sector;
+          strlcpy (d->name, name, sizeof d->name);
+          hash_insert (&dentries, &d->hash_elem);
+          list_push_front (&lru, &d->lru_elem);
+          dentry_cnt++;
+        }
+    }
+  lock_release (&dcache_lock);
+}
+
+/* Forgets whatever is cached for NAME in directory DIR.  Called
+   whenever NAME is added to or removed from DIR. */
+void
+dcache_invalidate (block_sector_t dir, const char *name)
+{
+  struct dentry *d;
+
+  lock_acquire (&dcache_lock);
+  generation++;
+  d = find (dir, name);
+  if (d != NULL)
+    evict (d);
+  lock_release (&dcache_lock);
+}
+
+/* Forgets everything cached for directory DIR.  Called when a new
+   directory is created in DIR's sector, which might have held a
+   directory that has since been removed. */
+void
+dcache_invalidate_dir (block_sector_t dir)
+{
+  struct list_elem *e, *next;
+
+  lock_acquire (&dcache_lock);
+  generation++;
+  for (e = list_begin (&lru); e != list_end (&lru); e = next)
+    {
+      struct dentry *d = list_entry (e, struct dentry, lru_elem);
+      next = list_next (e);
+      if (d->dir == dir)
+        evict (d);
+    }
+  lock_release (&dcache_lock);
+}
+
+/* Returns the number of lookups answered from the cache. */
+int
+dcache_hits (void)
+{
+  return hits;
+}
+
+/* Returns the number of lookups that had to search a directory. */
+int
+dcache_misses (void)
+{
+  return misses;
+}
+
+/* Returns a hash of dentry E's directory and name. */
+static unsigned
+dentry_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct dentry *d = hash_entry (e, struct dentry, hash_elem);
+  return hash_int (d->dir) ^ hash_string (d->name);
+}
+
+/* Returns true if dentry A precedes dentry B. */
+static bool
+dentry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED)
+{
+  const struct dentry *a = hash_entry (a_, struct dentry, hash_elem);
+  const struct dentry *b = hash_entry (b_, struct dentry, hash_elem);
+  if (a->dir != b->dir)
+    return a->dir < b->dir;
+  return strcmp (a->name, b->name) < 0;
+}
+
+/* Frees dentry E, for hash_clear(). */
+static void
+dentry_free (struct hash_elem *e, void *aux UNUSED)
+{
+  free (hash_entry (e, struct dentry, hash_elem));
+}
@@ -0,0 +1,24 @@
+#ifndef FILESYS_DCACHE_H
+#define FILESYS_DCACHE_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+
+/* Cache of directory lookups, mapping a directory's inode sector
+   and a name in it to the inode sector the name refers to.  Names
+   known not to exist are cached too, as DCACHE_ABSENT. */
+
+/* Inode sector cached for a name that is not in its directory. */
+#define DCACHE_ABSENT ((block_sector_t) -1)
+
+void dcache_init (void);
+bool dcache_lookup (block_sector_t dir, const char *name,
+                    block_sector_t *sectorp, unsigned *genp);
+void dcache_insert (block_sector_t dir, const char *name,
+                    block_sector_t sector, unsigned gen);
+void dcache_invalidate (block_sector_t dir, const char *name);
+void dcache_invalidate_dir (block_sector_t dir);
+int dcache_hits (void);
+int dcache_misses (void);
+
+#endif /* filesys/dcache.h */
@@ -1,7 +1,9 @@
 #include "filesys/directory.h"
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
@@ -10,7 +12,8 @@
 struct dir 
   {
     struct inode *inode;                /* Backing store. */
-    off_t pos;                          /* Current position. */
+    off_t pos;                          /* Readdir position of LAST. */
+    char last[NAME_MAX + 1];            /* Name listed last, or "". */
   };
 
 /* A single directory entry. */
@@ -18,16 +21,58 @@ struct dir_entry
   {
     block_sector_t inode_sector;        /* Sector number of header. */
     char name[NAME_MAX + 1];            /* Null terminated file name. */
-    bool in_use;                        /* In use or free? */
+    uint8_t type;                       /* One of the ENTRY_* below. */
   };
 
+/* Types of directory entry. */
+#define ENTRY_FREE 0                    /* Free slot. */
+#define ENTRY_UNTYPED 1                 /* In use, written without a type. */
+#define ENTRY_FILE 2                    /* Names an ordinary file. */
+#define ENTRY_DIR 3                     /* Names a directory. */
+
+/* A directory starts out as a plain array of entries, searched
+   from the front.  Once it holds this many entries and needs room
+   for another, it is converted to the hashed format. */
+#define HASH_MIN_ENTRIES 64
+
+/* The hashed format is extendible hashing.  Sector 0 of the
+   directory holds a struct hdir_header.  The index follows it: an
+   array of 2**DEPTH bucket numbers, indexed by the low DEPTH bits
+   of an entry's name hash.  The index has room reserved for
+   HDIR_MAX_DEPTH, but only the part in use takes up disk space.
+   The buckets come last, one sector each.  A full bucket is split
+   in two on the next bit of the hash, doubling the index first if
+   needed, so a lookup or insert reads one index slot and one
+   bucket however large the directory grows. */
+#define HDIR_MAX_DEPTH 12
+#define HDIR_INDEX_OFS BLOCK_SECTOR_SIZE
+#define HDIR_BUCKETS_OFS (HDIR_INDEX_OFS + (sizeof (uint32_t) << HDIR_MAX_DEPTH))
+#define BUCKET_ENTRIES 25
+
+/* Sector 0 of a hashed directory. */
+struct hdir_header
+  {
+    uint32_t depth;                     /* Index has 2**DEPTH slots. */
+  };
+
+/* A bucket of a hashed directory.  Every entry in it has the same
+   low DEPTH bits of its name hash. */
+struct dir_bucket
+  {
+    uint32_t depth;                     /* Hash bits shared by entries. */
+    uint8_t unused[8];                  /* Not used. */
+    struct dir_entry entries[BUCKET_ENTRIES];
+  };
 
+static bool hashed_add (struct dir *, const struct dir_entry *);
+static bool convert_to_hashed (struct dir *);
 
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
 bool
 dir_create (block_sector_t sector, size_t entry_cnt, bool is_dir UNUSED)
 {
+  dcache_invalidate_dir (sector);
   return inode_create (sector, entry_cnt * sizeof (struct dir_entry), true);
 }
 
@@ -41,6 +86,7 @@ dir_open (struct inode *inode)
     {
       dir->inode = inode;
       dir->pos = 0;
+      dir->last[0] = '\0';
       return dir;
     }
   else
@@ -85,6 +131,43 @@ dir_get_inode (struct dir *dir)
   return dir->inode;
 }
 
+/* Returns the byte offset in a hashed directory of bucket
+   number BUCKET. */
+static off_t
+bucket_ofs (uint32_t bucket)
+{
+  return HDIR_BUCKETS_OFS + bucket * BLOCK_SECTOR_SIZE;
+}
+
+/* Returns the byte offset of entry SLOT of the bucket at byte offset
+   OFS. */
+static off_t
+slot_ofs (off_t ofs, int slot)
+{
+  return ofs + offsetof (struct dir_bucket, entries[slot]);
+}
+
+/* Reads the bucket of hashed directory DIR that holds names with
+   hash HASH into *B, and returns its byte offset.  If DEPTHP is
+   non-null, stores the index depth into *DEPTHP. */
+static off_t
+read_bucket (const struct dir *dir, unsigned hash, struct dir_bucket *b,
+             uint32_t *depthp)
+{
+  struct hdir_header h;
+  uint32_t bucket;
+  off_t ofs;
+
+  inode_read_at (dir->inode, &h, sizeof h, 0);
+  inode_read_at (dir->inode, &bucket, sizeof bucket,
+                 HDIR_INDEX_OFS + (hash & ((1u << h.depth) - 1)) * sizeof bucket);
+  ofs = bucket_ofs (bucket);
+  inode_read_at (dir->inode, b, sizeof *b, ofs);
+  if (depthp != NULL)
+    *depthp = h.depth;
+  return ofs;
+}
+
 /* Searches DIR for a file with the given NAME.
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
@@ -100,9 +183,28 @@ lookup (const struct dir *dir, const char *name,
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  if (inode_dir_hashed (dir->inode))
+    {
+      struct dir_bucket b;
+      off_t b_ofs = read_bucket (dir, hash_string (name), &b, NULL);
+      int i;
+
+      for (i = 0; i < BUCKET_ENTRIES; i++)
+        if (b.entries[i].type != ENTRY_FREE
+            && !strcmp (name, b.entries[i].name))
+          {
+            if (ep != NULL)
+              *ep = b.entries[i];
+            if (ofsp != NULL)
+              *ofsp = slot_ofs (b_ofs, i);
+            return true;
+          }
+      return false;
+    }
+
   for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
        ofs += sizeof e) 
-    if (e.in_use && !strcmp (name, e.name)) 
+    if (e.type != ENTRY_FREE && !strcmp (name, e.name)) 
       {
         if (ep != NULL)
           *ep = e;
@@ -116,35 +218,48 @@ lookup (const struct dir *dir, const char *name,
 /* Searches DIR for a file with the given NAME
    and returns true if one exists, false otherwise.
    On success, sets *INODE to an inode for the file, otherwise to
-   a null pointer.  The caller must close *INODE. */
+   a null pointer.  The caller must close *INODE.
+   Consults the dentry cache first, and caches what it finds,
+   including that NAME does not exist. */
 bool
 dir_lookup (const struct dir *dir, const char *name,
             struct inode **inode) 
 {
+  block_sector_t dir_sector, sector;
   struct dir_entry e;
+  unsigned gen;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
-  else
-    *inode = NULL;
+  dir_sector = inode_get_inumber (dir->inode);
+  if (!dcache_lookup (dir_sector, name, &sector, &gen))
+    {
+      inode_dir_lock_read (dir->inode);
+      sector = lookup (dir, name, &e, NULL) ? e.inode_sector : DCACHE_ABSENT;
+      inode_dir_unlock_read (dir->inode);
+      dcache_insert (dir_sector, name, sector, gen);
+    }
+  *inode = sector != DCACHE_ABSENT ? inode_open (sector) : NULL;
 
   return *inode != NULL;
 }
 
 /* Adds a file named NAME to DIR, which must not already contain a
    file by that name.  The file's inode is in sector
-   INODE_SECTOR.
+   INODE_SECTOR, and IS_DIR tells whether it is a directory.
    Returns true if successful, false on failure.
    Fails if NAME is invalid (i.e. too long) or a disk or memory
    error occurs. */
 bool
-dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
+dir_add (struct dir *dir, const char *name, block_sector_t inode_sector,
+         bool is_dir)
 {
-  struct dir_entry e;
-  off_t ofs;
+  struct dir_entry e, slot;
+  block_sector_t sector;
+  off_t ofs, free_ofs;
+  bool known_absent;
+  unsigned gen;
   bool success = false;
 
   ASSERT (dir != NULL);
@@ -154,29 +269,68 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
 
-  /* Check that NAME is not in use. */
-  if (lookup (dir, name, NULL, NULL))
-    goto done;
+  /* Fill in the new entry. */
+  e.type = is_dir ? ENTRY_DIR : ENTRY_FILE;
+  strlcpy (e.name, name, sizeof e.name);
+  e.inode_sector = inode_sector;
 
-  /* Set OFS to offset of free slot.
+  inode_dir_lock_write (dir->inode);
+  if (inode_dir_hashed (dir->inode))
+    {
+      success = hashed_add (dir, &e);
+      goto done;
+    }
+
+  /* Callers normally look NAME up just before adding it, so the
+     dentry cache can usually vouch that it is not in use. */
+  known_absent = (dcache_lookup (inode_get_inumber (dir->inode), name,
+                                 &sector, &gen)
+                  && sector == DCACHE_ABSENT);
+
+  /* Set FREE_OFS to offset of free slot, checking on the way that
+     NAME is not in use unless that is already known.  There are no
+     free slots before the directory's slot hint, so if the check is
+     not needed the search starts there.
      If there are no free slots, then it will be set to the
      current end-of-file.
      
      inode_read_at() will only return a short read at end of file.
      Otherwise, we'd need to verify that we didn't get a short
      read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (!e.in_use)
-      break;
-
-  /* Write slot. */
-  e.in_use = true;
-  strlcpy (e.name, name, sizeof e.name);
-  e.inode_sector = inode_sector;
-  success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  free_ofs = -1;
+  for (ofs = known_absent ? inode_dir_slot_hint (dir->inode) : 0;
+       inode_read_at (dir->inode, &slot, sizeof slot, ofs) == sizeof slot;
+       ofs += sizeof slot) 
+    if (slot.type == ENTRY_FREE)
+      {
+        if (free_ofs < 0)
+          free_ofs = ofs;
+        if (known_absent)
+          break;
+      }
+    else if (!known_absent && !strcmp (name, slot.name))
+      goto done;
+  if (free_ofs < 0)
+    free_ofs = ofs;
+
+  /* A full directory that is already large grows by turning into a
+     hashed one instead. */
+  if ((size_t) free_ofs >= HASH_MIN_ENTRIES * sizeof e
+      && convert_to_hashed (dir))
+    success = hashed_add (dir, &e);
+  else
+    {
+      /* Write slot. */
+      success = (inode_write_at (dir->inode, &e, sizeof e, free_ofs)
+                 == sizeof e);
+      if (success)
+        inode_set_dir_slot_hint (dir->inode, free_ofs + sizeof e);
+    }
 
  done:
+  if (success)
+    dcache_invalidate (inode_get_inumber (dir->inode), name);
+  inode_dir_unlock_write (dir->inode);
   return success;
 }
 
@@ -194,6 +348,8 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  inode_dir_lock_write (dir->inode);
+
   /* Find directory entry. */
   if (!lookup (dir, name, &e, &ofs))
     goto done;
@@ -204,15 +360,19 @@ dir_remove (struct dir *dir, const char *name)
     goto done;
 
   /* Erase directory entry. */
-  e.in_use = false;
+  e.type = ENTRY_FREE;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
     goto done;
+  dcache_invalidate (inode_get_inumber (dir->inode), name);
+  if (ofs < inode_dir_slot_hint (dir->inode))
+    inode_set_dir_slot_hint (dir->inode, ofs);
 
   /* Remove inode. */
   inode_remove (inode);
   success = true;
 
  done:
+  inode_dir_unlock_write (dir->inode);
   inode_close (inode);
   return success;
 }
@@ -222,17 +382,443 @@ dir_remove (struct dir *dir, const char *name)
    contains no more entries. */
 bool
 dir_readdir (struct dir *dir, const char name[NAME_MAX + 1])
+{
+  return dir_readdir_entry (dir, (char *) name, NULL, NULL);
+}
+
+/* Returns X with the order of its 32 bits reversed. */
+static uint32_t
+reverse_bits (uint32_t x)
+{
+  uint32_t r = 0;
+  int i;
+
+  for (i = 0; i < 32; i++)
+    {
+      r = (r << 1) | (x & 1);
+      x >>= 1;
+    }
+  return r;
+}
+
+/* Returns NAME's readdir position: the hash of NAME with its bits
+   reversed.  Directories are listed in order of position, and of
+   name among equal positions, in either format.  Reversing puts
+   the low bits of the hash, which pick a hashed directory's bucket,
+   at the top, so every bucket holds one contiguous range of
+   positions however the buckets are split.  A listing can thus
+   resume from the last name it returned across splits, and across
+   the conversion from the linear format, without returning any
+   entry twice. */
+static uint32_t
+readdir_pos (const char *name)
+{
+  return reverse_bits (hash_string (name));
+}
+
+/* Returns true if entry E, which is in use and at readdir position
+   POS, comes after the name DIR listed last, if any, and before
+   *BEST, at readdir position BEST_POS, if BEST is non-null. */
+static bool
+readdir_better (const struct dir *dir, const struct dir_entry *e, uint32_t pos,
+                const struct dir_entry *best, uint32_t best_pos)
+{
+  if (dir->last[0] != '\0'
+      && (pos < (uint32_t) dir->pos
+          || (pos == (uint32_t) dir->pos && strcmp (e->name, dir->last) <= 0)))
+    return false;
+  return (best == NULL || pos < best_pos
+          || (pos == best_pos && strcmp (e->name, best->name) < 0));
+}
+
+/* Finds the entry of linear directory DIR that comes next in readdir
+   order, storing it in *E.  Returns true if successful, false if
+   there is none.  Every entry has to be looked at, but a linear
+   directory is small. */
+static bool
+linear_readdir (const struct dir *dir, struct dir_entry *e)
+{
+  struct dir_entry buf[8];
+  uint32_t best_pos = 0;
+  bool found = false;
+  off_t ofs, n;
+
+  for (ofs = 0; (n = inode_read_at (dir->inode, buf, sizeof buf, ofs)) > 0;
+       ofs += n)
+    {
+      size_t i;
+
+      for (i = 0; i < n / sizeof *buf; i++)
+        {
+          uint32_t pos;
+
+          if (buf[i].type == ENTRY_FREE)
+            continue;
+          pos = readdir_pos (buf[i].name);
+          if (readdir_better (dir, &buf[i], pos, found ? e : NULL, best_pos))
+            {
+              *e = buf[i];
+              best_pos = pos;
+              found = true;
+            }
+        }
+      if (n < (off_t) sizeof buf)
+        break;
+    }
+  return found;
+}
+
+/* Finds the entry of hashed directory DIR that comes next in readdir
+   order, storing it in *E.  Returns true if successful, false if
+   there is none.  Starts at the bucket holding DIR's position and
+   moves on through the buckets in order of the positions they
+   hold. */
+static bool
+hashed_readdir (const struct dir *dir, struct dir_entry *e)
+{
+  uint32_t pos = dir->last[0] != '\0' ? (uint32_t) dir->pos : 0;
+
+  for (;;)
+    {
+      struct dir_bucket b;
+      uint32_t best_pos = 0, span;
+      bool found = false;
+      int slot;
+
+      read_bucket (dir, reverse_bits (pos), &b, NULL);
+      for (slot = 0; slot < BUCKET_ENTRIES; slot++)
+        {
+          uint32_t e_pos;
+
+          if (b.entries[slot].type == ENTRY_FREE)
+            continue;
+          e_pos = readdir_pos (b.entries[slot].name);
+          if (readdir_better (dir, &b.entries[slot], e_pos,
+                              found ? e : NULL, best_pos))
+            {
+              *e = b.entries[slot];
+              best_pos = e_pos;
+              found = true;
+            }
+        }
+      if (found)
+        return true;
+
+      /* Move past the range of positions this bucket holds. */
+      if (b.depth == 0)
+        return false;
+      span = 1u << (32 - b.depth);
+      pos = (pos & ~(span - 1)) + span;
+      if (pos == 0)
+        return false;
+    }
+}
+
+/* Reads the next directory entry in DIR, like dir_readdir(), and
+   also stores the sector of the inode it names into *SECTORP and
+   whether that is a directory into *IS_DIRP, for each of those that
+   is non-null.  The type comes from the entry itself, so the inode
+   is only opened for entries written before entries had types. */
+bool
+dir_readdir_entry (struct dir *dir, char name[NAME_MAX + 1],
+                   block_sector_t *sectorp, bool *is_dirp)
 {
   struct dir_entry e;
+  bool found;
+
+  inode_dir_lock_read (dir->inode);
+  if (inode_dir_hashed (dir->inode))
+    found = hashed_readdir (dir, &e);
+  else
+    found = linear_readdir (dir, &e);
+  if (found)
+    {
+      dir->pos = (off_t) readdir_pos (e.name);
+      strlcpy (dir->last, e.name, sizeof dir->last);
+      strlcpy (name, e.name, NAME_MAX + 1);
+      if (sectorp != NULL)
+        *sectorp = e.inode_sector;
+    }
+  inode_dir_unlock_read (dir->inode);
 
-  while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
+  /* Closing the inode may start a journal operation, which must not
+     happen under the directory lock. */
+  if (found && is_dirp != NULL)
     {
-      dir->pos += sizeof e;
-      if (e.in_use)
+      if (e.type == ENTRY_UNTYPED)
         {
-          strlcpy (name, e.name, NAME_MAX + 1);
-          return true;
-        } 
+          struct inode *inode = inode_open (e.inode_sector);
+          *is_dirp = inode != NULL && inode_is_dir (inode);
+          inode_close (inode);
+        }
+      else
+        *is_dirp = e.type == ENTRY_DIR;
     }
-  return false;
+  return found;
+}
+
+/* Writes bucket B to byte offset OFS of hashed directory DIR.
+   Returns true if successful, false on failure. */
+static bool
+write_bucket (struct dir *dir, const struct dir_bucket *b, off_t ofs)
+{
+  return inode_write_at (dir->inode, b, sizeof *b, ofs) == sizeof *b;
+}
+
+/* Splits the bucket B at byte offset OFS of hashed directory DIR,
+   which holds names with hash HASH and whose index has depth DEPTH,
+   on the next bit of the name hash,
+   doubling the index first if B is already split as finely as the
+   index allows.  Returns true if successful, false if the index
+   cannot grow or a disk or memory error occurs. */
+static bool
+split_bucket (struct dir *dir, struct dir_bucket *b, off_t ofs,
+              unsigned hash, uint32_t depth)
+{
+  struct dir_bucket *new;
+  uint32_t new_bucket, low_bits, i;
+  int slot;
+  bool success = false;
+
+  if (b->depth == depth)
+    {
+      /* Double the index: each new slot points where its twin in the
+         lower half does. */
+      size_t size = sizeof (uint32_t) << depth;
+      struct hdir_header h;
+      void *index;
+
+      if (depth == HDIR_MAX_DEPTH)
+        return false;
+      index = malloc (size);
+      if (index == NULL)
+        return false;
+      if (inode_read_at (dir->inode, index, size, HDIR_INDEX_OFS) != (off_t) size
+          || inode_write_at (dir->inode, index, size, HDIR_INDEX_OFS + size)
+             != (off_t) size)
+        {
+          free (index);
+          return false;
+        }
+      free (index);
+      h.depth = ++depth;
+      if (inode_write_at (dir->inode, &h, sizeof h, 0) != sizeof h)
+        return false;
+    }
+
+  new = calloc (1, sizeof *new);
+  if (new == NULL)
+    return false;
+  new_bucket = (inode_length (dir->inode) - HDIR_BUCKETS_OFS) / BLOCK_SECTOR_SIZE;
+
+  /* Entries whose hash has the next bit set move to the new bucket. */
+  for (slot = 0; slot < BUCKET_ENTRIES; slot++)
+    if (b->entries[slot].type != ENTRY_FREE
+        && (hash_string (b->entries[slot].name) >> b->depth) & 1)
+      {
+        new->entries[slot] = b->entries[slot];
+        b->entries[slot].type = ENTRY_FREE;
+      }
+  low_bits = hash & ((1u << b->depth) - 1);
+  b->depth++;
+  new->depth = b->depth;
+  if (!write_bucket (dir, new, bucket_ofs (new_bucket))
+      || !write_bucket (dir, b, ofs))
+    goto done;
+
+  /* Point the index slots for the new bucket's hashes at it. */
+  for (i = low_bits | (1u << (b->depth - 1)); i < (1u << depth);
+       i += 1u << b->depth)
+    if (inode_write_at (dir->inode, &new_bucket, sizeof new_bucket,
+                        HDIR_INDEX_OFS + i * sizeof new_bucket)
+        != sizeof new_bucket)
+      goto done;
+  success = true;
+
+ done:
+  free (new);
+  return success;
+}
+
+/* Adds entry E to hashed directory DIR.  Returns true if
+   successful, false if DIR already has an entry by that name or a
+   disk or memory error occurs. */
+static bool
+hashed_add (struct dir *dir, const struct dir_entry *e)
+{
+  unsigned hash = hash_string (e->name);
+  struct dir_bucket b;
+
+  for (;;)
+    {
+      uint32_t depth;
+      off_t ofs = read_bucket (dir, hash, &b, &depth);
+      int slot, free_slot = -1;
+
+      for (slot = 0; slot < BUCKET_ENTRIES; slot++)
+        if (b.entries[slot].type == ENTRY_FREE)
+          {
+            if (free_slot < 0)
+              free_slot = slot;
+          }
+        else if (!strcmp (e->name, b.entries[slot].name))
+          return false;
+
+      if (free_slot >= 0)
+        return (inode_write_at (dir->inode, e, sizeof *e,
+                                slot_ofs (ofs, free_slot))
+                == sizeof *e);
+      if (!split_bucket (dir, &b, ofs, hash, depth))
+        return false;
+    }
+}
+
+/* Converts linear directory DIR to the hashed format.  The new
+   layout is built in memory first, splitting buckets the way
+   hashed_add() would until every entry fits.  The buckets, and the
+   part of the index that lies past the linear entries, are written
+   next; they may need new sectors, so if writing them fails they are
+   zeroed again.  Only then are the header and index written over the
+   linear entries, in sectors DIR already has.  Returns true if
+   successful, false if memory or disk space runs out or the entries
+   cannot be spread over buckets, in which case DIR is still linear
+   and holds the same entries, though it may have grown. */
+static bool
+convert_to_hashed (struct dir *dir)
+{
+  off_t length = inode_length (dir->inode);
+  size_t entry_cnt = length / sizeof (struct dir_entry);
+  struct dir_entry *entries = NULL;
+  uint32_t *bucket_of = NULL;           /* Bucket of each entry. */
+  uint32_t *index = NULL;
+  struct dir_bucket *buckets = NULL;
+  struct hdir_header *h;
+  uint8_t *head = NULL;                 /* Header and index. */
+  uint32_t depth = 0, bucket_cnt = 1, b;
+  off_t linear_size, head_size, bucket_size;
+  off_t bucket_written = 0, tail_written = 0;
+  size_t i;
+  bool success = false;
+
+  entries = malloc (length);
+  bucket_of = calloc (entry_cnt, sizeof *bucket_of);
+  index = calloc (1, sizeof *index << HDIR_MAX_DEPTH);
+  buckets = calloc (1, sizeof *buckets);
+  if (entries == NULL || bucket_of == NULL || index == NULL
+      || buckets == NULL
+      || inode_read_at (dir->inode, entries, length, 0) != length)
+    goto done;
+
+  /* The buckets go past the linear entries.  Anything already
+     there, left by an earlier attempt, must be free slots. */
+  linear_size = length < (off_t) HDIR_BUCKETS_OFS ? length : (off_t) HDIR_BUCKETS_OFS;
+  for (i = linear_size / sizeof *entries; i < entry_cnt; i++)
+    if (entries[i].type != ENTRY_FREE)
+      goto done;
+
+  /* Start with one bucket that every hash maps to, and split any
+     bucket with too many entries on the next bit of the hash. */
+  for (b = 0; b < bucket_cnt; )
+    {
+      struct dir_bucket *grown;
+      uint32_t new_bucket, low_bits = 0, cnt = 0;
+
+      for (i = 0; i < entry_cnt; i++)
+        if (entries[i].type != ENTRY_FREE && bucket_of[i] == b)
+          {
+            low_bits = hash_string (entries[i].name);
+            cnt++;
+          }
+      if (cnt <= BUCKET_ENTRIES)
+        {
+          b++;
+          continue;
+        }
+
+      if (buckets[b].depth == depth)
+        {
+          if (depth == HDIR_MAX_DEPTH)
+            goto done;
+          memcpy (index + (1u << depth), index, sizeof *index << depth);
+          depth++;
+        }
+      grown = realloc (buckets, (bucket_cnt + 1) * sizeof *buckets);
+      if (grown == NULL)
+        goto done;
+      buckets = grown;
+      new_bucket = bucket_cnt++;
+      memset (&buckets[new_bucket], 0, sizeof *buckets);
+
+      for (i = 0; i < entry_cnt; i++)
+        if (entries[i].type != ENTRY_FREE && bucket_of[i] == b
+            && (hash_string (entries[i].name) >> buckets[b].depth) & 1)
+          bucket_of[i] = new_bucket;
+      low_bits &= (1u << buckets[b].depth) - 1;
+      buckets[b].depth++;
+      buckets[new_bucket].depth = buckets[b].depth;
+      for (i = low_bits | (1u << (buckets[b].depth - 1)); i < (1u << depth);
+           i += 1u << buckets[b].depth)
+        index[i] = new_bucket;
+    }
+
+  /* Fill in the buckets, the header, and the index. */
+  for (i = 0; i < entry_cnt; i++)
+    if (entries[i].type != ENTRY_FREE)
+      {
+        struct dir_bucket *bp = &buckets[bucket_of[i]];
+        int slot = 0;
+
+        while (bp->entries[slot].type != ENTRY_FREE)
+          slot++;
+        bp->entries[slot] = entries[i];
+      }
+  bucket_size = bucket_cnt * sizeof *buckets;
+  head_size = HDIR_INDEX_OFS + (sizeof *index << depth);
+  head = calloc (1, head_size > linear_size ? head_size : linear_size);
+  if (head == NULL)
+    goto done;
+  h = (struct hdir_header *) head;
+  h->depth = depth;
+  memcpy (head + HDIR_INDEX_OFS, index, sizeof *index << depth);
+
+  /* Write everything that does not overlap the linear entries. */
+  bucket_written = inode_write_at (dir->inode, buckets, bucket_size,
+                                   HDIR_BUCKETS_OFS);
+  if (bucket_written == bucket_size && head_size > linear_size)
+    tail_written = inode_write_at (dir->inode, head + linear_size,
+                                   head_size - linear_size, linear_size);
+  if (bucket_written != bucket_size
+      || (head_size > linear_size
+          && tail_written != head_size - linear_size))
+    goto undo;
+
+  /* Replace the linear entries by the header and index. */
+  if (inode_write_at (dir->inode, head, linear_size, 0) != linear_size)
+    {
+      inode_write_at (dir->inode, entries, linear_size, 0);
+      goto undo;
+    }
+  inode_set_dir_hashed (dir->inode);
+  success = true;
+  goto done;
+
+ undo:
+  /* Zero what was written, so that DIR reads as the linear
+     directory it was.  Its sectors are allocated by now. */
+  memset (buckets, 0, bucket_size);
+  inode_write_at (dir->inode, buckets, bucket_written, HDIR_BUCKETS_OFS);
+  if (tail_written > 0)
+    {
+      memset (head, 0, head_size);
+      inode_write_at (dir->inode, head + linear_size, tail_written,
+                      linear_size);
+    }
+
+ done:
+  free (entries);
+  free (bucket_of);
+  free (index);
+  free (buckets);
+  free (head);
+  return success;
 }
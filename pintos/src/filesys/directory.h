@@ -23,8 +23,10 @@ struct inode *dir_get_inode (struct dir *);
 
 /* Reading and writing. */
 bool dir_lookup (const struct dir *, const char *name, struct inode **);
-bool dir_add (struct dir *, const char *name, block_sector_t);
+bool dir_add (struct dir *, const char *name, block_sector_t, bool is_dir);
 bool dir_remove (struct dir *, const char *name);
 bool dir_readdir (struct dir *, const char name[NAME_MAX + 1]);
+bool dir_readdir_entry (struct dir *, char name[NAME_MAX + 1],
+                        block_sector_t *, bool *is_dir);
 
 #endif /* filesys/directory.h */
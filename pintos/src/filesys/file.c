@@ -113,6 +113,47 @@ file_write_at (struct file *file, const void *buffer, off_t size,
   return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Reads from FILE, starting at the file's current position, into
+   the CNT buffers described by IOV in turn.
+   Returns the number of bytes actually read,
+   which may be less than requested if end of file is reached.
+   Advances FILE's position by the number of bytes read. */
+off_t
+file_readv (struct file *file, const struct iovec *iov, int cnt)
+{
+  off_t bytes_read = inode_readv_at (file->inode, iov, cnt, file->pos);
+  file->pos += bytes_read;
+  return bytes_read;
+}
+
+/* Writes the CNT buffers described by IOV in turn into FILE,
+   starting at the file's current position.
+   Returns the number of bytes actually written.
+   Advances FILE's position by the number of bytes written. */
+off_t
+file_writev (struct file *file, const struct iovec *iov, int cnt)
+{
+  off_t bytes_written = inode_writev_at (file->inode, iov, cnt, file->pos);
+  file->pos += bytes_written;
+  return bytes_written;
+}
+
+/* Copies SIZE bytes from SRC, starting at its current position,
+   to DST at its current position, without the data leaving the
+   kernel.  SRC and DST must be open on different inodes.
+   Returns the number of bytes actually copied, which may be less
+   than SIZE if end of file is reached in SRC.
+   Advances both files' positions by the number of bytes copied. */
+off_t
+file_copy_range (struct file *src, struct file *dst, off_t size)
+{
+  off_t copied = inode_copy_range (src->inode, src->pos, dst->inode,
+                                   dst->pos, size);
+  src->pos += copied;
+  dst->pos += copied;
+  return copied;
+}
+
 /* Prevents write operations on FILE's underlying inode
    until file_allow_write() is called or FILE is closed. */
 void
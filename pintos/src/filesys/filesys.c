@@ -7,12 +7,20 @@
 #include "filesys/inode.h"
 #include "filesys/directory.h"
 #include "filesys/cache.h"
+#include "filesys/dcache.h"
+#include "filesys/journal.h"
 #include "threads/thread.h"
 #include "devices/block.h"
 
 /* Partition that contains the file system. */
 struct block *fs_device;
 
+/* If true, filesys_done() writes nothing, so that whatever has not
+   reached the disk by shutdown is lost, as in a power failure.  The
+   next boot then has to recover through the journal.
+   Controlled by kernel command-line option "-crash". */
+bool filesys_crash;
+
 bool rel_or_abs(const char *name);
 static int get_next_part (char part[NAME_MAX + 1], const char **srcp);
 void * filesys_open_helper(struct dir *directory, const char *name, bool *f_or_d);
@@ -58,6 +66,8 @@ filesys_init (bool format)
   inode_init ();
   free_map_init ();
   cache_init ();
+  dcache_init ();
+  journal_init (format);
 
   if (format) 
     do_format ();
@@ -70,7 +80,12 @@ filesys_init (bool format)
 void
 filesys_done (void) 
 {
+  if (filesys_crash)
+    return;
+  inode_reclaim_all ();
+  inode_flush_all ();
   free_map_close ();
+  journal_done ();
   cache_flush ();
 }
 
@@ -92,11 +107,15 @@ filesys_create (const char *name, off_t initial_size)
   // }
   // dir_close (dir);
   // return success;
+  bool success;
+  journal_begin ();
   if (rel_or_abs(name) || thread_current()->cwd == NULL) {
-    return filesys_mkdir_helper(dir_open_root(), name, true, initial_size, false);
+    success = filesys_mkdir_helper(dir_open_root(), name, true, initial_size, false);
   } else {
-    return filesys_mkdir_helper(dir_reopen(thread_current()->cwd), name, true, initial_size, false);
-  }  
+    success = filesys_mkdir_helper(dir_reopen(thread_current()->cwd), name, true, initial_size, false);
+  }
+  journal_end ();
+  return success;
 }
 
 /* 0 for relative, 1 for absolute*/
@@ -173,11 +192,15 @@ filesys_remove (const char *name)
   // bool success = dir != NULL && dir_remove (dir, name);
   // dir_close (dir); 
   // return success;
+  bool success;
+  journal_begin ();
   if (rel_or_abs(name) || thread_current()->cwd == NULL) {
-    return filesys_mkdir_helper(dir_open_root(), name, false, 0, true);
+    success = filesys_mkdir_helper(dir_open_root(), name, false, 0, true);
   } else {
-    return filesys_mkdir_helper(dir_reopen(thread_current()->cwd), name, false, 0, true);
+    success = filesys_mkdir_helper(dir_reopen(thread_current()->cwd), name, false, 0, true);
   }
+  journal_end ();
+  return success;
 }
 
 /* Formats the file system. */
@@ -227,9 +250,10 @@ bool filesys_mkdir_helper(struct dir* directory, const char *name, bool is_file,
     if (**srcp == '\0') { // if last thing in path is a directory, we return a directory
       if (is_file) { // creates file for filesys_create
         block_sector_t inode_sector = 0;
-        bool success = (free_map_allocate (1, &inode_sector)
+        block_sector_t parent = inode_get_inumber (dir_get_inode (prev_dir));
+        bool success = (free_map_allocate_near (1, parent, &inode_sector)
                   && inode_create (inode_sector, initial_size, false)
-                  && dir_add (prev_dir, name_buffer, inode_sector));
+                  && dir_add (prev_dir, name_buffer, inode_sector, false));
         if (!success && inode_sector != 0) {
           free_map_release (inode_sector, 1);
         }
@@ -237,7 +261,9 @@ bool filesys_mkdir_helper(struct dir* directory, const char *name, bool is_file,
         return success;
       }
       if (remove) {
-        bool success = prev_dir != NULL && dir_remove (prev_dir, name);
+        // NAME has been consumed by get_next_part; remove the last part.
+        dir_close(dir);
+        bool success = prev_dir != NULL && dir_remove (prev_dir, name_buffer);
         dir_close(prev_dir);
         return success;
       }
@@ -247,17 +273,19 @@ bool filesys_mkdir_helper(struct dir* directory, const char *name, bool is_file,
         return false;
       }
       block_sector_t inode_sector = 0;
-      bool success = (free_map_allocate (1, &inode_sector)
+      block_sector_t parent = inode_get_inumber (dir_get_inode (prev_dir));
+      bool success = (free_map_allocate_near (1, free_map_dir_goal (parent),
+                                              &inode_sector)
                   && dir_create (inode_sector, 16, true)
-                  && dir_add (prev_dir, name_buffer, inode_sector));
+                  && dir_add (prev_dir, name_buffer, inode_sector, true));
       if (!success && inode_sector != 0) {
         free_map_release (inode_sector, 1);
         return false;
       }
       dir_lookup(prev_dir, name_buffer, &inode);
       dir = dir_open(inode);
-      dir_add(dir, "..", inode_get_inumber(dir_get_inode(prev_dir))); // add parent directory
-      dir_add(dir, ".", inode_sector); // add current directory
+      dir_add(dir, "..", inode_get_inumber(dir_get_inode(prev_dir)), true); // add parent directory
+      dir_add(dir, ".", inode_sector, true); // add current directory
       dir_close(dir);
       dir_close(prev_dir);
       return true;
@@ -270,11 +298,13 @@ bool filesys_mkdir_helper(struct dir* directory, const char *name, bool is_file,
 
 bool filesys_mkdir(const char *name) {
   bool result;
+  journal_begin ();
   if (rel_or_abs(name)) {
     result = filesys_mkdir_helper(dir_open_root(), name, false, 0, false);
   } else {
     result = filesys_mkdir_helper(dir_reopen(thread_current()->cwd), name, false, 0, false);
   }
+  journal_end ();
 
   return result;
 }
@@ -11,6 +11,11 @@
 /* Block device that contains the file system. */
 struct block *fs_device;
 
+/* If true, shutting down leaves the file system as a power failure
+   would, to test recovery.
+   Controlled by kernel command-line option "-crash". */
+extern bool filesys_crash;
+
 void filesys_init (bool format);
 void filesys_done (void);
 bool filesys_create (const char *name, off_t initial_size);
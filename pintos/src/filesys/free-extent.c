@@ -0,0 +1,337 @@
+#include "filesys/free-extent.h"
+#include <debug.h>
+#include <random.h>
+#include "threads/malloc.h"
+
+/* The index is a pair of treaps over the same nodes: one ordered
+   by start sector, the other by size and then start.  Each node
+   has one random priority that both trees keep in heap order, so
+   both stay balanced with high probability and every operation
+   takes logarithmic time.
+
+   Nodes in the by-start tree also record the size of the largest
+   extent in their subtree, which lets a next-fit search skip every
+   subtree with nothing big enough in it. */
+
+/* The two orders. */
+enum order
+  {
+    BY_START,                   /* By start sector. */
+    BY_SIZE,                    /* By size, then start sector. */
+    ORDER_CNT
+  };
+
+/* A free extent. */
+struct free_extent
+  {
+    block_sector_t start;       /* First free sector. */
+    size_t cnt;                 /* Number of free sectors. */
+    unsigned long priority;     /* Heap priority in both trees. */
+    size_t max_cnt;             /* Largest CNT in BY_START subtree. */
+    struct free_extent *kids[ORDER_CNT][2];  /* Children, left and right. */
+  };
+
+static struct free_extent *roots[ORDER_CNT];
+
+/* Returns true if extent A comes before extent B in ORDER. */
+static bool
+less (const struct free_extent *a, const struct free_extent *b,
+      enum order order)
+{
+  if (order == BY_SIZE && a->cnt != b->cnt)
+    return a->cnt < b->cnt;
+  return a->start < b->start;
+}
+
+/* Recomputes E's subtree summary in ORDER from its children. */
+static void
+update (struct free_extent *e, enum order order)
+{
+  if (order == BY_START)
+    {
+      int side;
+
+      e->max_cnt = e->cnt;
+      for (side = 0; side < 2; side++)
+        if (e->kids[BY_START][side] != NULL
+            && e->kids[BY_START][side]->max_cnt > e->max_cnt)
+          e->max_cnt = e->kids[BY_START][side]->max_cnt;
+    }
+}
+
+/* Joins treaps A and B, every node of which comes after every
+   node of A in ORDER, and returns the root of the result. */
+static struct free_extent *
+merge (struct free_extent *a, struct free_extent *b, enum order order)
+{
+  if (a == NULL)
+    return b;
+  if (b == NULL)
+    return a;
+  if (a->priority > b->priority)
+    {
+      a->kids[order][1] = merge (a->kids[order][1], b, order);
+      update (a, order);
+      return a;
+    }
+  else
+    {
+      b->kids[order][0] = merge (a, b->kids[order][0], order);
+      update (b, order);
+      return b;
+    }
+}
+
+/* Splits treap T into *LEFT, the nodes that come before E in
+   ORDER, and *RIGHT, the rest. */
+static void
+split (struct free_extent *t, const struct free_extent *e, enum order order,
+       struct free_extent **left, struct free_extent **right)
+{
+  if (t == NULL)
+    *left = *right = NULL;
+  else if (less (t, e, order))
+    {
+      split (t->kids[order][1], e, order, &t->kids[order][1], right);
+      update (t, order);
+      *left = t;
+    }
+  else
+    {
+      split (t->kids[order][0], e, order, left, &t->kids[order][0]);
+      update (t, order);
+      *right = t;
+    }
+}
+
+/* Removes E from treap T in ORDER and returns the new root. */
+static struct free_extent *
+erase (struct free_extent *t, const struct free_extent *e, enum order order)
+{
+  ASSERT (t != NULL);
+  if (t == e)
+    return merge (t->kids[order][0], t->kids[order][1], order);
+  else
+    {
+      int side = less (t, e, order);
+      t->kids[order][side] = erase (t->kids[order][side], e, order);
+      update (t, order);
+      return t;
+    }
+}
+
+/* Adds E, which must not be in the index, to both trees. */
+static void
+insert_extent (struct free_extent *e)
+{
+  enum order order;
+
+  for (order = 0; order < ORDER_CNT; order++)
+    {
+      struct free_extent *left, *right;
+
+      e->kids[order][0] = e->kids[order][1] = NULL;
+      update (e, order);
+      split (roots[order], e, order, &left, &right);
+      roots[order] = merge (merge (left, e, order), right, order);
+    }
+}
+
+/* Takes E out of both trees. */
+static void
+remove_extent (struct free_extent *e)
+{
+  enum order order;
+
+  for (order = 0; order < ORDER_CNT; order++)
+    roots[order] = erase (roots[order], e, order);
+}
+
+/* Returns the extent with the greatest start at or before SECTOR,
+   or a null pointer if there is none. */
+static struct free_extent *
+find_at_or_before (block_sector_t sector)
+{
+  struct free_extent *t = roots[BY_START];
+  struct free_extent *found = NULL;
+
+  while (t != NULL)
+    if (t->start <= sector)
+      {
+        found = t;
+        t = t->kids[BY_START][1];
+      }
+    else
+      t = t->kids[BY_START][0];
+  return found;
+}
+
+/* Returns the first extent in subtree T that starts after SECTOR
+   and has at least CNT sectors, or a null pointer if none does. */
+static struct free_extent *
+find_fit_after (struct free_extent *t, block_sector_t sector, size_t cnt)
+{
+  while (t != NULL && t->max_cnt >= cnt)
+    {
+      if (t->start > sector)
+        {
+          struct free_extent *e = find_fit_after (t->kids[BY_START][0],
+                                                  sector, cnt);
+          if (e != NULL)
+            return e;
+          if (t->cnt >= cnt)
+            return t;
+        }
+      t = t->kids[BY_START][1];
+    }
+  return NULL;
+}
+
+/* Frees every node of treap T, in the by-start order. */
+static void
+destroy (struct free_extent *t)
+{
+  if (t != NULL)
+    {
+      destroy (t->kids[BY_START][0]);
+      destroy (t->kids[BY_START][1]);
+      free (t);
+    }
+}
+
+/* Empties the index. */
+void
+free_extent_clear (void)
+{
+  destroy (roots[BY_START]);
+  roots[BY_START] = roots[BY_SIZE] = NULL;
+}
+
+/* Records the CNT sectors starting at START, none of which may
+   already be in the index, as free, merging them with the
+   extents on either side.  Returns false, leaving the index as
+   it was, if memory runs out. */
+bool
+free_extent_add (block_sector_t start, size_t cnt)
+{
+  struct free_extent *before, *after, *e;
+
+  ASSERT (cnt > 0);
+
+  before = start > 0 ? find_at_or_before (start - 1) : NULL;
+  if (before != NULL && before->start + before->cnt != start)
+    before = NULL;
+  after = find_at_or_before (start + cnt);
+  if (after != NULL && after->start != start + cnt)
+    after = NULL;
+
+  if (before != NULL)
+    {
+      e = before;
+      remove_extent (e);
+      e->cnt += cnt;
+    }
+  else
+    {
+      e = malloc (sizeof *e);
+      if (e == NULL)
+        return false;
+      e->start = start;
+      e->cnt = cnt;
+      e->priority = random_ulong ();
+    }
+  if (after != NULL)
+    {
+      remove_extent (after);
+      e->cnt += after->cnt;
+      free (after);
+    }
+  insert_extent (e);
+  return true;
+}
+
+/* Records the CNT sectors starting at START, which must all lie
+   in one extent of the index, as in use.  Returns false, leaving
+   the index as it was, if memory runs out. */
+bool
+free_extent_remove (block_sector_t start, size_t cnt)
+{
+  struct free_extent *e = find_at_or_before (start);
+  block_sector_t end;
+
+  ASSERT (e != NULL);
+  ASSERT (start + cnt <= e->start + e->cnt);
+
+  end = e->start + e->cnt;
+  remove_extent (e);
+  if (e->start < start && start + cnt < end)
+    {
+      /* Taking from the middle leaves two extents. */
+      struct free_extent *tail = malloc (sizeof *tail);
+      if (tail == NULL)
+        {
+          insert_extent (e);
+          return false;
+        }
+      tail->start = start + cnt;
+      tail->cnt = end - (start + cnt);
+      tail->priority = random_ulong ();
+      insert_extent (tail);
+      e->cnt = start - e->start;
+    }
+  else if (e->start < start)
+    e->cnt = start - e->start;
+  else if (start + cnt < end)
+    {
+      e->start = start + cnt;
+      e->cnt = end - e->start;
+    }
+  else
+    {
+      free (e);
+      return true;
+    }
+  insert_extent (e);
+  return true;
+}
+
+/* Returns the first sector at or after START that begins CNT free
+   sectors, or FREE_EXTENT_NONE if there is none. */
+block_sector_t
+free_extent_next_fit (block_sector_t start, size_t cnt)
+{
+  struct free_extent *e = find_at_or_before (start);
+
+  if (e != NULL && e->start + e->cnt >= start + cnt)
+    return start;
+  e = find_fit_after (roots[BY_START], start, cnt);
+  return e != NULL ? e->start : FREE_EXTENT_NONE;
+}
+
+/* Returns the start of the smallest extent with at least CNT
+   sectors, the lowest-numbered one if several tie, or
+   FREE_EXTENT_NONE if there is none. */
+block_sector_t
+free_extent_best_fit (size_t cnt)
+{
+  struct free_extent *t = roots[BY_SIZE];
+  struct free_extent *found = NULL;
+
+  while (t != NULL)
+    if (t->cnt >= cnt)
+      {
+        found = t;
+        t = t->kids[BY_SIZE][0];
+      }
+    else
+      t = t->kids[BY_SIZE][1];
+  return found != NULL ? found->start : FREE_EXTENT_NONE;
+}
+
+/* Returns the number of sectors in the largest extent, or 0 if
+   there are no free sectors. */
+size_t
+free_extent_largest (void)
+{
+  return roots[BY_START] != NULL ? roots[BY_START]->max_cnt : 0;
+}
@@ -0,0 +1,23 @@
+#ifndef FILESYS_FREE_EXTENT_H
+#define FILESYS_FREE_EXTENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+
+/* Index of the free extents (maximal runs of free sectors) of the
+   file system device, ordered both by start and by size.  Kept by
+   the free map alongside its bitmap; the caller serializes access. */
+
+/* Returned by the searches when no extent fits. */
+#define FREE_EXTENT_NONE ((block_sector_t) -1)
+
+void free_extent_clear (void);
+bool free_extent_add (block_sector_t start, size_t cnt);
+bool free_extent_remove (block_sector_t start, size_t cnt);
+
+block_sector_t free_extent_next_fit (block_sector_t start, size_t cnt);
+block_sector_t free_extent_best_fit (size_t cnt);
+size_t free_extent_largest (void);
+
+#endif /* filesys/free-extent.h */
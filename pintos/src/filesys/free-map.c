@@ -1,12 +1,75 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <limits.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/free-extent.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "threads/synch.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
+static struct lock free_map_lock;    /* Protects the free map and counts. */
+static size_t free_cnt;              /* Number of free sectors. */
+static size_t reserved_cnt;          /* Free sectors promised to
+                                        free_map_reserve() callers. */
+
+/* Each change to the free map marks dirty the sectors of the free
+   map file that hold the changed bits, and those sectors are then
+   written to the free map file, which puts them in the buffer
+   cache.  Normally that happens before the allocation or release
+   returns, inside the caller's journal operation, so that the
+   transaction holding the change also logs the free map sectors it
+   dirtied.  On a disk without a journal, free_map_defer makes it
+   wait for free_map_sync() instead, so that a sector changed many
+   times is written once: at reset_cache, fsync, shutdown, or when
+   the free map runs short of space.  (With a journal, the sectors
+   only go to disk at commits anyway.)
+
+   In that mode, released sectors also stay marked in use until the
+   next free_map_sync(), which frees them all in one batch and
+   writes the result. */
+static struct bitmap *dirty;         /* Dirty free map file sectors. */
+static struct bitmap *released;      /* Released, not yet synced. */
+static size_t released_cnt;          /* Number of bits in RELEASED. */
+
+/* The disk is divided into allocation groups of this many sectors.
+   An allocation looks first in the group of the sector it should be
+   near, then in the groups on either side of it, working outward,
+   so that a file's blocks land close to its inode and a new inode
+   close to its directory. */
+#define GROUP_SECTORS 1024
+
+/* Searches go through an index of the free extents, which is kept
+   in step with the free map and rebuilt from it whenever the map is
+   loaded.  If memory for the index runs out, it is dropped and
+   searches fall back to scanning the bitmap. */
+static bool extents_ok;              /* Is the free extent index usable? */
+
+/* Allocation goal meaning "anywhere", for which the best fit is
+   chosen. */
+#define NO_GOAL ((block_sector_t) -1)
+
+/* If true, free map writes wait for free_map_sync() on a disk
+   without a journal.
+   Controlled by kernel command-line option "-fmdefer". */
+bool free_map_defer;
+
+static bool allocate (size_t cnt, block_sector_t goal, block_sector_t *sectorp,
+                      bool reserved);
+static void sync_locked (void);
+static void write_dirty (void);
+static void rebuild_extents (void);
+
+/* Returns true if free map writes wait for free_map_sync(). */
+static bool
+deferring (void)
+{
+  return free_map_defer && !journal_enabled ();
+}
 
 /* Initializes the free map. */
 void
@@ -17,6 +80,57 @@ free_map_init (void)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  bitmap_set_multiple (free_map, JOURNAL_SECTOR, JOURNAL_SECTORS, true);
+  rebuild_extents ();
+  lock_init (&free_map_lock);
+  free_cnt = bitmap_count (free_map, 0, bitmap_size (free_map), false);
+  reserved_cnt = 0;
+
+  dirty = bitmap_create (DIV_ROUND_UP (bitmap_file_size (free_map),
+                                       BLOCK_SECTOR_SIZE));
+  released = bitmap_create (bitmap_size (free_map));
+  if (dirty == NULL || released == NULL)
+    PANIC ("bitmap creation failed--file system device is too large");
+  released_cnt = 0;
+}
+
+/* Stops using the free extent index, after running out of memory
+   for it. */
+static void
+drop_extents (void)
+{
+  free_extent_clear ();
+  extents_ok = false;
+}
+
+/* Rebuilds the free extent index from the free map. */
+static void
+rebuild_extents (void)
+{
+  size_t start, end;
+
+  free_extent_clear ();
+  extents_ok = true;
+  for (start = bitmap_scan (free_map, 0, 1, false);
+       start != BITMAP_ERROR && extents_ok;
+       start = bitmap_scan (free_map, end, 1, false))
+    {
+      end = bitmap_scan (free_map, start, 1, true);
+      if (end == BITMAP_ERROR)
+        end = bitmap_size (free_map);
+      if (!free_extent_add (start, end - start))
+        drop_extents ();
+    }
+}
+
+/* Marks dirty the free map file sectors holding the bits for
+   sectors START through START + CNT - 1. */
+static void
+mark_dirty (size_t start, size_t cnt)
+{
+  size_t first = start / CHAR_BIT / BLOCK_SECTOR_SIZE;
+  size_t last = (start + cnt - 1) / CHAR_BIT / BLOCK_SECTOR_SIZE;
+  bitmap_set_multiple (dirty, first, last - first + 1, true);
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -27,26 +141,289 @@ free_map_init (void)
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+  return allocate (cnt, NO_GOAL, sectorp, false);
+}
+
+/* Like free_map_allocate(), but places the CNT sectors as close
+   as it can to sector GOAL, preferably starting right at it. */
+bool
+free_map_allocate_near (size_t cnt, block_sector_t goal,
+                        block_sector_t *sectorp)
+{
+  return allocate (cnt, goal, sectorp, false);
+}
+
+/* Like free_map_allocate_near(), but takes the CNT sectors out of
+   an earlier free_map_reserve(), which they no longer count
+   against on success.  A single sector can always be allocated
+   this way. */
+bool
+free_map_allocate_reserved (size_t cnt, block_sector_t goal,
+                            block_sector_t *sectorp)
+{
+  return allocate (cnt, goal, sectorp, true);
+}
+
+/* Returns the first sector at or after START that begins a run of
+   CNT free sectors, or BITMAP_ERROR if there is none. */
+static size_t
+next_fit (size_t start, size_t cnt)
+{
+  if (extents_ok)
+    {
+      block_sector_t sector = free_extent_next_fit (start, cnt);
+      return sector != FREE_EXTENT_NONE ? sector : BITMAP_ERROR;
+    }
+  return bitmap_scan (free_map, start, cnt, false);
+}
+
+/* Returns the start of the smallest run of at least CNT free
+   sectors, or BITMAP_ERROR if there is none.  Without the index,
+   settles for the first run. */
+static size_t
+best_fit (size_t cnt)
+{
+  if (extents_ok)
+    {
+      block_sector_t sector = free_extent_best_fit (cnt);
+      return sector != FREE_EXTENT_NONE ? sector : BITMAP_ERROR;
+    }
+  return bitmap_scan (free_map, 0, cnt, false);
+}
+
+/* Returns the first run of CNT free sectors that starts in
+   allocation group GROUP at or after sector START, or BITMAP_ERROR
+   if there is none. */
+static size_t
+scan_group (size_t group, size_t start, size_t cnt)
+{
+  size_t sector = next_fit (start, cnt);
+  return sector / GROUP_SECTORS == group ? sector : BITMAP_ERROR;
+}
+
+/* Finds a run of CNT free sectors near GOAL: from GOAL on within
+   its own group, then anywhere in that group, then in the groups
+   at increasing distance from it, alternating after and before.
+   Every run starts in some group, so this only fails if there is
+   no run of CNT free sectors anywhere. */
+static size_t
+scan_near (size_t cnt, block_sector_t goal)
+{
+  size_t group_cnt = DIV_ROUND_UP (bitmap_size (free_map), GROUP_SECTORS);
+  size_t home, dist;
+  size_t sector;
+
+  if (goal == NO_GOAL)
+    return best_fit (cnt);
+  if (goal >= bitmap_size (free_map))
+    goal = 0;
+  home = goal / GROUP_SECTORS;
+  sector = scan_group (home, goal, cnt);
+  if (sector != BITMAP_ERROR)
+    return sector;
+
+  for (dist = 0; dist < group_cnt; dist++)
+    {
+      if (home + dist < group_cnt)
+        {
+          sector = scan_group (home + dist, (home + dist) * GROUP_SECTORS, cnt);
+          if (sector != BITMAP_ERROR)
+            return sector;
+        }
+      if (dist > 0 && dist <= home)
+        {
+          sector = scan_group (home - dist, (home - dist) * GROUP_SECTORS, cnt);
+          if (sector != BITMAP_ERROR)
+            return sector;
+        }
+    }
+  return BITMAP_ERROR;
+}
+
+/* Returns a goal for the inode of a new directory whose parent
+   directory's inode is at sector PARENT: the start of the group
+   with the most free sectors, taking the one nearest after
+   PARENT's own group if several tie.  Spreading directories out
+   this way leaves each one room for its files to gather around
+   it. */
+block_sector_t
+free_map_dir_goal (block_sector_t parent)
+{
+  size_t group_cnt = DIV_ROUND_UP (bitmap_size (free_map), GROUP_SECTORS);
+  size_t home = parent / GROUP_SECTORS % group_cnt;
+  size_t best = home, best_free = 0;
+  size_t i;
+
+  lock_acquire (&free_map_lock);
+  for (i = 0; i < group_cnt; i++)
+    {
+      size_t group = (home + i) % group_cnt;
+      size_t start = group * GROUP_SECTORS;
+      size_t cnt = bitmap_size (free_map) - start;
+      size_t group_free;
+
+      if (cnt > GROUP_SECTORS)
+        cnt = GROUP_SECTORS;
+      group_free = bitmap_count (free_map, start, cnt, false);
+      if (group_free > best_free)
+        {
+          best = group;
+          best_free = group_free;
+        }
+    }
+  lock_release (&free_map_lock);
+  return best * GROUP_SECTORS;
+}
+
+static bool
+allocate (size_t cnt, block_sector_t goal, block_sector_t *sectorp,
+          bool reserved)
+{
+  block_sector_t sector = BITMAP_ERROR;
+
+  lock_acquire (&free_map_lock);
+  ASSERT (!reserved || reserved_cnt >= cnt);
+  if (free_cnt - (reserved ? 0 : reserved_cnt) >= cnt)
+    sector = scan_near (cnt, goal);
+  if (sector == BITMAP_ERROR && released_cnt > 0)
     {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
+      /* Released sectors may make up the difference. */
+      sync_locked ();
+      if (free_cnt - (reserved ? 0 : reserved_cnt) >= cnt)
+        sector = scan_near (cnt, goal);
     }
   if (sector != BITMAP_ERROR)
-    *sectorp = sector;
+    {
+      bitmap_set_multiple (free_map, sector, cnt, true);
+      if (extents_ok && !free_extent_remove (sector, cnt))
+        drop_extents ();
+      mark_dirty (sector, cnt);
+      *sectorp = sector;
+      free_cnt -= cnt;
+      if (reserved)
+        reserved_cnt -= cnt;
+      if (!deferring ())
+        write_dirty ();
+    }
+  lock_release (&free_map_lock);
   return sector != BITMAP_ERROR;
 }
 
-/* Makes CNT sectors starting at SECTOR available for use. */
+/* Makes CNT sectors starting at SECTOR available for use, or when
+   deferring writes, available after the next free_map_sync(). */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
-  ASSERT (bitmap_all (free_map, sector, cnt));
-  bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  struct free_run run;
+
+  run.start = sector;
+  run.cnt = cnt;
+  free_map_release_runs (&run, 1);
+}
+
+/* Makes the RUN_CNT runs of sectors in RUNS available for use, or
+   when deferring writes, available after the next
+   free_map_sync(). */
+void
+free_map_release_runs (const struct free_run *runs, size_t run_cnt)
+{
+  size_t i;
+
+  lock_acquire (&free_map_lock);
+  for (i = 0; i < run_cnt; i++)
+    {
+      ASSERT (bitmap_all (free_map, runs[i].start, runs[i].cnt));
+      ASSERT (bitmap_none (released, runs[i].start, runs[i].cnt));
+      bitmap_set_multiple (released, runs[i].start, runs[i].cnt, true);
+      released_cnt += runs[i].cnt;
+    }
+  if (!deferring ())
+    sync_locked ();
+  lock_release (&free_map_lock);
+}
+
+/* Frees the released sectors and writes every dirty sector of the
+   free map file.  Must be called with free_map_lock held. */
+static void
+sync_locked (void)
+{
+  size_t i, end;
+
+  for (i = bitmap_scan (released, 0, 1, true); i != BITMAP_ERROR;
+       i = bitmap_scan (released, end, 1, true))
+    {
+      end = bitmap_scan (released, i, 1, false);
+      if (end == BITMAP_ERROR)
+        end = bitmap_size (released);
+      bitmap_set_multiple (released, i, end - i, false);
+      bitmap_set_multiple (free_map, i, end - i, false);
+      if (extents_ok && !free_extent_add (i, end - i))
+        drop_extents ();
+      mark_dirty (i, end - i);
+    }
+  free_cnt += released_cnt;
+  released_cnt = 0;
+  write_dirty ();
+}
+
+/* Writes every dirty sector of the free map file.  Must be called
+   with free_map_lock held. */
+static void
+write_dirty (void)
+{
+  size_t i;
+
+  if (free_map_file == NULL)
+    return;
+  for (i = bitmap_scan (dirty, 0, 1, true); i != BITMAP_ERROR;
+       i = bitmap_scan (dirty, i + 1, 1, true))
+    {
+      if (!bitmap_write_part (free_map, free_map_file,
+                              i * BLOCK_SECTOR_SIZE, BLOCK_SECTOR_SIZE))
+        PANIC ("can't write free map");
+      bitmap_reset (dirty, i);
+    }
+}
+
+/* Writes all changes to the free map since the last call to the
+   free map file, and lets sectors released since then be reused. */
+void
+free_map_sync (void)
+{
+  journal_begin ();
+  lock_acquire (&free_map_lock);
+  sync_locked ();
+  lock_release (&free_map_lock);
+  journal_end ();
+}
+
+/* Sets aside CNT free sectors, without choosing which, so that
+   later free_map_allocate_reserved() calls for them cannot run out
+   of space.  Returns false if fewer than CNT unreserved sectors are
+   free. */
+bool
+free_map_reserve (size_t cnt)
+{
+  bool success;
+
+  lock_acquire (&free_map_lock);
+  if (free_cnt - reserved_cnt < cnt && released_cnt > 0)
+    sync_locked ();
+  success = free_cnt - reserved_cnt >= cnt;
+  if (success)
+    reserved_cnt += cnt;
+  lock_release (&free_map_lock);
+  return success;
+}
+
+/* Gives back CNT sectors reserved with free_map_reserve(). */
+void
+free_map_unreserve (size_t cnt)
+{
+  lock_acquire (&free_map_lock);
+  ASSERT (reserved_cnt >= cnt);
+  reserved_cnt -= cnt;
+  lock_release (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -58,12 +435,44 @@ free_map_open (void)
     PANIC ("can't open free map");
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
+  free_cnt = bitmap_count (free_map, 0, bitmap_size (free_map), false);
+  rebuild_extents ();
+}
+
+/* Returns the number of sectors in the longest run of free
+   sectors. */
+size_t
+free_map_largest (void)
+{
+  size_t largest = 0;
+
+  lock_acquire (&free_map_lock);
+  if (extents_ok)
+    largest = free_extent_largest ();
+  else
+    {
+      size_t start, end;
+
+      for (start = bitmap_scan (free_map, 0, 1, false);
+           start != BITMAP_ERROR;
+           start = bitmap_scan (free_map, end, 1, false))
+        {
+          end = bitmap_scan (free_map, start, 1, true);
+          if (end == BITMAP_ERROR)
+            end = bitmap_size (free_map);
+          if (end - start > largest)
+            largest = end - start;
+        }
+    }
+  lock_release (&free_map_lock);
+  return largest;
 }
 
 /* Writes the free map to disk and closes the free map file. */
 void
 free_map_close (void) 
 {
+  free_map_sync ();
   file_close (free_map_file);
 }
 
@@ -76,10 +485,15 @@ free_map_create (void)
   if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map), false))
     PANIC ("free map creation failed");
 
-  /* Write bitmap to file. */
-  free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
-  if (free_map_file == NULL)
+  /* Write bitmap to file.  Files are sparse, so this first write
+     allocates the free map's own sectors; free_map_file stays null
+     until then so that those allocations do not recursively write
+     the free map file while it is being written. */
+  struct file *file = file_open (inode_open (FREE_MAP_SECTOR));
+  if (file == NULL)
     PANIC ("can't open free map");
-  if (!bitmap_write (free_map, free_map_file))
+  if (!bitmap_write (free_map, file))
     PANIC ("can't write free map");
+  bitmap_set_all (dirty, false);
+  free_map_file = file;
 }
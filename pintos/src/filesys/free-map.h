@@ -5,6 +5,18 @@
 #include <stddef.h>
 #include "devices/block.h"
 
+/* A run of CNT consecutive sectors starting at START. */
+struct free_run
+  {
+    block_sector_t start;
+    size_t cnt;
+  };
+
+/* If true, free map writes wait for free_map_sync() on a disk
+   without a journal.
+   Controlled by kernel command-line option "-fmdefer". */
+extern bool free_map_defer;
+
 void free_map_init (void);
 void free_map_read (void);
 void free_map_create (void);
@@ -12,7 +24,16 @@ void free_map_open (void);
 void free_map_close (void);
 
 bool free_map_allocate (size_t, block_sector_t *);
+bool free_map_allocate_near (size_t, block_sector_t goal, block_sector_t *);
+block_sector_t free_map_dir_goal (block_sector_t parent);
 void free_map_release (block_sector_t, size_t);
+void free_map_release_runs (const struct free_run *, size_t run_cnt);
+void free_map_sync (void);
+bool free_map_reserve (size_t);
+void free_map_unreserve (size_t);
+bool free_map_allocate_reserved (size_t, block_sector_t goal,
+                                 block_sector_t *);
+size_t free_map_largest (void);
 
 size_t
 free_map_acquire (size_t cnt, block_sector_t *sectorp);
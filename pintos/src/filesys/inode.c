@@ -4,10 +4,13 @@
 #include <round.h>
 #include <string.h>
 #include <stdio.h>
+#include <uio.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/thread.h"
 #include "filesys/cache.h"
+#include "filesys/journal.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -15,13 +18,39 @@
 /* Number of direct sectors. */
 #define NUM_DIRECT_SECTORS 124
 
+/* Number of block pointers in an indirect block. */
+#define PTRS_PER_BLOCK 128
+
+/* Largest file, in sectors, that the pointer tree can map. */
+#define MAX_FILE_SECTORS (NUM_DIRECT_SECTORS + PTRS_PER_BLOCK \
+                          + PTRS_PER_BLOCK * PTRS_PER_BLOCK)
+
+/* Byte offsets of the block pointers within struct inode_disk. */
+#define DIRECT_PTR_OFS(i) (sizeof (off_t) + (i) * sizeof (block_sector_t))
+#define IND_PTR_OFS DIRECT_PTR_OFS (NUM_DIRECT_SECTORS)
+#define DBL_IND_PTR_OFS DIRECT_PTR_OFS (NUM_DIRECT_SECTORS + 1)
+
+/* Set in a data block pointer whose sector was preallocated by
+   inode_allocate() but never written.  The disk holds garbage there,
+   so such a block reads as zeros. */
+#define PTR_UNWRITTEN 0x80000000
+#define PTR_SECTOR(ptr) ((ptr) & ~PTR_UNWRITTEN)
+
+/* A file of at most INLINE_MAX bytes keeps its data in the inode_disk
+   sector itself, in place of the direct pointers, and has no data
+   blocks.  Reading it costs no disk access beyond the inode_disk
+   sector, which is read anyway to learn the length.  Files never
+   shrink, so whether a file is inline follows from its length. */
+#define INLINE_OFS DIRECT_PTR_OFS (0)
+#define INLINE_MAX (NUM_DIRECT_SECTORS * (off_t) sizeof (block_sector_t))
+
 void checkout(struct inode *inode);
-void flush_indirect_block(block_sector_t indirect_block_ptr);
 bool inode_resize(struct inode *inode, off_t size);
-void inode_close_dir_ptrs (struct inode *inode);
-void inode_close_indir_ptr (struct inode *inode);
-void close_indir_ptr (block_sector_t block);
-void inode_close_double_indir_ptr (struct inode *inode);
+struct release_batch;
+void inode_close_dir_ptrs (block_sector_t data, struct release_batch *);
+void inode_close_indir_ptr (block_sector_t data, struct release_batch *);
+void close_indir_ptr (block_sector_t block, struct release_batch *);
+void inode_close_double_indir_ptr (block_sector_t data, struct release_batch *);
 bool inode_resize_no_check(struct inode *inode, off_t size);
 bool inode_is_dir (struct inode *inode); // return true if inode is dir
 
@@ -64,18 +93,6 @@ bytes_to_sectors (off_t size)
   return DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
 }
 
-static void
-zero_block (block_sector_t block) {
-  off_t divisions = 8;
-  ASSERT (BLOCK_SECTOR_SIZE % (sizeof(block_sector_t) * divisions) == 0);
-  size_t buf_len = BLOCK_SECTOR_SIZE / (sizeof(block_sector_t) * divisions);
-  block_sector_t zero_buf[buf_len];
-  memset(zero_buf, 0, BLOCK_SECTOR_SIZE / divisions);
-  for (int i = 0; i < divisions; i++) {
-    cache_write(fs_device, block, &zero_buf, i * buf_len * sizeof(block_sector_t), buf_len * sizeof(block_sector_t));
-  }
-}
-
 /* In-memory inode. */
 struct inode
   {
@@ -101,15 +118,69 @@ struct inode
     int numRWing; // current accessor(s)
     struct condition waitActiveWriters; // To force file_deny_write to wait for all writers to finish
 
-    struct lock dir_lock;               /* Lock only used if inode refers to a directory; size = 24 bytes*/
+    struct rwlock dir_lock;             /* Directory entries; see inode_dir_lock_read(). */
+    struct list delayed;                /* Delayed blocks, ordered by index. */
+    off_t dir_slot_hint;                /* No free directory slot before this. */
     bool is_dir;                        /* 0 if not dir, 1 otw */
+    bool dir_hashed;                    /* Directory has a hashed index. */
 
-    uint8_t unused[86 * 4 - sizeof(struct lock) - sizeof(bool)];
+    uint8_t unused[86 * 4 - sizeof(struct rwlock) - 2 * sizeof(bool) - sizeof(struct list) - sizeof(off_t)];
 
     unsigned magic;                     /* Magic number. */
 
   };
 
+/* A data block that has been written but not yet given a sector
+   (delayed allocation).  Its contents live in the buffer cache under
+   a placeholder number at or above CACHE_DELAYED_SECTOR, and a free
+   sector is reserved for it so that writing it back cannot fail.
+   Choosing sectors only when many blocks of a file are known lets
+   consecutive blocks land on one contiguous run of the disk, instead
+   of being interleaved with whatever else was written meanwhile. */
+struct delayed_block
+  {
+    struct list_elem elem;              /* Element in inode's delayed list. */
+    size_t index;                       /* Block index within the file. */
+    block_sector_t sector;              /* Placeholder cache sector. */
+  };
+
+/* Delayed blocks are pinned in the buffer cache, so only this many
+   may exist at once, across all inodes. */
+#define MAX_DELAYED_BLOCKS (MAX_CACHE_BLOCKS / 2)
+
+static struct lock delayed_lock;        /* Protects the two below. */
+static int delayed_cnt;                 /* Delayed blocks in existence. */
+static block_sector_t next_delayed_sector; /* Next placeholder number. */
+
+static void flush_delayed (struct inode *);
+static void discard_delayed (struct inode *);
+static block_sector_t block_goal (struct inode *, size_t index);
+
+/* Removed inodes whose sectors the reclaim thread has yet to free,
+   when inode_background_reclaim is set. */
+struct reclaim_work
+  {
+    struct list_elem elem;              /* Element in reclaim_list. */
+    block_sector_t sector;              /* Sector of the inode. */
+    block_sector_t data;                /* Its inode_disk sector. */
+  };
+
+/* Files longer than this are freed in the background. */
+#define RECLAIM_MIN_LENGTH (PTRS_PER_BLOCK * BLOCK_SECTOR_SIZE)
+
+/* If true, the blocks of large deleted files are freed by a kernel
+   thread instead of by the last inode_close().
+   Controlled by kernel command-line option "-bgfree". */
+bool inode_background_reclaim;
+
+static struct list reclaim_list;
+static struct lock reclaim_lock;        /* Protects the next three. */
+static int reclaim_busy;                /* Work popped but not yet done. */
+static struct condition reclaim_idle;   /* Signaled when busy drops to 0. */
+static struct semaphore reclaim_sema;   /* Counts queued work. */
+
+static void reclaim_thread (void *aux);
+
 /* Called by access methods to this inode before actually
    accessing or modifying any data within the inode. 
    Type 0 is reading, and type 1 is writing. */
@@ -156,240 +227,429 @@ checkout (struct inode *inode)
   lock_release(&(inode->dataCheckIn));
 }
 
-/* Returns the block device sector that contains byte offset POS
-   within INODE.
-   Returns -1 if INODE does not contain data for a byte at offset
-   POS.
-   We modified this because of our new inode implementation. */
-static block_sector_t
-byte_to_sector (const struct inode *inode, off_t pos)
+/* Returns true if INODE's contents are metadata, which the journal
+   logs: a directory's entries, or the free map. */
+static bool
+is_journaled (const struct inode *inode)
 {
-  /* Number of bytes that only direct pointers can handle. */
-  int direct_bytes = NUM_DIRECT_SECTORS * BLOCK_SECTOR_SIZE;
-  /* Number of bytes up to the indirect pointer case. */
-  int indirect_bytes = NUM_DIRECT_SECTORS * BLOCK_SECTOR_SIZE +
-                             128 * BLOCK_SECTOR_SIZE;
+  return inode->is_dir || inode->sector == FREE_MAP_SECTOR;
+}
 
-  block_sector_t return_val;
+/* Writes SIZE bytes from BUFFER to INODE's metadata sector SECTOR
+   at byte offset OFS, as part of the running journal transaction. */
+static void
+write_meta (const struct inode *inode, block_sector_t sector,
+            const void *buffer, off_t ofs, int size)
+{
+  journal_write (sector, buffer, ofs, size, inode->sector);
+}
 
-  ASSERT (inode != NULL);
-  ASSERT (pos >= 0);
+/* Writes SIZE bytes from BUFFER to sector SECTOR of INODE's data at
+   byte offset OFS, through the journal if INODE is journaled. */
+static void
+write_data (struct inode *inode, block_sector_t sector, const void *buffer,
+            off_t ofs, int size)
+{
+  if (is_journaled (inode))
+    write_meta (inode, sector, buffer, ofs, size);
+  else
+    cache_write (fs_device, sector, buffer, ofs, size, inode->sector);
+}
 
-  off_t length;
-  cache_read(fs_device, inode->data, &length, 0, sizeof(off_t));
+/* Starts SECTOR, newly given to INODE, from zeros, so that a crash
+   cannot leave a pointer to it aimed at whatever the disk held
+   there.  A metadata block (if META) is logged with the running
+   transaction; a data block is written home right away instead,
+   before the transaction that records the pointer can commit, so
+   that file data stays out of the journal. */
+static void
+zero_block (const struct inode *inode, block_sector_t sector, bool meta)
+{
+  cache_zero(fs_device, sector, inode->sector);
+  if (meta)
+    journal_dirty(sector);
+  else
+    cache_write_back(sector);
+}
 
-  // If the offset is not within the file, return -1
-  if (pos >= length) {
-    return -1;
+/* Reads the block pointer stored at byte offset OFS of INODE's
+   metadata sector SECTOR.  A pointer of 0 is a hole.  If ALLOCATE is true, a hole is filled
+   with a freshly allocated, zeroed sector first, placed as near
+   sector GOAL as the free map allows.  META tells whether the
+   block pointed to is metadata, as for zero_block().
+   Returns the pointer, which is 0 only for a hole that was not
+   (or, when the disk is full, could not be) allocated. */
+static block_sector_t
+get_block_ptr (const struct inode *inode, block_sector_t sector, off_t ofs,
+               bool allocate, block_sector_t goal, bool meta)
+{
+  block_sector_t ptr;
+  cache_read(fs_device, sector, &ptr, ofs, sizeof(ptr));
+  if (ptr == 0 && allocate && free_map_allocate_near(1, goal, &ptr)) {
+    zero_block(inode, ptr, meta);
+    write_meta(inode, sector, &ptr, ofs, sizeof(ptr));
   }
+  return ptr;
+}
+
+/* Finds where the pointer to data block INDEX of INODE is stored,
+   as a byte offset *OFS within sector *SECTOR.  With ALLOCATE,
+   missing indirect blocks are allocated on the way down.
+   Returns false if an indirect block is missing (and could not be
+   allocated) or if INDEX is beyond the largest possible file. */
+static bool
+locate_block_ptr (const struct inode *inode, size_t index, bool allocate,
+                  block_sector_t *sector, off_t *ofs)
+{
   // Direct pointers
-  if (pos < direct_bytes) {
-    off_t block_pos = sizeof(off_t) + pos/BLOCK_SECTOR_SIZE * sizeof(block_sector_t);
-    cache_read(fs_device, inode->data, &return_val, block_pos, sizeof(block_sector_t));
-    return return_val;
+  if (index < NUM_DIRECT_SECTORS) {
+    *sector = inode->data;
+    *ofs = DIRECT_PTR_OFS(index);
+    return true;
   }
-  // Indirect pointers
-  if (pos < indirect_bytes) { // indirect pointer
-    off_t ind_blk_pos = sizeof(off_t) + NUM_DIRECT_SECTORS * sizeof(block_sector_t);
-    block_sector_t ind_blk_ptr;
-    cache_read(fs_device, inode->data, &ind_blk_ptr, ind_blk_pos, sizeof(block_sector_t));
-    if (ind_blk_ptr == 0) {
-      PANIC("File claims to have indirect block, but it is not initialized");
-    }
+  index -= NUM_DIRECT_SECTORS;
 
-    off_t blk_index = (pos - direct_bytes) / BLOCK_SECTOR_SIZE * sizeof(block_sector_t);
-    cache_read(fs_device, ind_blk_ptr, &return_val, blk_index, sizeof(block_sector_t));
-    return return_val;
-  }
-  // doubly indirect
-  off_t dbl_ind_blk_pos = sizeof(off_t) + (NUM_DIRECT_SECTORS + 1) * sizeof(block_sector_t);
-  block_sector_t dbl_ind_blk_ptr;
-  cache_read(fs_device, inode->data, &dbl_ind_blk_ptr, dbl_ind_blk_pos, sizeof(block_sector_t));
-  if (dbl_ind_blk_ptr == 0) {
-    PANIC("File claims to have doubly indirect block, but it is not initialized");
+  // Indirect pointers
+  if (index < PTRS_PER_BLOCK) {
+    *sector = get_block_ptr(inode, inode->data, IND_PTR_OFS, allocate,
+                            inode->sector, true);
+    *ofs = index * sizeof(block_sector_t);
+    return *sector != 0;
   }
+  index -= PTRS_PER_BLOCK;
 
-  off_t next_blk_index = (pos - direct_bytes - indirect_bytes) / (128 * BLOCK_SECTOR_SIZE) * sizeof(block_sector_t);
-  block_sector_t next_blk_ptr;
-  cache_read(fs_device, dbl_ind_blk_ptr, &next_blk_ptr, next_blk_index, sizeof(block_sector_t));
-  if (next_blk_ptr == 0) {
-    return -1;
+  // Doubly indirect
+  if (index < PTRS_PER_BLOCK * PTRS_PER_BLOCK) {
+    block_sector_t dbl_ind_blk_ptr = get_block_ptr(inode, inode->data, DBL_IND_PTR_OFS,
+                                                   allocate, inode->sector, true);
+    if (dbl_ind_blk_ptr == 0) {
+      return false;
+    }
+    *sector = get_block_ptr(inode, dbl_ind_blk_ptr,
+                            index / PTRS_PER_BLOCK * sizeof(block_sector_t),
+                            allocate, inode->sector, true);
+    *ofs = index % PTRS_PER_BLOCK * sizeof(block_sector_t);
+    return *sector != 0;
   }
+  return false;
+}
 
-  off_t skipped_dbl_bytes = (next_blk_index * 128 * BLOCK_SECTOR_SIZE);
-  off_t blk_index = (pos - direct_bytes - indirect_bytes - skipped_dbl_bytes) / BLOCK_SECTOR_SIZE * sizeof(block_sector_t);
-  cache_read(fs_device, next_blk_ptr, &return_val, blk_index, sizeof(block_sector_t));
-  return return_val;
-}
-
-/* Helper function for inode_resize. Assumes that INDIRECT_BLOCK_PTR
- * is an indirect block pointer that is already populated with block sectors.
- * It basically release all of the indirect blocks. Does not release indirect_block_ptr! */
-void flush_indirect_block(block_sector_t indirect_block_ptr) {
-  for (int i = 0; i < 128; i ++) {
-    off_t byte_off = i * sizeof(block_sector_t);
-    block_sector_t ptr;
-    cache_read(fs_device, indirect_block_ptr, &ptr, byte_off, sizeof(ptr));
-    if (ptr != 0) {
-      free_map_release(ptr, 1);
-      ptr = 0;
-      cache_write(fs_device, indirect_block_ptr, &ptr, byte_off, sizeof(ptr));
+/* Returns INODE's delayed block with the given INDEX, or a null
+   pointer if there is none. */
+static struct delayed_block *
+find_delayed (struct inode *inode, size_t index)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&inode->delayed); e != list_end (&inode->delayed);
+       e = list_next (e))
+    {
+      struct delayed_block *d = list_entry (e, struct delayed_block, elem);
+      if (d->index == index)
+        return d;
     }
-  }
+  return NULL;
 }
 
-/* Helper function adapted from last year's discussion.
- * It will resize the INODE to size SIZE bytes, and sets the length
- * member accordingly. Automatically calls cache_write, but
- * be sure to cache inode in the caller!
- * Furthermore, be sure that after acquiring the inode's resizing lock
- * to check whether or not another thread already resized the inode during
- * the period of time in which the current thread saw the need to
- * resize the inode and when the current thread acquired the resize lock.
- * Also frees the lock acquired by the initial inode. */
-bool inode_resize_no_check(struct inode *inode, off_t size) {
-    // Check if another thread already resized before we could start resizing
-  if (inode_length (inode) >= size) {
-    return true;
-  }
+static bool
+delayed_less (const struct list_elem *a_, const struct list_elem *b_,
+              void *aux UNUSED)
+{
+  const struct delayed_block *a = list_entry (a_, struct delayed_block, elem);
+  const struct delayed_block *b = list_entry (b_, struct delayed_block, elem);
+  return a->index < b->index;
+}
 
-  off_t cur_len;
-  cache_read(fs_device, inode->data, &cur_len, 0, sizeof(cur_len));
+/* Makes data block INDEX of INODE, currently a hole, a delayed block
+   and returns its placeholder sector, or 0 if the block must be
+   allocated right away instead.  The indirect blocks leading to it
+   are allocated now, so that flush_delayed() only has data blocks
+   left to place. */
+static block_sector_t
+delay_block (struct inode *inode, size_t index)
+{
+  struct delayed_block *d;
+  block_sector_t sector;
+  off_t ofs;
+  bool room;
+
+  /* The free map's own blocks are written while allocating, and the
+     journal can only log blocks that have a sector. */
+  if (is_journaled (inode))
+    return 0;
 
-  /* Perform iteration up to the number of direct sectors */
-  for (int i = 0; i < NUM_DIRECT_SECTORS; i ++) {
-    block_sector_t dir_blk;
-    off_t dir_blk_off = i * sizeof(block_sector_t) + sizeof(off_t);
-    cache_read(fs_device, inode->data, &dir_blk, dir_blk_off, sizeof(block_sector_t));
-    if ((size <= BLOCK_SECTOR_SIZE * i) &&
-        (dir_blk != 0)) {
-      free_map_release(dir_blk, 1);
-      dir_blk = 0;
-      cache_write(fs_device, inode->data, &dir_blk, dir_blk_off, sizeof(block_sector_t));
-    }
-    // Somehow, if the previous blocks haven't been allocated, do so here!
-    if ((size > BLOCK_SECTOR_SIZE * i) &&
-        (dir_blk == 0)) {
-      bool status = free_map_allocate(1, &dir_blk);
-      if (!status) {
-        // if we fail to resize, shrink back
-        inode_resize(inode, cur_len);
-        return false;
-      }
-      cache_write(fs_device, inode->data, &dir_blk, dir_blk_off, sizeof(block_sector_t));
+  lock_acquire (&delayed_lock);
+  room = delayed_cnt < MAX_DELAYED_BLOCKS;
+  if (room)
+    delayed_cnt++;
+  lock_release (&delayed_lock);
+  if (!room)
+    {
+      /* Make room by writing back our own delayed blocks, if any. */
+      if (list_empty (&inode->delayed))
+        return 0;
+      flush_delayed (inode);
+      return delay_block (inode, index);
     }
-  }
 
-  /* Success case: indirect blocks */
-  block_sector_t ind_blk_ptr;
-  off_t end_dir_off = NUM_DIRECT_SECTORS * sizeof(block_sector_t) + sizeof(off_t);
-  cache_read(fs_device, inode->data, &ind_blk_ptr, end_dir_off, sizeof(block_sector_t));
+  d = malloc (sizeof *d);
+  if (d == NULL || !locate_block_ptr (inode, index, true, &sector, &ofs)
+      || !free_map_reserve (1))
+    {
+      free (d);
+      lock_acquire (&delayed_lock);
+      delayed_cnt--;
+      lock_release (&delayed_lock);
+      return 0;
+    }
 
-  // If we're not dealing with indirect blocks, and the file does not have indirect blocks, exit now
-  if (ind_blk_ptr == 0 && size < NUM_DIRECT_SECTORS * BLOCK_SECTOR_SIZE) {
-    cache_write(fs_device, inode->data, &size, 0, sizeof(off_t));
-    return true;
-  }
-  // Allocate a new sector for the indirect pointers
-  if (ind_blk_ptr == 0) {
-    bool status = free_map_allocate(1, &(ind_blk_ptr));
-    if (!status) {
-      inode_resize(inode, size);
-      return false;
+  lock_acquire (&delayed_lock);
+  d->sector = CACHE_DELAYED_SECTOR + next_delayed_sector++ % CACHE_DELAYED_SECTOR;
+  lock_release (&delayed_lock);
+  d->index = index;
+  cache_zero (fs_device, d->sector, inode->sector);
+  list_insert_ordered (&inode->delayed, &d->elem, delayed_less, NULL);
+  return d->sector;
+}
+
+/* Gives every delayed block of INODE a sector, placing each run of
+   consecutive blocks in as few contiguous stretches of the disk as
+   the free map allows.  The caller must have write access to INODE
+   or be its last user. */
+static void
+flush_delayed (struct inode *inode)
+{
+  int flushed = 0;
+
+  while (!list_empty (&inode->delayed))
+    {
+      struct delayed_block *first = list_entry (list_front (&inode->delayed),
+                                                struct delayed_block, elem);
+      struct list_elem *e;
+      block_sector_t start;
+      size_t cnt = 1, largest;
+
+      /* Length of the run of consecutive indexes at the front. */
+      for (e = list_next (&first->elem); e != list_end (&inode->delayed);
+           e = list_next (e))
+        {
+          if (list_entry (e, struct delayed_block, elem)->index != first->index + cnt)
+            break;
+          cnt++;
+        }
+
+      /* Take the run whole if the disk has room for it in one piece,
+         otherwise as much of its front as fits. */
+      largest = free_map_largest ();
+      if (cnt > largest && largest > 0)
+        cnt = largest;
+      while (!free_map_allocate_reserved (cnt, block_goal (inode, first->index),
+                                          &start))
+        {
+          ASSERT (cnt > 1);
+          cnt /= 2;
+        }
+
+      for (size_t i = 0; i < cnt; i++)
+        {
+          struct delayed_block *d = list_entry (list_pop_front (&inode->delayed),
+                                                struct delayed_block, elem);
+          block_sector_t ptr = start + i;
+          block_sector_t sector;
+          off_t ofs;
+
+          if (!locate_block_ptr (inode, d->index, false, &sector, &ofs))
+            NOT_REACHED ();
+          cache_rename (d->sector, ptr);
+          write_meta (inode, sector, &ptr, ofs, sizeof(ptr));
+          free (d);
+        }
+      flushed += cnt;
     }
-    cache_write(fs_device, inode->data, &ind_blk_ptr, end_dir_off, sizeof(ind_blk_ptr));
-    // Zero the new block
-    zero_block(ind_blk_ptr);
-  }
 
-  for (int i = 0; i < 128; i ++) {
-    block_sector_t ind_ptr;
-    off_t ind_blk_off = i * sizeof(block_sector_t);
-    cache_read(fs_device, ind_blk_ptr, &ind_ptr, ind_blk_off, sizeof(block_sector_t));
-    if (size <= (NUM_DIRECT_SECTORS + i) * BLOCK_SECTOR_SIZE && ind_ptr != 0) {
-      free_map_release(ind_ptr, 1);
-      ind_ptr = 0;
-      cache_write(fs_device, ind_blk_ptr, &ind_ptr, ind_blk_off, sizeof(block_sector_t));
-    }
-    // Somehow, if the previous blocks haven't been allocated, do so here!
-    if ((size > (NUM_DIRECT_SECTORS + i) * BLOCK_SECTOR_SIZE) && ind_ptr == 0) {
-      bool status = free_map_allocate(1, &ind_ptr);
-      if (!status) {
-        inode_resize(inode, cur_len);
-        return false;
-      }
-      cache_write(fs_device, ind_blk_ptr, &ind_ptr, ind_blk_off, sizeof(block_sector_t));
+  lock_acquire (&delayed_lock);
+  delayed_cnt -= flushed;
+  lock_release (&delayed_lock);
+}
+
+/* Throws away the delayed blocks of INODE, which is being deleted. */
+static void
+discard_delayed (struct inode *inode)
+{
+  int discarded = 0;
+
+  while (!list_empty (&inode->delayed))
+    {
+      struct delayed_block *d = list_entry (list_pop_front (&inode->delayed),
+                                            struct delayed_block, elem);
+      cache_discard (d->sector);
+      free (d);
+      discarded++;
     }
-  }
+  free_map_unreserve (discarded);
 
-  /* Success case: doubly indirect blocks */
-  int size_check_double = NUM_DIRECT_SECTORS * BLOCK_SECTOR_SIZE + (128 * BLOCK_SECTOR_SIZE);
-  block_sector_t blk1_ptr;
-  off_t dbl_ptr_off = end_dir_off + sizeof(block_sector_t);
-  cache_read(fs_device, inode->data, &blk1_ptr, dbl_ptr_off, sizeof(block_sector_t));
+  lock_acquire (&delayed_lock);
+  delayed_cnt -= discarded;
+  lock_release (&delayed_lock);
+}
 
-  // If we're not dealing with doubly indirect blocks, and the file does not have doubly indirect blocks, exit now
-  if (blk1_ptr == 0 && size < size_check_double) {
-    cache_write(fs_device, inode->data, &size, 0, sizeof(off_t));
-    return true;
-  }
+/* Returns the pointer stored for data block INDEX of INODE, or 0 if
+   there is none. */
+static block_sector_t
+read_block_ptr (struct inode *inode, size_t index)
+{
+  block_sector_t sector, ptr = 0;
+  off_t ofs;
 
-  // If we haven't set our doubly indirect block pointer
-  if (blk1_ptr == 0) {
-    bool status = free_map_allocate(1, &blk1_ptr);
-    if (!status) {
-      inode_resize(inode, cur_len);
-      return false;
+  if (locate_block_ptr (inode, index, false, &sector, &ofs))
+    cache_read (fs_device, sector, &ptr, ofs, sizeof(ptr));
+  return ptr;
+}
+
+/* Returns the sector where data block INDEX of INODE should go:
+   right after block INDEX - 1 if that one is on disk, so that the
+   file reads sequentially, and otherwise next to the inode. */
+static block_sector_t
+block_goal (struct inode *inode, size_t index)
+{
+  block_sector_t prev = index > 0 ? PTR_SECTOR (read_block_ptr (inode, index - 1)) : 0;
+  return prev != 0 ? prev + 1 : inode->sector;
+}
+
+/* Returns the sector holding data block INDEX of INODE, or 0 if that
+   block has never been written.  A block waiting for delayed
+   allocation is returned as its placeholder sector, which the buffer
+   cache serves like any other.  With ALLOCATE, a hole is made a
+   delayed block, or given a sector right away when that is not
+   possible, and a preallocated block is marked written; 0 then means
+   the disk is full or INDEX is beyond the largest possible file. */
+static block_sector_t
+index_to_sector (struct inode *inode, size_t index, bool allocate)
+{
+  struct delayed_block *d;
+  block_sector_t sector, ptr;
+  off_t ofs;
+
+  ptr = read_block_ptr (inode, index);
+  if (ptr & PTR_UNWRITTEN)
+    {
+      if (!allocate)
+        return 0;
+
+      ptr = PTR_SECTOR (ptr);
+      zero_block (inode, ptr, is_journaled (inode));
+      if (!locate_block_ptr (inode, index, false, &sector, &ofs))
+        NOT_REACHED ();
+      write_meta (inode, sector, &ptr, ofs, sizeof(ptr));
+      return ptr;
     }
-    cache_write(fs_device, inode->data, &blk1_ptr, dbl_ptr_off, sizeof(block_sector_t));
-    zero_block(blk1_ptr);
-  }
+  if (ptr != 0)
+    return ptr;
 
-  // Iterate through pointers to pointer blocks
-  for (int i = 0; i < 128; i ++) {
-    block_sector_t blk2_ptr;
-    off_t blk1_off = i * sizeof(block_sector_t);
-    cache_read(fs_device, blk1_ptr, &blk2_ptr, blk1_off, sizeof(blk2_ptr));
+  d = find_delayed (inode, index);
+  if (d != NULL)
+    return d->sector;
+  if (!allocate || index >= MAX_FILE_SECTORS)
+    return 0;
 
-    if (size <= (NUM_DIRECT_SECTORS + (i + 1) * 128) * BLOCK_SECTOR_SIZE && blk2_ptr != 0) {
-      // Release every block within the indirect block
-      flush_indirect_block(blk2_ptr);
-      free_map_release(blk2_ptr, 1);
-      blk2_ptr = 0;
-      cache_write(fs_device, blk1_ptr, &blk2_ptr, blk1_off, sizeof(blk2_ptr));
+  ptr = delay_block (inode, index);
+  if (ptr == 0 && locate_block_ptr (inode, index, true, &sector, &ofs))
+    ptr = get_block_ptr (inode, sector, ofs, true, block_goal (inode, index),
+                         is_journaled (inode));
+  return ptr;
+}
+
+/* Moves the LENGTH bytes of INODE's inline data out to data block 0,
+   so that the direct pointer area holds block pointers again, and
+   gets a sector for block FIRST_INDEX, the first block the caller is
+   about to write.  Once that block exists, the write is sure to take
+   the file past INLINE_MAX bytes, which keeps the length in step with
+   the layout.  If the disk is full, puts the inline data back and
+   returns false. */
+static bool
+move_inline_data (struct inode *inode, off_t length, size_t first_index)
+{
+  static const uint8_t zeros[INLINE_MAX];
+  block_sector_t sector = 0;
+  uint8_t *data;
+
+  data = malloc (INLINE_MAX);
+  if (data == NULL)
+    return false;
+  cache_read (fs_device, inode->data, data, INLINE_OFS, INLINE_MAX);
+  write_meta (inode, inode->data, zeros, INLINE_OFS, INLINE_MAX);
+
+  if (length > 0)
+    {
+      sector = index_to_sector (inode, 0, true);
+      if (sector != 0)
+        write_data (inode, sector, data, 0, length);
+    }
+  if ((length == 0 || sector != 0)
+      && index_to_sector (inode, first_index, true) != 0)
+    {
+      free (data);
+      return true;
     }
 
-    if (size > (NUM_DIRECT_SECTORS + (i + 1) * 128) * BLOCK_SECTOR_SIZE && blk2_ptr == 0) {
-      bool status = free_map_allocate(1, &blk2_ptr);
-      if (!status) {
-        inode_resize(inode, cur_len);
-        return false;
-      }
-      cache_write(fs_device, blk1_ptr, &blk2_ptr, blk1_off, sizeof(blk2_ptr));
-      // Then allocate the appropriate number of blocks
-      for (int j = 0; j < 128; j ++) {
-        off_t final_off = j * sizeof(block_sector_t);
-        block_sector_t final_ptr;
-        cache_read(fs_device, blk2_ptr, &final_ptr, final_off, sizeof(final_ptr));
-        if ((size <= (NUM_DIRECT_SECTORS + (j + 1) * 128) * BLOCK_SECTOR_SIZE) && final_ptr == 0) {
-          free_map_release(final_ptr, 1);
-          final_ptr = 0;
-          cache_write(fs_device, blk2_ptr, &final_ptr, final_off, sizeof(final_ptr));
-        }
-        if ((size > (NUM_DIRECT_SECTORS + (j + 1) * 128) * BLOCK_SECTOR_SIZE) && final_ptr == 0) {
-          bool status = free_map_allocate(1, &final_ptr);
-          if (!status) {
-            inode_resize(inode, cur_len);
-            return false;
-          }
-          cache_write(fs_device, blk2_ptr, &final_ptr, final_off, sizeof(final_ptr));
+  /* Out of space.  Only block 0 can have been allocated. */
+  if (sector != 0)
+    {
+      struct delayed_block *d = find_delayed (inode, 0);
+      if (d != NULL)
+        {
+          list_remove (&d->elem);
+          cache_discard (d->sector);
+          free (d);
+          free_map_unreserve (1);
+          lock_acquire (&delayed_lock);
+          delayed_cnt--;
+          lock_release (&delayed_lock);
         }
-      }
+      else
+        free_map_release (sector, 1);
     }
+  write_meta (inode, inode->data, data, INLINE_OFS, INLINE_MAX);
+  free (data);
+  return false;
+}
+
+/* Returns the block device sector that contains byte offset POS
+   within INODE.
+   Returns -1 if INODE does not contain data for a byte at offset
+   POS, and 0 if POS lies in a hole that reads as zeros. */
+static block_sector_t
+byte_to_sector (struct inode *inode, off_t pos)
+{
+  ASSERT (inode != NULL);
+  ASSERT (pos >= 0);
+
+  // If the offset is not within the file, return -1
+  if (pos >= inode_length (inode)) {
+    return -1;
   }
-  // Success case:
-  cur_len = size;
-  cache_write(fs_device, inode->data, &cur_len, 0, sizeof(cur_len));
+  return index_to_sector(inode, pos / BLOCK_SECTOR_SIZE, false);
+}
+
+/* Sets the length of INODE to SIZE bytes.
+   Files are sparse: growing a file only moves its end, and the new
+   range is a hole that reads as zeros and costs no sectors until it
+   is written (see inode_write_at).  Be sure to cache inode in the
+   caller!
+   Furthermore, be sure that after acquiring the inode's resizing lock
+   to check whether or not another thread already resized the inode during
+   the period of time in which the current thread saw the need to
+   resize the inode and when the current thread acquired the resize lock.
+   Returns false if SIZE is larger than the largest possible file. */
+bool inode_resize_no_check(struct inode *inode, off_t size) {
+  // Check if another thread already resized before we could start resizing
+  if (inode_length (inode) >= size) {
+    return true;
+  }
+  if (bytes_to_sectors(size) > MAX_FILE_SECTORS) {
+    return false;
+  }
+  write_meta(inode, inode->data, &size, 0, sizeof(size));
   return true;
 }
 
@@ -409,6 +669,16 @@ inode_init (void)
   lock_init(&open_inodes_lock);
   lock_init(&global_freemap_lock);
   cond_init(&monitor_file_deny);
+  lock_init(&delayed_lock);
+  delayed_cnt = 0;
+  next_delayed_sector = 0;
+  list_init(&reclaim_list);
+  lock_init(&reclaim_lock);
+  reclaim_busy = 0;
+  cond_init(&reclaim_idle);
+  sema_init(&reclaim_sema, 0);
+  if (inode_background_reclaim)
+    thread_create ("reclaim", PRI_DEFAULT, reclaim_thread, NULL);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -434,18 +704,23 @@ inode_create (block_sector_t sector, off_t length, bool is_dir)
       node->magic = INODE_MAGIC;
       node->sector = sector;
       node->is_dir = is_dir;
-      bool data_status = free_map_allocate(1, &(node->data));
+      bool data_status = free_map_allocate_near(1, sector, &(node->data));
   
       if (!data_status) {
+        free (node);
         return false;
       }
-
+      /* Every block pointer starts out as a hole. */
+      cache_zero(fs_device, node->data, sector);
+      journal_dirty(node->data);
 
       if (inode_resize_no_check(node, length))
         {
-          cache_write (fs_device, sector, node, 0, BLOCK_SECTOR_SIZE);
+          write_meta (node, sector, node, 0, BLOCK_SECTOR_SIZE);
           success = true;
         }
+      else
+        free_map_release (node->data, 1);
       free (node);
     }
   return success;
@@ -493,6 +768,9 @@ inode_open (block_sector_t sector)
   cond_init(&(inode->waitQueue));
   cond_init(&(inode->onDeckQueue));
   cond_init(&(inode->waitActiveWriters));
+  list_init(&(inode->delayed));
+  rwlock_init(&(inode->dir_lock));
+  inode->dir_slot_hint = 0;
 
   list_push_front (&open_inodes, &(inode->elem));
 
@@ -519,78 +797,187 @@ inode_get_inumber (const struct inode *inode)
   return inode->sector;
 }
 
-/* Closes all of the direct pointers. */
+/* Sectors being freed, gathered into runs of consecutive sectors so
+   that the free map is updated and written once per batch of runs
+   rather than once per sector. */
+#define RELEASE_BATCH_RUNS 32
+
+struct release_batch
+  {
+    size_t run_cnt;
+    struct free_run runs[RELEASE_BATCH_RUNS];
+  };
+
+/* Hands B's runs to the free map and empties B. */
+static void
+batch_flush (struct release_batch *b)
+{
+  if (b->run_cnt > 0)
+    free_map_release_runs (b->runs, b->run_cnt);
+  b->run_cnt = 0;
+}
+
+/* Adds SECTOR to B.  Whatever the cache holds for SECTOR is dropped
+   unwritten, since nobody will read it again. */
+static void
+batch_release (struct release_batch *b, block_sector_t sector)
+{
+  struct free_run *last = b->run_cnt > 0 ? &b->runs[b->run_cnt - 1] : NULL;
+
+  journal_forget (sector);
+  cache_discard (sector);
+  if (last != NULL && last->start + last->cnt == sector)
+    last->cnt++;
+  else if (last != NULL && last->start == sector + 1)
+    {
+      last->start--;
+      last->cnt++;
+    }
+  else
+    {
+      if (b->run_cnt == RELEASE_BATCH_RUNS)
+        batch_flush (b);
+      b->runs[b->run_cnt].start = sector;
+      b->runs[b->run_cnt].cnt = 1;
+      b->run_cnt++;
+    }
+}
+
+/* Frees all of the direct pointers of inode_disk sector DATA.  The
+   pointers themselves are left as they are, since DATA is about to
+   be freed too. */
 void
-inode_close_dir_ptrs (struct inode *inode) {
+inode_close_dir_ptrs (block_sector_t data, struct release_batch *b) {
   for (int i = 0; i < NUM_DIRECT_SECTORS; i ++) {
     block_sector_t dir_ptr;
-    off_t offset = sizeof(off_t) + i * sizeof(block_sector_t);
-    cache_read(fs_device, inode->data, &dir_ptr, offset, sizeof(dir_ptr));
+    cache_read(fs_device, data, &dir_ptr, DIRECT_PTR_OFS(i), sizeof(dir_ptr));
     if (dir_ptr != 0) {
-      free_map_release(dir_ptr, 1);
-      dir_ptr = 0;
-      cache_write(fs_device, inode->data, &dir_ptr, offset, sizeof(dir_ptr));
+      batch_release(b, PTR_SECTOR(dir_ptr));
     }
   }
 }
 
-/* Closes the indirect pointer, and sets the inode's indirect_block pointer to 0. */
+/* Frees the indirect block of inode_disk sector DATA and everything
+   it points to. */
 void
-inode_close_indir_ptr (struct inode *inode) {
+inode_close_indir_ptr (block_sector_t data, struct release_batch *b) {
   block_sector_t ind_blk_ptr;
-  off_t offset = sizeof(off_t) + NUM_DIRECT_SECTORS * sizeof(block_sector_t);
-  cache_read(fs_device, inode->data, &ind_blk_ptr, offset, sizeof(ind_blk_ptr));
+  cache_read(fs_device, data, &ind_blk_ptr, IND_PTR_OFS, sizeof(ind_blk_ptr));
 
   if (ind_blk_ptr == 0) {
     return;
   }
 
-  close_indir_ptr (ind_blk_ptr);
-  ind_blk_ptr = 0;
-  cache_write(fs_device, inode->data, &ind_blk_ptr, 0, sizeof(ind_blk_ptr));
+  close_indir_ptr (ind_blk_ptr, b);
+  batch_release(b, ind_blk_ptr);
 }
 
-/* Frees up every single pointer within block, which we assume to be a pointer to an indirect pointer. */
+/* Frees every single pointer within block, which we assume to be a pointer to an indirect pointer. */
 void 
-close_indir_ptr (block_sector_t block) {
+close_indir_ptr (block_sector_t block, struct release_batch *b) {
   block_sector_t blk_ptr;
-  for (int i = 0; i < 128; i ++) {
+  for (int i = 0; i < PTRS_PER_BLOCK; i ++) {
     off_t offset = i * sizeof(block_sector_t);
     cache_read(fs_device, block, &blk_ptr, offset, sizeof(blk_ptr));
     if (blk_ptr != 0) {
-      free_map_release(blk_ptr, 1);
-      blk_ptr = 0;
-      cache_read(fs_device, block, &blk_ptr, offset, sizeof(blk_ptr));
+      batch_release(b, PTR_SECTOR(blk_ptr));
     }
   }
 }
 
-/* Closes the doubly indirect pointer. */
+/* Frees the doubly indirect block of inode_disk sector DATA and
+   everything below it. */
 void
-inode_close_double_indir_ptr (struct inode *inode) {
+inode_close_double_indir_ptr (block_sector_t data, struct release_batch *b) {
   block_sector_t blk1_ptr;
-  off_t offset = sizeof(off_t) + (NUM_DIRECT_SECTORS + 1) * sizeof(block_sector_t);
-  cache_read(fs_device, inode->data, &blk1_ptr, offset, sizeof(blk1_ptr));
+  cache_read(fs_device, data, &blk1_ptr, DBL_IND_PTR_OFS, sizeof(blk1_ptr));
   if (blk1_ptr == 0) {
     return;
   }
 
   block_sector_t blk2_ptr;
-  for (int i = 0; i < 128; i ++) {
-    offset = i * sizeof(block_sector_t);
-    cache_read(fs_device, blk1_ptr, &blk2_ptr, offset, sizeof(blk2_ptr));
+  for (int i = 0; i < PTRS_PER_BLOCK; i ++) {
+    off_t blk1_off = i * sizeof(block_sector_t);
+    cache_read(fs_device, blk1_ptr, &blk2_ptr, blk1_off, sizeof(blk2_ptr));
     if (blk2_ptr != 0) {
-      close_indir_ptr(blk2_ptr);
-      free_map_release(blk2_ptr, 1);
-      blk2_ptr = 0;
-      cache_write(fs_device, blk1_ptr, &blk2_ptr, offset, sizeof(blk2_ptr));
+      close_indir_ptr(blk2_ptr, b);
+      batch_release(b, blk2_ptr);
     }
   }
-  blk1_ptr = 0;
-  cache_write(fs_device, inode->data, &blk1_ptr, offset, sizeof(blk1_ptr));
+  batch_release(b, blk1_ptr);
+}
+
+/* Frees every sector of a removed inode: its data and indirect
+   blocks, its inode_disk sector DATA, and SECTOR, which held the
+   inode itself. */
+static void
+release_inode (block_sector_t sector, block_sector_t data)
+{
+  struct release_batch b;
+  off_t length;
+
+  b.run_cnt = 0;
+  cache_read (fs_device, data, &length, 0, sizeof length);
+  if (length > INLINE_MAX)
+    inode_close_dir_ptrs (data, &b);
+  inode_close_indir_ptr (data, &b);
+  inode_close_double_indir_ptr (data, &b);
+  batch_release (&b, data);
+  batch_release (&b, sector);
+  batch_flush (&b);
 }
 
-/* Closes INODE and writes it to disk.
+/* Pops the oldest queued work item and frees its sectors.  Called
+   with reclaim_lock held and returns with it held, but drops it
+   while freeing so that inode_close() can keep queueing work
+   behind a large file.  The item counts in reclaim_busy meanwhile,
+   for inode_reclaim_all() to wait on. */
+static void
+reclaim_one (void)
+{
+  struct reclaim_work *w = list_entry (list_pop_front (&reclaim_list),
+                                       struct reclaim_work, elem);
+
+  reclaim_busy++;
+  lock_release (&reclaim_lock);
+  journal_begin ();
+  release_inode (w->sector, w->data);
+  journal_end ();
+  free (w);
+  lock_acquire (&reclaim_lock);
+  if (--reclaim_busy == 0)
+    cond_broadcast (&reclaim_idle, &reclaim_lock);
+}
+
+/* Frees queued inodes one at a time. */
+static void
+reclaim_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      sema_down (&reclaim_sema);
+      lock_acquire (&reclaim_lock);
+      if (!list_empty (&reclaim_list))
+        reclaim_one ();
+      lock_release (&reclaim_lock);
+    }
+}
+
+/* Frees the sectors of every removed inode still waiting for the
+   reclaim thread, and waits for any the thread is freeing now.
+   Called before the free map is closed. */
+void
+inode_reclaim_all (void)
+{
+  lock_acquire (&reclaim_lock);
+  while (!list_empty (&reclaim_list))
+    reclaim_one ();
+  while (reclaim_busy > 0)
+    cond_wait (&reclaim_idle, &reclaim_lock);
+  lock_release (&reclaim_lock);
+}
+
+/* Closes INODE.
    If this was the last reference to INODE, frees its memory.
    If INODE was also a removed inode, frees its blocks. */
 void
@@ -600,28 +987,39 @@ inode_close (struct inode *inode)
   if (inode == NULL)
     return;
 
-  // Write this inode out to disk
-  cache_write(fs_device, inode->sector, inode, 0, sizeof(inode));
-
   /* Release resources if this was the last opener. */
   if (--inode->open_cnt == 0)
     {
+      journal_begin ();
       /* Remove from inode list and release lock. */
+      lock_acquire(&open_inodes_lock);
       list_remove (&inode->elem);
+      lock_release(&open_inodes_lock);
 
       /* Deallocate blocks if removed. */
       if (inode->removed)
         {
-
-          // free_map_release (inode->data.start,
-          //                   bytes_to_sectors (inode->data.length));
-          // MAY NEED TO ZERO CHECK THESE FUNCTIONS
-          inode_close_dir_ptrs(inode);
-          inode_close_indir_ptr(inode);
-          inode_close_double_indir_ptr(inode);
-          free_map_release(inode->data, 1);
-          free_map_release (inode->sector, 1);
+          struct reclaim_work *w = NULL;
+
+          discard_delayed(inode);
+          if (inode_background_reclaim
+              && inode_length (inode) > RECLAIM_MIN_LENGTH)
+            w = malloc (sizeof *w);
+          if (w != NULL)
+            {
+              w->sector = inode->sector;
+              w->data = inode->data;
+              lock_acquire (&reclaim_lock);
+              list_push_back (&reclaim_list, &w->elem);
+              lock_release (&reclaim_lock);
+              sema_up (&reclaim_sema);
+            }
+          else
+            release_inode (inode->sector, inode->data);
         }
+      else
+        flush_delayed(inode);
+      journal_end ();
 
       free (inode);
     }
@@ -636,16 +1034,27 @@ inode_remove (struct inode *inode)
   inode->removed = true;
 }
 
-/* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
-   Returns the number of bytes actually read, which may be less
-   than SIZE if an error occurs or end of file is reached. */
-off_t
-inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
+/* Reads SIZE bytes from INODE into BUFFER, starting at position
+   OFFSET, for a caller that already has read access to INODE.
+   Returns the number of bytes actually read. */
+static off_t
+read_at_locked (struct inode *inode, void *buffer_, off_t size, off_t offset)
 {
-  access(inode, 0);
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
 
+  off_t length = inode_length (inode);
+  if (length <= INLINE_MAX)
+    {
+      if (offset < length && size > 0)
+        {
+          bytes_read = size < length - offset ? size : length - offset;
+          cache_read (fs_device, inode->data, buffer,
+                      INLINE_OFS + offset, bytes_read);
+        }
+      return bytes_read;
+    }
+
   while (size > 0)
     {
       /* Disk sector to read, starting byte offset within sector. */
@@ -663,47 +1072,90 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
         break;
 
 
-      cache_read (fs_device, sector_idx, buffer + bytes_read, sector_ofs, chunk_size);
+      /* Holes read as zeros without touching the disk. */
+      if (sector_idx == 0)
+        memset (buffer + bytes_read, 0, chunk_size);
+      else
+        cache_read (fs_device, sector_idx, buffer + bytes_read, sector_ofs, chunk_size);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  
+  return bytes_read;
+}
+
+/* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
+   Returns the number of bytes actually read, which may be less
+   than SIZE if an error occurs or end of file is reached. */
+off_t
+inode_read_at (struct inode *inode, void *buffer, off_t size, off_t offset)
+{
+  off_t bytes_read;
+
+  access(inode, 0);
+  bytes_read = read_at_locked (inode, buffer, size, offset);
   checkout(inode);
   return bytes_read;
 }
 
-/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
-   Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   A write at the end of the file extends the inode.
-   */
+/* Reads from INODE, starting at position OFFSET, into the CNT
+   buffers described by IOV in turn, holding read access for the
+   whole operation so that no writer lands between segments.
+   Returns the number of bytes actually read, which is short only
+   at end of file. */
 off_t
-inode_write_at (struct inode *inode, const void *buffer_, off_t size,
+inode_readv_at (struct inode *inode, const struct iovec *iov, int cnt,
                 off_t offset)
 {
-  if (inode->deny_write_cnt)
-    return 0;
+  off_t bytes_read = 0;
+  int i;
+
+  access(inode, 0);
+  for (i = 0; i < cnt; i++)
+    {
+      off_t n = read_at_locked (inode, iov[i].iov_base, iov[i].iov_len,
+                                offset + bytes_read);
+      bytes_read += n;
+      if (n != (off_t) iov[i].iov_len)
+        break;
+    }
+  checkout(inode);
+  return bytes_read;
+}
+
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET,
+   for a caller that already has write access to INODE inside a
+   journal transaction.  Returns the number of bytes actually
+   written.  A write at the end of the file extends the inode. */
+static off_t
+write_at_locked (struct inode *inode, const void *buffer_, off_t size,
+                 off_t offset)
+{
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
 
-  access(inode, 1);
-  // Check for resize
-  if (offset + size > inode_length (inode)) {
-    lock_acquire (&(inode->resize));
-    bool success = inode_resize (inode, offset + size);
-    lock_release (&(inode->resize));
-    if (!success) {
-      return 0;
+  off_t length = inode_length (inode);
+  if (length <= INLINE_MAX && size > 0)
+    {
+      if (offset <= INLINE_MAX - size)
+        {
+          write_data (inode, inode->data, buffer,
+                      INLINE_OFS + offset, size);
+          bytes_written = size;
+          offset += size;
+          size = 0;
+        }
+      else if (!move_inline_data (inode, length, offset / BLOCK_SECTOR_SIZE))
+        size = 0;
     }
-  }
 
   while (size > 0)
     {
-      /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      /* Sector to write, starting byte offset within sector.
+         Holes get their sector now, on first write. */
+      block_sector_t sector_idx = index_to_sector (inode, offset / BLOCK_SECTOR_SIZE, true);
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -711,10 +1163,10 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 
       /* Number of bytes to actually write into this sector. */
       int chunk_size = size < min_left ? size : min_left;
-      if (chunk_size <= 0)
+      if (chunk_size <= 0 || sector_idx == 0)
         break;
 
-      cache_write(fs_device, sector_idx, buffer + bytes_written, sector_ofs, chunk_size);
+      write_data(inode, sector_idx, buffer + bytes_written, sector_ofs, chunk_size);
 
       /* Advance. */
       size -= chunk_size;
@@ -722,10 +1174,156 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       bytes_written += chunk_size;
     }
 
+  // A write past the end extends the file; anything skipped over stays a hole.
+  if (bytes_written > 0 && offset > inode_length (inode)) {
+    lock_acquire (&(inode->resize));
+    inode_resize (inode, offset);
+    lock_release (&(inode->resize));
+  }
+  return bytes_written;
+}
+
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
+   Returns the number of bytes actually written, which may be
+   less than SIZE if end of file is reached or an error occurs.
+   A write at the end of the file extends the inode.
+   */
+off_t
+inode_write_at (struct inode *inode, const void *buffer, off_t size,
+                off_t offset)
+{
+  off_t bytes_written;
+
+  if (inode->deny_write_cnt)
+    return 0;
+  journal_begin ();
+  access(inode, 1);
+  bytes_written = write_at_locked (inode, buffer, size, offset);
+  checkout(inode);
+  journal_end ();
+  return bytes_written;
+}
+
+/* Writes the CNT buffers described by IOV in turn into INODE,
+   starting at OFFSET, in one journal transaction and under one
+   hold of write access, so that the segments land contiguously
+   even with other writers about.  Returns the number of bytes
+   actually written. */
+off_t
+inode_writev_at (struct inode *inode, const struct iovec *iov, int cnt,
+                 off_t offset)
+{
+  off_t bytes_written = 0;
+  int i;
+
+  if (inode->deny_write_cnt)
+    return 0;
+  journal_begin ();
+  access(inode, 1);
+  for (i = 0; i < cnt; i++)
+    {
+      off_t n = write_at_locked (inode, iov[i].iov_base, iov[i].iov_len,
+                                 offset + bytes_written);
+      bytes_written += n;
+      if (n != (off_t) iov[i].iov_len)
+        break;
+    }
   checkout(inode);
+  journal_end ();
   return bytes_written;
 }
 
+/* Copies SIZE bytes of SRC, starting at SRC_OFS, into DST at
+   DST_OFS, sector by sector through the buffer cache, so the data
+   never passes through user memory.  Whole sectors that are holes
+   in SRC and have never been written in DST stay holes.  SRC and
+   DST must be different inodes.  Returns the number of bytes
+   copied, which is short at the end of SRC or if DST cannot
+   grow. */
+off_t
+inode_copy_range (struct inode *src, off_t src_ofs, struct inode *dst,
+                  off_t dst_ofs, off_t size)
+{
+  uint8_t *bounce;
+  off_t src_length, copied = 0;
+
+  ASSERT (src != dst);
+  if (dst->deny_write_cnt)
+    return 0;
+  bounce = malloc (BLOCK_SECTOR_SIZE);
+  if (bounce == NULL)
+    return 0;
+
+  /* Take the inodes in a fixed order, so that copies running in
+     opposite directions cannot deadlock.  The journal operation
+     starts first, since journal_begin() may wait for operations
+     that want these inodes. */
+  journal_begin ();
+  if (src->sector < dst->sector)
+    {
+      access(src, 0);
+      access(dst, 1);
+    }
+  else
+    {
+      access(dst, 1);
+      access(src, 0);
+    }
+
+  src_length = inode_length (src);
+  if (src_ofs >= src_length)
+    size = 0;
+  else if (size > src_length - src_ofs)
+    size = src_length - src_ofs;
+
+  while (size > 0)
+    {
+      /* Copy up to the end of whichever sector ends first. */
+      int src_left = BLOCK_SECTOR_SIZE - src_ofs % BLOCK_SECTOR_SIZE;
+      int dst_left = BLOCK_SECTOR_SIZE - dst_ofs % BLOCK_SECTOR_SIZE;
+      int chunk = size < src_left ? size : src_left;
+      off_t dst_length = inode_length (dst);
+      bool hole;
+
+      if (dst_left < chunk)
+        chunk = dst_left;
+      hole = (chunk == BLOCK_SECTOR_SIZE
+              && src_length > INLINE_MAX && dst_length > INLINE_MAX
+              && byte_to_sector (src, src_ofs) == 0
+              && (dst_ofs >= dst_length
+                  || index_to_sector (dst, dst_ofs / BLOCK_SECTOR_SIZE,
+                                      false) == 0));
+      if (!hole)
+        {
+          off_t written;
+
+          read_at_locked (src, bounce, chunk, src_ofs);
+          written = write_at_locked (dst, bounce, chunk, dst_ofs);
+          if (written != chunk)
+            break;
+        }
+
+      size -= chunk;
+      src_ofs += chunk;
+      dst_ofs += chunk;
+      copied += chunk;
+    }
+
+  /* A copy ending in skipped holes still extends DST. */
+  if (copied > 0 && dst_ofs > inode_length (dst))
+    {
+      lock_acquire (&(dst->resize));
+      inode_resize (dst, dst_ofs);
+      lock_release (&(dst->resize));
+    }
+
+  checkout(src);
+  checkout(dst);
+  journal_end ();
+  free (bounce);
+  return copied;
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void
@@ -768,4 +1366,225 @@ inode_length (const struct inode *inode)
 bool
 inode_is_dir (struct inode *inode) {
   return inode->is_dir;
-}
\ No newline at end of file
+}
+
+/* Returns true if directory INODE has been converted to the hashed
+   format. */
+bool
+inode_dir_hashed (const struct inode *inode)
+{
+  return inode->dir_hashed;
+}
+
+/* Marks directory INODE, on disk too, as being in the hashed
+   format. */
+void
+inode_set_dir_hashed (struct inode *inode)
+{
+  inode->dir_hashed = true;
+  write_meta (inode, inode->sector, &inode->dir_hashed,
+              offsetof (struct inode, dir_hashed), sizeof inode->dir_hashed);
+}
+
+/* Locks directory INODE's entries for reading.  Any number of
+   lookups may hold this at once; changes to the entries take the
+   lock for writing, which excludes them. */
+void
+inode_dir_lock_read (struct inode *inode)
+{
+  rwlock_acquire_read (&inode->dir_lock);
+}
+
+/* Unlocks directory INODE's entries after reading. */
+void
+inode_dir_unlock_read (struct inode *inode)
+{
+  rwlock_release_read (&inode->dir_lock);
+}
+
+/* Locks directory INODE's entries for writing. */
+void
+inode_dir_lock_write (struct inode *inode)
+{
+  rwlock_acquire_write (&inode->dir_lock);
+}
+
+/* Unlocks directory INODE's entries after writing. */
+void
+inode_dir_unlock_write (struct inode *inode)
+{
+  rwlock_release_write (&inode->dir_lock);
+}
+
+/* Returns the offset in directory INODE before which it has no
+   free entry slots.  This is only a hint, kept in memory while
+   INODE is open, and starts out as 0. */
+off_t
+inode_dir_slot_hint (const struct inode *inode)
+{
+  return inode->dir_slot_hint;
+}
+
+/* Sets directory INODE's free slot hint to OFS. */
+void
+inode_set_dir_slot_hint (struct inode *inode, off_t ofs)
+{
+  inode->dir_slot_hint = ofs;
+}
+
+/* Gives a sector to every delayed block of every open inode, so that
+   a following cache_flush() writes all file data to disk. */
+void
+inode_flush_all (void)
+{
+  struct list_elem *e;
+
+  journal_begin ();
+  lock_acquire(&open_inodes_lock);
+  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+       e = list_next (e))
+    {
+      struct inode *inode = list_entry (e, struct inode, elem);
+      access(inode, 1);
+      flush_delayed(inode);
+      checkout(inode);
+    }
+  lock_release(&open_inodes_lock);
+  journal_end ();
+}
+
+/* Makes INODE durable: writes its dirty data blocks to disk, then
+   commits the journal transaction holding its metadata, then writes
+   its metadata home too.  Data goes first so that the committed
+   pointers never lead to blocks that were not written.  Each pass
+   writes in sector order and only touches INODE's own blocks; the
+   rest of the cache stays as it is. */
+void
+inode_sync (struct inode *inode)
+{
+  /* Blocks still waiting for delayed allocation need sectors first. */
+  journal_begin ();
+  access(inode, 1);
+  flush_delayed(inode);
+  checkout(inode);
+  journal_end ();
+
+  cache_write_back_owned (inode->sector);
+  journal_sync ();
+  cache_write_back_owned (inode->sector);
+}
+
+/* Gives a sector to every hole in bytes [OFFSET, OFFSET + LENGTH) of
+   INODE, taking runs of holes from the free map in as few contiguous
+   pieces as possible, and extends INODE to cover the range.  The new
+   sectors are not zeroed; they read as zeros until first written.
+   Returns false if writes to INODE are denied, if the range is beyond
+   the largest possible file, or if the disk fills up, in which case
+   part of the range may have been allocated and INODE extended. */
+bool
+inode_allocate (struct inode *inode, off_t offset, off_t length)
+{
+  block_sector_t sector;
+  off_t ofs;
+  size_t start, end, i;
+  bool success = true, moved = false;
+
+  if (offset < 0 || length < 0
+      || length > (off_t) MAX_FILE_SECTORS * BLOCK_SECTOR_SIZE - offset)
+    return false;
+  if (inode->deny_write_cnt)
+    return false;
+
+  start = offset / BLOCK_SECTOR_SIZE;
+  end = DIV_ROUND_UP (offset + length, BLOCK_SECTOR_SIZE);
+  journal_begin ();
+  access(inode, 1);
+
+  /* Inline data needs no sectors while the file stays small. */
+  off_t old_length = inode_length (inode);
+  if (old_length <= INLINE_MAX) {
+    if (offset + length <= INLINE_MAX) {
+      end = start;
+    } else if (old_length == 0) {
+      /* Nothing was ever written, so the pointers are all holes. */
+      moved = true;
+    } else {
+      success = moved = move_inline_data(inode, old_length, 0);
+    }
+  }
+
+  /* Indirect blocks first, so that they do not split the data runs. */
+  for (i = start; i < end && success; i++) {
+    success = locate_block_ptr(inode, i, true, &sector, &ofs);
+  }
+
+  for (i = start; i < end && success; ) {
+    block_sector_t first;
+    size_t cnt = 0, largest;
+
+    while (i + cnt < end && read_block_ptr(inode, i + cnt) == 0
+           && find_delayed(inode, i + cnt) == NULL) {
+      cnt++;
+    }
+    if (cnt == 0) {
+      i++;
+      continue;
+    }
+
+    largest = free_map_largest();
+    if (cnt > largest && largest > 0) {
+      cnt = largest;
+    }
+    while (!free_map_allocate_near(cnt, block_goal(inode, i), &first)) {
+      if (cnt == 1) {
+        success = false;
+        break;
+      }
+      cnt /= 2;
+    }
+    for (size_t j = 0; success && j < cnt; j++) {
+      block_sector_t ptr = (first + j) | PTR_UNWRITTEN;
+      if (!locate_block_ptr(inode, i + j, false, &sector, &ofs))
+        NOT_REACHED ();
+      write_meta(inode, sector, &ptr, ofs, sizeof(ptr));
+    }
+    i += cnt;
+  }
+
+  if ((success || moved) && offset + length > inode_length (inode)) {
+    lock_acquire (&(inode->resize));
+    inode_resize (inode, offset + length);
+    lock_release (&(inode->resize));
+  }
+  checkout(inode);
+  journal_end ();
+  return success;
+}
+
+/* Returns the number of extents of INODE: maximal runs of data blocks
+   that are consecutive both in the file and on disk.  Holes and
+   blocks still waiting for delayed allocation are not counted.  Used
+   to measure fragmentation. */
+size_t
+inode_extent_count (struct inode *inode)
+{
+  size_t extents = 0;
+  block_sector_t prev = 0;
+
+  access(inode, 0);
+  off_t length = inode_length (inode);
+  size_t sectors = length > INLINE_MAX ? bytes_to_sectors (length) : 0;
+  for (size_t i = 0; i < sectors; i++) {
+    block_sector_t sector = PTR_SECTOR(read_block_ptr(inode, i));
+    if (sector == 0) {
+      prev = 0;
+      continue;
+    }
+    if (prev == 0 || sector != prev + 1) {
+      extents++;
+    }
+    prev = sector;
+  }
+  checkout(inode);
+  return extents;
+}
@@ -6,6 +6,11 @@
 #include "devices/block.h"
 
 struct bitmap;
+struct iovec;
+
+/* If true, free large deleted files in the background.
+   Controlled by kernel command-line option "-bgfree". */
+extern bool inode_background_reclaim;
 
 void inode_init (void);
 bool inode_create (block_sector_t, off_t, bool is_dir);
@@ -16,14 +21,33 @@ void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+off_t inode_readv_at (struct inode *, const struct iovec *, int cnt,
+                      off_t offset);
+off_t inode_writev_at (struct inode *, const struct iovec *, int cnt,
+                       off_t offset);
+off_t inode_copy_range (struct inode *src, off_t src_ofs, struct inode *dst,
+                        off_t dst_ofs, off_t size);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
+void inode_flush_all (void);
+void inode_sync (struct inode *);
+void inode_reclaim_all (void);
+bool inode_allocate (struct inode *, off_t offset, off_t length);
+size_t inode_extent_count (struct inode *);
 
 /* More helper funtions */
 bool
 inode_expand (struct inode *, size_t start, size_t sectors);
 bool inode_is_dir(struct inode *);
+bool inode_dir_hashed (const struct inode *);
+void inode_set_dir_hashed (struct inode *);
+void inode_dir_lock_read (struct inode *);
+void inode_dir_unlock_read (struct inode *);
+void inode_dir_lock_write (struct inode *);
+void inode_dir_unlock_write (struct inode *);
+off_t inode_dir_slot_hint (const struct inode *);
+void inode_set_dir_slot_hint (struct inode *, off_t);
 
 void
 access (struct inode *, int type);
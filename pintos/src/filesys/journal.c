@@ -0,0 +1,580 @@
+#include "filesys/journal.h"
+#include <debug.h>
+#include <hash.h>
+#include <string.h>
+#include "filesys/cache.h"
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Identifies journal header, descriptor and commit sectors. */
+#define JOURNAL_MAGIC 0x4a524e4c
+
+/* The log proper follows the header. */
+#define LOG_START (JOURNAL_SECTOR + 1)
+#define LOG_SECTORS (JOURNAL_SECTORS - 1)
+
+/* Most sectors one transaction logs.  They are pinned in the cache
+   until the transaction commits, so this stays well below the
+   cache size. */
+#define TXN_MAX_SECTORS (MAX_CACHE_BLOCKS / 4)
+
+/* Most sectors one transaction revokes. */
+#define TXN_MAX_REVOKES 64
+
+/* Sectors of the running transaction set aside for each operation
+   when it starts, enough for the metadata of an ordinary create,
+   remove or write.  An operation starts only once the transaction
+   has room for it, so it is committed whole. */
+#define TXN_OP_SECTORS 8
+
+/* Once the running transaction holds this many sectors, new
+   operations wait while the ones in progress finish, and the last
+   of those commits it.  Smaller transactions wait for
+   journal_sync(), so that the changes of many operations go to the
+   log in one sequential write. */
+#define TXN_COMMIT_SECTORS (TXN_MAX_SECTORS / 2)
+
+/* A transaction in the log is a descriptor sector, the images of
+   the sectors it lists, then a commit sector.  It counts only if
+   its commit sector is intact; a crash while writing it loses the
+   whole transaction and nothing else. */
+
+/* Journal header, in sector JOURNAL_SECTOR. */
+struct journal_header
+  {
+    uint32_t magic;                     /* JOURNAL_MAGIC. */
+    uint32_t seq;                       /* Sequence number of first
+                                           transaction in the log. */
+    uint8_t unused[BLOCK_SECTOR_SIZE - 2 * sizeof (uint32_t)];
+  };
+
+/* Transaction descriptor. */
+struct journal_desc
+  {
+    uint32_t magic;                     /* JOURNAL_MAGIC. */
+    uint32_t seq;                       /* Sequence number. */
+    uint32_t cnt;                       /* Number of sector images. */
+    uint32_t revoke_cnt;                /* Number of revoked sectors. */
+    block_sector_t sectors[TXN_MAX_SECTORS];    /* Home of each image. */
+    block_sector_t revoked[TXN_MAX_REVOKES];    /* See journal_forget(). */
+    uint8_t unused[BLOCK_SECTOR_SIZE - 4 * sizeof (uint32_t)
+                   - (TXN_MAX_SECTORS + TXN_MAX_REVOKES)
+                     * sizeof (block_sector_t)];
+  };
+
+/* Transaction commit record. */
+struct journal_commit
+  {
+    uint32_t magic;                     /* JOURNAL_MAGIC. */
+    uint32_t seq;                       /* Same as the descriptor's. */
+    uint32_t checksum;                  /* Over the sector images. */
+    uint8_t unused[BLOCK_SECTOR_SIZE - 3 * sizeof (uint32_t)];
+  };
+
+/* False when the disk was formatted without a journal.  All
+   journal calls then do nothing. */
+static bool enabled;
+
+static struct lock journal_lock;        /* Guards everything below. */
+static struct condition committed;      /* Signaled after each commit. */
+static int active;                      /* Operations in progress. */
+static int sync_cnt;                    /* Threads in journal_sync(). */
+static size_t reserved;                 /* Sectors set aside for operations
+                                           in progress and not yet used. */
+
+/* The running transaction. */
+static uint32_t seq;                    /* Its sequence number. */
+static block_sector_t txn_sectors[TXN_MAX_SECTORS];
+static size_t txn_cnt;
+static block_sector_t txn_revoked[TXN_MAX_REVOKES];
+static size_t txn_revoke_cnt;
+
+/* The log. */
+static size_t log_pos;                  /* Next free log sector. */
+static block_sector_t logged[LOG_SECTORS];  /* Sectors logged since the
+                                               log was last emptied. */
+static block_sector_t logged_at[LOG_SECTORS];   /* Where each one's
+                                                   newest image is. */
+static size_t logged_cnt;
+
+/* Buffers for commit_locked(), which holds JOURNAL_LOCK. */
+static struct journal_desc desc;
+static uint8_t sector_buf[BLOCK_SECTOR_SIZE];
+
+static void replay (uint32_t first_seq);
+static void commit_locked (void);
+static void checkpoint_locked (void);
+static void write_header (void);
+
+/* Returns true if SECTOR is one of the CNT sectors in ARRAY,
+   storing its index in *IDXP if IDXP is nonnull. */
+static bool
+find_sector (const block_sector_t *array, size_t cnt, block_sector_t sector,
+             size_t *idxp)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    if (array[i] == sector)
+      {
+        if (idxp != NULL)
+          *idxp = i;
+        return true;
+      }
+  return false;
+}
+
+/* Initializes the journal.  If FORMAT is true, writes an empty
+   journal; otherwise replays whatever the log holds, so that the
+   file system reflects every committed transaction. */
+void
+journal_init (bool format)
+{
+  struct journal_header *h;
+
+  lock_init (&journal_lock);
+  cond_init (&committed);
+  active = sync_cnt = 0;
+  reserved = 0;
+  txn_cnt = txn_revoke_cnt = 0;
+  log_pos = logged_cnt = 0;
+  enabled = false;
+
+  if (format)
+    {
+      /* Clear the whole log, so that no transaction from before
+         the format can pass for one of the new log's. */
+      block_sector_t sector;
+
+      memset (sector_buf, 0, BLOCK_SECTOR_SIZE);
+      for (sector = LOG_START; sector < LOG_START + LOG_SECTORS; sector++)
+        block_write (fs_device, sector, sector_buf);
+      seq = 1;
+      write_header ();
+      enabled = true;
+      return;
+    }
+
+  h = malloc (sizeof *h);
+  if (h == NULL)
+    PANIC ("journal_init: out of memory");
+  block_read (fs_device, JOURNAL_SECTOR, h);
+  if (h->magic == JOURNAL_MAGIC)
+    {
+      replay (h->seq);
+      enabled = true;
+    }
+  free (h);
+}
+
+/* Writes the journal header, making SEQ the first sequence number
+   of the log. */
+static void
+write_header (void)
+{
+  struct journal_header *h = (struct journal_header *) sector_buf;
+
+  memset (h, 0, sizeof *h);
+  h->magic = JOURNAL_MAGIC;
+  h->seq = seq;
+  block_write (fs_device, JOURNAL_SECTOR, h);
+}
+
+/* Reads the descriptor of the transaction at log position POS into
+   *D, using BUF for the rest, and checks that the transaction is
+   complete and numbered EXPECTED_SEQ.  Returns true if so. */
+static bool
+read_txn (size_t pos, uint32_t expected_seq, struct journal_desc *d,
+          uint8_t *buf)
+{
+  struct journal_commit *c = (struct journal_commit *) buf;
+  uint32_t checksum = 0;
+  size_t i;
+
+  if (pos + 2 > LOG_SECTORS)
+    return false;
+  block_read (fs_device, LOG_START + pos, d);
+  if (d->magic != JOURNAL_MAGIC || d->seq != expected_seq
+      || d->cnt > TXN_MAX_SECTORS || d->revoke_cnt > TXN_MAX_REVOKES
+      || pos + d->cnt + 2 > LOG_SECTORS)
+    return false;
+
+  for (i = 0; i < d->cnt; i++)
+    {
+      block_read (fs_device, LOG_START + pos + 1 + i, buf);
+      checksum = checksum * 31 + hash_bytes (buf, BLOCK_SECTOR_SIZE);
+    }
+  block_read (fs_device, LOG_START + pos + 1 + d->cnt, c);
+  return (c->magic == JOURNAL_MAGIC && c->seq == expected_seq
+          && c->checksum == checksum);
+}
+
+/* Replays the complete transactions in the log, starting from the
+   one numbered FIRST_SEQ at the start of the log, then empties the
+   log.  A sector image is skipped if the sector was revoked by a
+   later transaction, because the sector has since been freed and
+   may now hold file data that was never logged. */
+static void
+replay (uint32_t first_seq)
+{
+  enum { MAX_TXNS = LOG_SECTORS / 2 };
+  struct journal_desc *descs;
+  size_t n, pos, i, j, k;
+  uint8_t *buf;
+
+  descs = malloc (MAX_TXNS * sizeof *descs);
+  buf = malloc (BLOCK_SECTOR_SIZE);
+  if (descs == NULL || buf == NULL)
+    PANIC ("journal replay: out of memory");
+
+  /* Find the complete transactions. */
+  for (n = 0, pos = 0; n < MAX_TXNS; n++)
+    {
+      if (!read_txn (pos, first_seq + n, &descs[n], buf))
+        break;
+      pos += descs[n].cnt + 2;
+    }
+
+  /* Write their images home, oldest first. */
+  for (i = 0, pos = 0; i < n; i++)
+    {
+      for (j = 0; j < descs[i].cnt; j++)
+        {
+          block_sector_t sector = descs[i].sectors[j];
+          bool revoked = false;
+
+          for (k = i + 1; k < n && !revoked; k++)
+            revoked = find_sector (descs[k].revoked, descs[k].revoke_cnt,
+                                   sector, NULL);
+          if (!revoked)
+            {
+              block_read (fs_device, LOG_START + pos + 1 + j, buf);
+              block_write (fs_device, sector, buf);
+            }
+        }
+      pos += descs[i].cnt + 2;
+    }
+
+  seq = first_seq + n;
+  write_header ();
+  free (buf);
+  free (descs);
+}
+
+/* Returns true if the running transaction is to be committed as
+   soon as no operation is in progress, because it has grown large
+   or because journal_sync() is waiting for it.  New operations do
+   not start meanwhile, so the wait ends. */
+static bool
+commit_due (void)
+{
+  return ((txn_cnt >= TXN_COMMIT_SECTORS || sync_cnt > 0)
+          && (txn_cnt > 0 || txn_revoke_cnt > 0));
+}
+
+/* Returns true if the running transaction has room for another
+   operation's TXN_OP_SECTORS on top of the sectors it holds and
+   those set aside for the operations in progress. */
+static bool
+has_room (void)
+{
+  return txn_cnt + reserved + TXN_OP_SECTORS <= TXN_MAX_SECTORS;
+}
+
+/* Starts a file system operation and sets aside TXN_OP_SECTORS
+   sectors of the running transaction for it.  Every change an
+   operation makes goes into the same transaction unless it needs
+   more than that, so a crash leaves either all or none of it.
+
+   Waits first if the running transaction is due to be committed or
+   has no room, so the caller must not hold a lock that an operation
+   in progress might be waiting for.  A call nested inside another
+   operation of the same thread is part of that operation and never
+   waits. */
+void
+journal_begin (void)
+{
+  struct thread *cur = thread_current ();
+
+  if (!enabled || cur->journal_depth++ > 0)
+    return;
+
+  lock_acquire (&journal_lock);
+  while (commit_due () || !has_room ())
+    {
+      if (active == 0)
+        commit_locked ();
+      else
+        cond_wait (&committed, &journal_lock);
+    }
+  active++;
+  reserved += TXN_OP_SECTORS;
+  cur->journal_credits = TXN_OP_SECTORS;
+  lock_release (&journal_lock);
+}
+
+/* Ends a file system operation started with journal_begin().  The
+   last operation to end commits the running transaction if it is
+   due. */
+void
+journal_end (void)
+{
+  struct thread *cur = thread_current ();
+
+  if (!enabled)
+    return;
+  ASSERT (cur->journal_depth > 0);
+  if (--cur->journal_depth > 0)
+    return;
+
+  lock_acquire (&journal_lock);
+  ASSERT (active > 0);
+  reserved -= cur->journal_credits;
+  cur->journal_credits = 0;
+  if (--active == 0 && commit_due ())
+    commit_locked ();
+
+  /* The sectors given back may be the room a waiting operation
+     needs.  Transactions can also shrink below the threshold,
+     through journal_forget(), leaving operations waiting for a
+     commit that is no longer due. */
+  cond_broadcast (&committed, &journal_lock);
+  lock_release (&journal_lock);
+}
+
+/* Adds SECTOR to the running transaction and pins it, using up
+   one of the sectors set aside for the current operation.  An
+   operation that has used all of those, such as one large
+   fallocate(), takes whatever room is left, and once there is none
+   commits the transaction in the middle of the operations in
+   progress; a crash can then keep the first part of it without the
+   rest.  Write-ahead still holds, because journal_write() adds a
+   sector and modifies it under JOURNAL_LOCK, so no change falls
+   between the commit and the next transaction.  The caller must
+   hold JOURNAL_LOCK. */
+static void
+add_locked (block_sector_t sector)
+{
+  struct thread *cur = thread_current ();
+
+  ASSERT (sector < CACHE_DELAYED_SECTOR);
+  if (!find_sector (txn_sectors, txn_cnt, sector, NULL))
+    {
+      if (cur->journal_credits > 0)
+        {
+          cur->journal_credits--;
+          reserved--;
+        }
+      else if (txn_cnt + reserved >= TXN_MAX_SECTORS)
+        commit_locked ();
+      txn_sectors[txn_cnt++] = sector;
+      cache_pin (sector);
+    }
+}
+
+/* Adds SECTOR, a metadata sector that has just been filled in the
+   buffer cache for its new owner, to the running transaction.  Use
+   journal_write() instead to change a sector that is in use: this
+   pins SECTOR in the cache, which keeps it from going home until the
+   transaction has been committed. */
+void
+journal_dirty (block_sector_t sector)
+{
+  if (!enabled)
+    return;
+
+  lock_acquire (&journal_lock);
+  add_locked (sector);
+  lock_release (&journal_lock);
+}
+
+/* Writes SIZE bytes from BUFFER into metadata sector SECTOR at byte
+   offset OFS, through the buffer cache on behalf of OWNER, as part
+   of the running transaction. */
+void
+journal_write (block_sector_t sector, const void *buffer, off_t ofs,
+               int size, block_sector_t owner)
+{
+  if (!enabled)
+    {
+      cache_write (fs_device, sector, buffer, ofs, size, owner);
+      return;
+    }
+
+  lock_acquire (&journal_lock);
+  add_locked (sector);
+  cache_write (fs_device, sector, buffer, ofs, size, owner);
+  lock_release (&journal_lock);
+}
+
+/* Tells the journal that SECTOR has been freed.  Call this before
+   dropping SECTOR from the cache.  If an image of SECTOR is still
+   in the log, a revocation is recorded so that replay does not
+   write the stale image over whatever SECTOR holds next.  A
+   revocation only covers earlier transactions, so SECTOR may be
+   reused as metadata within the running one. */
+void
+journal_forget (block_sector_t sector)
+{
+  size_t idx;
+
+  if (!enabled)
+    return;
+
+  lock_acquire (&journal_lock);
+  if (find_sector (txn_sectors, txn_cnt, sector, &idx))
+    {
+      txn_sectors[idx] = txn_sectors[--txn_cnt];
+      cache_unpin (sector);
+    }
+  if (find_sector (logged, logged_cnt, sector, NULL)
+      && !find_sector (txn_revoked, txn_revoke_cnt, sector, NULL))
+    {
+      if (txn_revoke_cnt < TXN_MAX_REVOKES)
+        txn_revoked[txn_revoke_cnt++] = sector;
+      else
+        {
+          /* Out of room.  Empty the log instead, which leaves no
+             image for any revocation to cover. */
+          checkpoint_locked ();
+          txn_revoke_cnt = 0;
+        }
+    }
+  lock_release (&journal_lock);
+}
+
+/* Makes every operation that finished before the call durable.
+   The running transaction is committed once the operations in it
+   are done, unless another thread commits it first; threads that
+   call this together share a single commit.  No new operation
+   starts while this waits, so it cannot be starved.  The free map
+   is written out first so that the commit covers it.  Must not be
+   called inside an operation. */
+void
+journal_sync (void)
+{
+  uint32_t target;
+
+  free_map_sync ();
+  if (!enabled)
+    return;
+  ASSERT (thread_current ()->journal_depth == 0);
+
+  lock_acquire (&journal_lock);
+  target = seq;
+  sync_cnt++;
+  while (seq == target && (txn_cnt > 0 || txn_revoke_cnt > 0))
+    {
+      if (active > 0)
+        cond_wait (&committed, &journal_lock);
+      else
+        commit_locked ();
+    }
+  sync_cnt--;
+  lock_release (&journal_lock);
+}
+
+/* Returns true if the disk has a journal. */
+bool
+journal_enabled (void)
+{
+  return enabled;
+}
+
+/* Commits the running transaction and empties the log, writing
+   every logged sector home.  Called at shutdown, so that the next
+   mount has nothing to replay. */
+void
+journal_done (void)
+{
+  if (!enabled)
+    return;
+
+  lock_acquire (&journal_lock);
+  commit_locked ();
+  checkpoint_locked ();
+  lock_release (&journal_lock);
+}
+
+/* Writes the running transaction to the log, starts a new one, and
+   wakes the threads waiting for a commit.  The caller must hold
+   JOURNAL_LOCK. */
+static void
+commit_locked (void)
+{
+  struct journal_commit *c = (struct journal_commit *) sector_buf;
+  uint32_t checksum = 0;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+  if (txn_cnt == 0 && txn_revoke_cnt == 0)
+    return;
+  if (log_pos + txn_cnt + 2 > LOG_SECTORS)
+    checkpoint_locked ();
+
+  memset (&desc, 0, sizeof desc);
+  desc.magic = JOURNAL_MAGIC;
+  desc.seq = seq;
+  desc.cnt = txn_cnt;
+  desc.revoke_cnt = txn_revoke_cnt;
+  memcpy (desc.sectors, txn_sectors, txn_cnt * sizeof *txn_sectors);
+  memcpy (desc.revoked, txn_revoked, txn_revoke_cnt * sizeof *txn_revoked);
+  block_write (fs_device, LOG_START + log_pos, &desc);
+
+  for (i = 0; i < txn_cnt; i++)
+    {
+      cache_read (fs_device, txn_sectors[i], sector_buf, 0, BLOCK_SECTOR_SIZE);
+      checksum = checksum * 31 + hash_bytes (sector_buf, BLOCK_SECTOR_SIZE);
+      block_write (fs_device, LOG_START + log_pos + 1 + i, sector_buf);
+    }
+
+  memset (c, 0, sizeof *c);
+  c->magic = JOURNAL_MAGIC;
+  c->seq = seq;
+  c->checksum = checksum;
+  block_write (fs_device, LOG_START + log_pos + 1 + txn_cnt, c);
+
+  /* Committed: the sectors may go home whenever the cache likes. */
+  for (i = 0; i < txn_cnt; i++)
+    {
+      size_t idx;
+
+      cache_unpin (txn_sectors[i]);
+      if (!find_sector (logged, logged_cnt, txn_sectors[i], &idx))
+        {
+          idx = logged_cnt++;
+          logged[idx] = txn_sectors[i];
+        }
+      logged_at[idx] = LOG_START + log_pos + 1 + i;
+    }
+  log_pos += txn_cnt + 2;
+  txn_cnt = txn_revoke_cnt = 0;
+  seq++;
+  cond_broadcast (&committed, &journal_lock);
+}
+
+/* Writes every sector logged so far home and empties the log.  A
+   logged sector that the running transaction has changed again is
+   pinned, and the cache holds uncommitted changes to it, so its
+   committed image is copied home from the log instead.  The caller
+   must hold JOURNAL_LOCK. */
+static void
+checkpoint_locked (void)
+{
+  size_t i;
+
+  for (i = 0; i < logged_cnt; i++)
+    if (find_sector (txn_sectors, txn_cnt, logged[i], NULL))
+      {
+        block_read (fs_device, logged_at[i], sector_buf);
+        block_write (fs_device, logged[i], sector_buf);
+      }
+    else
+      cache_write_back (logged[i]);
+  logged_cnt = 0;
+  log_pos = 0;
+  write_header ();
+}
@@ -0,0 +1,30 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+#include "filesys/off_t.h"
+
+/* Write-ahead journal for file system metadata: inode sectors,
+   indirect blocks, directory contents and the free map.  Changes
+   are gathered into a transaction whose sectors stay pinned in the
+   buffer cache, and the transaction is committed to the log, a
+   reserved run of sectors, before any of them goes home.  After a
+   crash, committed transactions are replayed at mount. */
+
+/* The log's location on disk, reserved when formatting. */
+#define JOURNAL_SECTOR 2        /* Journal header sector. */
+#define JOURNAL_SECTORS 128     /* Sectors reserved, header included. */
+
+void journal_init (bool format);
+void journal_begin (void);
+void journal_end (void);
+void journal_dirty (block_sector_t sector);
+void journal_write (block_sector_t sector, const void *buffer, off_t ofs,
+                    int size, block_sector_t owner);
+void journal_forget (block_sector_t sector);
+void journal_sync (void);
+bool journal_enabled (void);
+void journal_done (void);
+
+#endif /* filesys/journal.h */
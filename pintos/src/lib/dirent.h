@@ -0,0 +1,14 @@
+#ifndef __LIB_DIRENT_H
+#define __LIB_DIRENT_H
+
+#include <stdbool.h>
+
+/* A directory entry as returned by the getdents system call. */
+struct dirent
+  {
+    int inumber;                /* Inode number. */
+    bool is_dir;                /* Directory or ordinary file? */
+    char name[14 + 1];          /* Null-terminated file name. */
+  };
+
+#endif /* lib/dirent.h */
@@ -3,6 +3,7 @@
 #include <limits.h>
 #include <round.h>
 #include <stdio.h>
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
 #ifdef FILESYS
 #include "filesys/file.h"
@@ -21,6 +22,12 @@ typedef unsigned long elem_type;
 /* Number of bits in an element. */
 #define ELEM_BITS (sizeof (elem_type) * CHAR_BIT)
 
+/* Bitmaps with at least this many elements also keep a summary
+   level, with one bit per element that is set when every bit in
+   that element is set.  Scans for unset bits use it to skip runs
+   of full elements without reading them. */
+#define SUMMARY_MIN_ELEMS 64
+
 /* From the outside, a bitmap is an array of bits.  From the
    inside, it's an array of elem_type (defined above) that
    simulates an array of bits. */
@@ -28,6 +35,7 @@ struct bitmap
   {
     size_t bit_cnt;     /* Number of bits. */
     elem_type *bits;    /* Elements that represent bits. */
+    elem_type *full;    /* Summary of full elements, or null. */
   };
 
 /* Returns the index of the element that contains the bit
@@ -60,6 +68,23 @@ byte_cnt (size_t bit_cnt)
   return sizeof (elem_type) * elem_cnt (bit_cnt);
 }
 
+/* Returns the number of summary elements kept for a bitmap of
+   BIT_CNT bits, which is 0 if it has no summary. */
+static inline size_t
+summary_elem_cnt (size_t bit_cnt)
+{
+  size_t cnt = elem_cnt (bit_cnt);
+  return cnt >= SUMMARY_MIN_ELEMS ? elem_cnt (cnt) : 0;
+}
+
+/* Returns the number of bytes required for BIT_CNT bits plus
+   their summary. */
+static inline size_t
+storage_cnt (size_t bit_cnt)
+{
+  return byte_cnt (bit_cnt) + sizeof (elem_type) * summary_elem_cnt (bit_cnt);
+}
+
 /* Returns a bit mask in which the bits actually used in the last
    element of B's bits are set to 1 and the rest are set to 0. */
 static inline elem_type
@@ -68,6 +93,92 @@ last_mask (const struct bitmap *b)
   int last_bits = b->bit_cnt % ELEM_BITS;
   return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
+
+/* Returns a mask of the bits in an element numbered FIRST or
+   higher, counting from 0.  FIRST must be less than ELEM_BITS. */
+static inline elem_type
+high_mask (size_t first) 
+{
+  return (elem_type) -1 << first;
+}
+
+/* Returns a mask of the CNT bits in an element starting at bit
+   FIRST.  FIRST + CNT must not exceed ELEM_BITS. */
+static inline elem_type
+range_mask (size_t first, size_t cnt) 
+{
+  elem_type mask = high_mask (first);
+  if (first + cnt < ELEM_BITS)
+    mask &= ((elem_type) 1 << (first + cnt)) - 1;
+  return mask;
+}
+
+/* Returns the index of the lowest set bit in E, which must not
+   be 0.  Compiles to a single BSF instruction on x86. */
+static inline size_t
+lowest_bit (elem_type e) 
+{
+  return __builtin_ctzl (e);
+}
+
+/* Returns the number of set bits in E. */
+static inline size_t
+count_bits (elem_type e) 
+{
+  size_t cnt = 0;
+  for (; e != 0; e &= e - 1)
+    cnt++;
+  return cnt;
+}
+
+/* Returns the bits of element IDX in B that are set to VALUE,
+   leaving bits past the end of B clear. */
+static inline elem_type
+match_bits (const struct bitmap *b, size_t idx, bool value) 
+{
+  elem_type e = value ? b->bits[idx] : ~b->bits[idx];
+  if (idx == elem_cnt (b->bit_cnt) - 1)
+    e &= last_mask (b);
+  return e;
+}
+
+/* Brings the summary bit for element IDX of B up to date with
+   the element's contents.  Interrupts are turned off so that the
+   element cannot change between the test and the update. */
+static inline void
+update_summary (struct bitmap *b, size_t idx) 
+{
+  if (b->full != NULL)
+    {
+      enum intr_level old_level = intr_disable ();
+      if (match_bits (b, idx, false) == 0)
+        b->full[elem_idx (idx)] |= bit_mask (idx);
+      else
+        b->full[elem_idx (idx)] &= ~bit_mask (idx);
+      intr_set_level (old_level);
+    }
+}
+
+/* Returns the index of the first element of B at or after IDX
+   that is not full, according to B's summary, or the number of
+   elements in B if there is none. */
+static size_t
+next_nonfull_elem (const struct bitmap *b, size_t idx) 
+{
+  size_t cnt = elem_cnt (b->bit_cnt);
+
+  while (idx < cnt)
+    {
+      elem_type open = ~b->full[elem_idx (idx)] & high_mask (idx % ELEM_BITS);
+      if (open != 0)
+        {
+          idx = elem_idx (idx) * ELEM_BITS + lowest_bit (open);
+          break;
+        }
+      idx = (elem_idx (idx) + 1) * ELEM_BITS;
+    }
+  return idx < cnt ? idx : cnt;
+}
 
 /* Creation and destruction. */
 
@@ -82,9 +193,11 @@ bitmap_create (size_t bit_cnt)
   if (b != NULL)
     {
       b->bit_cnt = bit_cnt;
-      b->bits = malloc (byte_cnt (bit_cnt));
+      b->bits = malloc (storage_cnt (bit_cnt));
       if (b->bits != NULL || bit_cnt == 0)
         {
+          b->full = (summary_elem_cnt (bit_cnt) > 0
+                     ? b->bits + elem_cnt (bit_cnt) : NULL);
           bitmap_set_all (b, false);
           return b;
         }
@@ -105,6 +218,8 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED)
 
   b->bit_cnt = bit_cnt;
   b->bits = (elem_type *) (b + 1);
+  b->full = (summary_elem_cnt (bit_cnt) > 0
+             ? b->bits + elem_cnt (bit_cnt) : NULL);
   bitmap_set_all (b, false);
   return b;
 }
@@ -114,7 +229,7 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED)
 size_t
 bitmap_buf_size (size_t bit_cnt) 
 {
-  return sizeof (struct bitmap) + byte_cnt (bit_cnt);
+  return sizeof (struct bitmap) + storage_cnt (bit_cnt);
 }
 
 /* Destroys bitmap B, freeing its storage.
@@ -163,6 +278,7 @@ bitmap_mark (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the OR instruction in [IA32-v2b]. */
   asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  update_summary (b, idx);
 }
 
 /* Atomically sets the bit numbered BIT_IDX in B to false. */
@@ -176,6 +292,7 @@ bitmap_reset (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the AND instruction in [IA32-v2a]. */
   asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+  update_summary (b, idx);
 }
 
 /* Atomically toggles the bit numbered IDX in B;
@@ -191,6 +308,7 @@ bitmap_flip (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the XOR instruction in [IA32-v2b]. */
   asm ("xorl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  update_summary (b, idx);
 }
 
 /* Returns the value of the bit numbered IDX in B. */
@@ -213,18 +331,32 @@ bitmap_set_all (struct bitmap *b, bool value)
   bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.
+   Each element is updated atomically, one element at a time. */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
+  size_t end = start + cnt;
   
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    bitmap_set (b, start + i, value);
+  while (start < end)
+    {
+      size_t idx = elem_idx (start);
+      size_t ofs = start % ELEM_BITS;
+      size_t n = end - start < ELEM_BITS - ofs ? end - start : ELEM_BITS - ofs;
+      elem_type mask = range_mask (ofs, n);
+
+      /* See bitmap_mark() and bitmap_reset(). */
+      if (value)
+        asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+      else
+        asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+      update_summary (b, idx);
+      start += n;
+    }
 }
 
 /* Returns the number of bits in B between START and START + CNT,
@@ -232,16 +364,23 @@ bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i, value_cnt;
+  size_t end = start + cnt;
+  size_t value_cnt;
 
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
   value_cnt = 0;
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      value_cnt++;
+  while (start < end)
+    {
+      size_t ofs = start % ELEM_BITS;
+      size_t n = end - start < ELEM_BITS - ofs ? end - start : ELEM_BITS - ofs;
+
+      value_cnt += count_bits (match_bits (b, elem_idx (start), value)
+                               & range_mask (ofs, n));
+      start += n;
+    }
   return value_cnt;
 }
 
@@ -250,15 +389,21 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
+  size_t end = start + cnt;
   
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
+  while (start < end)
+    {
+      size_t ofs = start % ELEM_BITS;
+      size_t n = end - start < ELEM_BITS - ofs ? end - start : ELEM_BITS - ofs;
+
+      if (match_bits (b, elem_idx (start), value) & range_mask (ofs, n))
+        return true;
+      start += n;
+    }
   return false;
 }
 
@@ -291,20 +436,65 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
-   If there is no such group, returns BITMAP_ERROR. */
+   If there is no such group, returns BITMAP_ERROR.
+
+   Works a whole element at a time: each run of bits set to VALUE
+   is found with two BSF instructions, however long it is, and
+   elements without any such bits are passed over in a single
+   test, or, when looking for unset bits, skipped wholesale by
+   way of the summary. */
 size_t
 bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
+  size_t run_start = 0;
+  bool in_run = false;
+  size_t i = start;
+
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
-  if (cnt <= b->bit_cnt) 
+  if (cnt > b->bit_cnt || start > b->bit_cnt - cnt)
+    return BITMAP_ERROR;
+  if (cnt == 0)
+    return start;
+
+  while (i < b->bit_cnt)
     {
-      size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
+      size_t idx = elem_idx (i);
+      size_t ofs = i % ELEM_BITS;
+      elem_type other;
+
+      if (!in_run)
+        {
+          /* Find the next bit set to VALUE. */
+          elem_type match;
+
+          if (!value && ofs == 0 && b->full != NULL
+              && (b->full[elem_idx (idx)] & bit_mask (idx)))
+            {
+              i = next_nonfull_elem (b, idx) * ELEM_BITS;
+              continue;
+            }
+          match = match_bits (b, idx, value) & high_mask (ofs);
+          if (match == 0)
+            {
+              i = (idx + 1) * ELEM_BITS;
+              continue;
+            }
+          ofs = lowest_bit (match);
+          i = run_start = idx * ELEM_BITS + ofs;
+          if (run_start > b->bit_cnt - cnt)
+            break;
+          in_run = true;
+        }
+
+      /* Extend the run to the next bit not set to VALUE. */
+      other = ~match_bits (b, idx, value) & high_mask (ofs);
+      i = other != 0 ? idx * ELEM_BITS + lowest_bit (other) : (idx + 1) * ELEM_BITS;
+      if (i - run_start >= cnt)
+        return run_start;
+      if (other != 0)
+        in_run = false;
     }
   return BITMAP_ERROR;
 }
@@ -344,8 +534,12 @@ bitmap_read (struct bitmap *b, struct file *file)
   if (b->bit_cnt > 0) 
     {
       off_t size = byte_cnt (b->bit_cnt);
+      size_t i;
+
       success = file_read_at (file, b->bits, size, 0) == size;
       b->bits[elem_cnt (b->bit_cnt) - 1] &= last_mask (b);
+      for (i = 0; i < elem_cnt (b->bit_cnt); i++)
+        update_summary (b, i);
     }
   return success;
 }
@@ -358,6 +552,22 @@ bitmap_write (const struct bitmap *b, struct file *file)
   off_t size = byte_cnt (b->bit_cnt);
   return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes bytes OFS through OFS + SIZE - 1 of B's file image to
+   FILE, at the same offset, leaving the rest of FILE alone.  The
+   range is clipped to the end of the image.  Returns true if
+   successful, false otherwise. */
+bool
+bitmap_write_part (const struct bitmap *b, struct file *file,
+                   off_t ofs, off_t size)
+{
+  off_t file_size = byte_cnt (b->bit_cnt);
+  if (ofs >= file_size)
+    return true;
+  if (size > file_size - ofs)
+    size = file_size - ofs;
+  return file_write_at (file, (const uint8_t *) b->bits + ofs, size, ofs) == size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
@@ -0,0 +1,49 @@
+#ifndef __LIB_RING_H
+#define __LIB_RING_H
+
+/* A submission and completion ring, for issuing many system calls
+   with one trap.
+
+   A process fills in a struct ring in its own memory and registers
+   it with ring_setup().  To queue a call it writes an entry at
+   sq[sq_tail % RING_SIZE] and increments sq_tail.  ring_enter()
+   then runs the queued calls in order, advancing sq_head past each
+   one, and posts each result at cq[cq_tail % RING_SIZE], advancing
+   cq_tail.  The process reaps results by reading entries from
+   cq_head up to cq_tail and then advancing cq_head, without
+   entering the kernel.
+
+   The counters run freely and wrap; only their differences and
+   their values modulo RING_SIZE matter. */
+
+/* Number of entries in each queue.  Must be a power of 2. */
+#define RING_SIZE 64
+
+/* A queued system call. */
+struct ring_sqe
+  {
+    unsigned call_nr;           /* SYS_READ, SYS_WRITE, ... */
+    int args[4];                /* Arguments, as for the call itself. */
+    unsigned user_data;         /* Copied to the completion. */
+  };
+
+/* The result of a system call run from the ring. */
+struct ring_cqe
+  {
+    unsigned user_data;         /* From the submission. */
+    int result;                 /* Return value, or -1 if the call
+                                   may not be queued. */
+  };
+
+/* Submission and completion queues. */
+struct ring
+  {
+    unsigned sq_head;           /* Advanced by the kernel. */
+    unsigned sq_tail;           /* Advanced by the process. */
+    unsigned cq_head;           /* Advanced by the process. */
+    unsigned cq_tail;           /* Advanced by the kernel. */
+    struct ring_sqe sq[RING_SIZE];
+    struct ring_cqe cq[RING_SIZE];
+  };
+
+#endif /* lib/ring.h */
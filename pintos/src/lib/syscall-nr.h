@@ -34,7 +34,26 @@ enum
     SYS_NUM_DEVICE_READS,       /* The number of file system device reads. */
     SYS_NUM_DEVICE_WRITES,      /* The number of file system device writes. */
     SYS_MMAP,                   /* Map a file into memory. */
-    SYS_MUNMAP                 /* Remove a memory mapping. */
+    SYS_MUNMAP,                 /* Remove a memory mapping. */
+    SYS_NUM_EXTENTS,            /* The number of extents of a file. */
+    SYS_FALLOCATE,              /* Reserve disk space for a file. */
+    SYS_NUM_SEEK_DISTANCE,      /* Total file system device seek distance. */
+    SYS_NUM_DCACHE_HITS,        /* Directory lookups answered from cache. */
+    SYS_NUM_DCACHE_MISSES,      /* Directory lookups that searched a directory. */
+    SYS_GETDENTS,               /* Reads many directory entries. */
+    SYS_FSYNC,                  /* Makes a file's changes durable. */
+    SYS_PREAD,                  /* Reads from a given file offset. */
+    SYS_PWRITE,                 /* Writes at a given file offset. */
+    SYS_READV,                  /* Reads into many buffers. */
+    SYS_WRITEV,                 /* Writes from many buffers. */
+    SYS_COPY_FILE_RANGE,        /* Copies between files in the kernel. */
+    SYS_RING_SETUP,             /* Registers a submission ring. */
+    SYS_RING_ENTER,             /* Runs calls queued on the ring. */
+    SYS_AIO_READ,               /* Starts an asynchronous read. */
+    SYS_AIO_WRITE,              /* Starts an asynchronous write. */
+    SYS_AIO_WAIT,               /* Waits for an asynchronous transfer. */
+    SYS_AIO_POLL,               /* Checks on an asynchronous transfer. */
+    SYS_SYSCALL_STATS           /* Reports per-syscall accounting. */
 
 
     
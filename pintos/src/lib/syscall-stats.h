@@ -0,0 +1,40 @@
+#ifndef __LIB_SYSCALL_STATS_H
+#define __LIB_SYSCALL_STATS_H
+
+/* Per-system-call accounting, as reported by syscall_stats().
+
+   Each call's latency is measured in processor cycles with rdtsc
+   and counted in a histogram of power-of-2 buckets.  Bucket 0
+   counts calls that took fewer than 2**SYSCALL_HIST_SHIFT cycles
+   and bucket I, for I > 0, calls that took at least
+   2**(SYSCALL_HIST_SHIFT + I - 1) cycles but fewer than twice that.
+   The last bucket also counts all slower calls.
+
+   exit() and halt() never return, so they are not counted. */
+
+/* Number of histogram buckets. */
+#define SYSCALL_HIST_CNT 16
+
+/* Log base 2 of the upper bound of histogram bucket 0. */
+#define SYSCALL_HIST_SHIFT 7
+
+/* Room for any system call's name, including the null. */
+#define SYSCALL_NAME_MAX 24
+
+/* Most system calls there will be, for sizing arrays. */
+#define SYSCALL_STATS_MAX 64
+
+/* Scopes for syscall_stats(). */
+#define SYSCALL_STATS_SELF 0    /* Calls made by the calling process. */
+#define SYSCALL_STATS_ALL 1     /* Calls made by every process. */
+
+/* Accounting for one system call. */
+struct syscall_stat
+  {
+    char name[SYSCALL_NAME_MAX];        /* Name, e.g. "read". */
+    unsigned calls;                     /* Number of calls. */
+    long long cycles;                   /* Total cycles across calls. */
+    unsigned hist[SYSCALL_HIST_CNT];    /* Latency histogram. */
+  };
+
+#endif /* lib/syscall-stats.h */
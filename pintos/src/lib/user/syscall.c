@@ -1,66 +1,128 @@
 #include <syscall.h>
 #include "../syscall-nr.h"
 
+/* Instructions that enter the kernel once the system call number
+   and arguments are on the stack.  SYSENTER saves nothing, so it is
+   handed the return address in %edx and the stack pointer in %ecx
+   (see threads/sysenter.S); both registers are treated as clobbered
+   on either path. */
+#define TRAP_INT "int $0x30"
+#define TRAP_SYSENTER "movl %%esp, %%ecx; movl $1f, %%edx; sysenter; 1:"
+
+/* If true, enter the kernel with SYSENTER rather than int $0x30.
+   Set by syscall_use_sysenter(). */
+static bool use_sysenter;
+
 /* Invokes syscall NUMBER, passing no arguments, and returns the
    return value as an `int'. */
 #define syscall0(NUMBER)                                        \
+        (use_sysenter ? syscall0_via (TRAP_SYSENTER, NUMBER)    \
+                      : syscall0_via (TRAP_INT, NUMBER))
+#define syscall0_via(TRAP, NUMBER)                              \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
-            ("pushl %[number]; int $0x30; addl $4, %%esp"       \
+            ("pushl %[number]; " TRAP "; addl $4, %%esp"        \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER)                          \
-               : "memory");                                     \
+               : "ecx", "edx", "memory");                       \
           retval;                                               \
         })
 
 /* Invokes syscall NUMBER, passing argument ARG0, and returns the
    return value as an `int'. */
 #define syscall1(NUMBER, ARG0)                                           \
+        (use_sysenter ? syscall1_via (TRAP_SYSENTER, NUMBER, ARG0)       \
+                      : syscall1_via (TRAP_INT, NUMBER, ARG0))
+#define syscall1_via(TRAP, NUMBER, ARG0)                                 \
         ({                                                               \
           int retval;                                                    \
           asm volatile                                                   \
-            ("pushl %[arg0]; pushl %[number]; int $0x30; addl $8, %%esp" \
+            ("pushl %[arg0]; pushl %[number]; " TRAP "; addl $8, %%esp"  \
                : "=a" (retval)                                           \
                : [number] "i" (NUMBER),                                  \
                  [arg0] "g" (ARG0)                                       \
-               : "memory");                                              \
+               : "ecx", "edx", "memory");                                \
           retval;                                                        \
         })
 
 /* Invokes syscall NUMBER, passing arguments ARG0 and ARG1, and
    returns the return value as an `int'. */
-#define syscall2(NUMBER, ARG0, ARG1)                            \
+#define syscall2(NUMBER, ARG0, ARG1)                                    \
+        (use_sysenter ? syscall2_via (TRAP_SYSENTER, NUMBER, ARG0, ARG1) \
+                      : syscall2_via (TRAP_INT, NUMBER, ARG0, ARG1))
+#define syscall2_via(TRAP, NUMBER, ARG0, ARG1)                  \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
             ("pushl %[arg1]; pushl %[arg0]; "                   \
-             "pushl %[number]; int $0x30; addl $12, %%esp"      \
+             "pushl %[number]; " TRAP "; addl $12, %%esp"       \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER),                         \
                  [arg0] "r" (ARG0),                             \
                  [arg1] "r" (ARG1)                              \
-               : "memory");                                     \
+               : "ecx", "edx", "memory");                       \
           retval;                                               \
         })
 
 /* Invokes syscall NUMBER, passing arguments ARG0, ARG1, and
    ARG2, and returns the return value as an `int'. */
-#define syscall3(NUMBER, ARG0, ARG1, ARG2)                      \
+#define syscall3(NUMBER, ARG0, ARG1, ARG2)                              \
+        (use_sysenter                                                   \
+         ? syscall3_via (TRAP_SYSENTER, NUMBER, ARG0, ARG1, ARG2)       \
+         : syscall3_via (TRAP_INT, NUMBER, ARG0, ARG1, ARG2))
+#define syscall3_via(TRAP, NUMBER, ARG0, ARG1, ARG2)            \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
             ("pushl %[arg2]; pushl %[arg1]; pushl %[arg0]; "    \
-             "pushl %[number]; int $0x30; addl $16, %%esp"      \
+             "pushl %[number]; " TRAP "; addl $16, %%esp"       \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER),                         \
                  [arg0] "r" (ARG0),                             \
                  [arg1] "r" (ARG1),                             \
                  [arg2] "r" (ARG2)                              \
-               : "memory");                                     \
+               : "ecx", "edx", "memory");                       \
+          retval;                                               \
+        })
+
+/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, ARG2, and
+   ARG3, and returns the return value as an `int'. */
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                        \
+        (use_sysenter                                                   \
+         ? syscall4_via (TRAP_SYSENTER, NUMBER, ARG0, ARG1, ARG2, ARG3) \
+         : syscall4_via (TRAP_INT, NUMBER, ARG0, ARG1, ARG2, ARG3))
+#define syscall4_via(TRAP, NUMBER, ARG0, ARG1, ARG2, ARG3)      \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg3]; pushl %[arg2]; pushl %[arg1]; "    \
+             "pushl %[arg0]; pushl %[number]; " TRAP "; "       \
+             "addl $20, %%esp"                                  \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "r" (ARG0),                             \
+                 [arg1] "r" (ARG1),                             \
+                 [arg2] "r" (ARG2),                             \
+                 [arg3] "r" (ARG3)                              \
+               : "ecx", "edx", "memory");                       \
           retval;                                               \
         })
 
+/* Makes the system call wrappers enter the kernel with SYSENTER
+   if ENABLE is true and the processor has it, and with int $0x30
+   otherwise.  Returns true if SYSENTER is now in use. */
+bool
+syscall_use_sysenter (bool enable)
+{
+  unsigned eax = 1, ebx, ecx, edx;
+
+  /* The kernel sets up SYSENTER if this SEP bit is set. */
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  use_sysenter = enable && (edx & (1u << 11)) != 0;
+  return use_sysenter;
+}
+
 int
 practice (int i)
 {
@@ -177,6 +239,12 @@ readdir (int fd, char name[READDIR_MAX_LEN + 1])
   return syscall2 (SYS_READDIR, fd, name);
 }
 
+int
+getdents (int fd, struct dirent *entries, unsigned cnt)
+{
+  return syscall3 (SYS_GETDENTS, fd, entries, cnt);
+}
+
 bool
 isdir (int fd) 
 {
@@ -189,6 +257,30 @@ inumber (int fd)
   return syscall1 (SYS_INUMBER, fd);
 }
 
+bool
+fallocate (int fd, unsigned offset, unsigned length)
+{
+  return syscall3 (SYS_FALLOCATE, fd, offset, length);
+}
+
+bool
+fsync (int fd)
+{
+  return syscall1 (SYS_FSYNC, fd);
+}
+
+int
+pread (int fd, void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PREAD, fd, buffer, size, offset);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PWRITE, fd, buffer, size, offset);
+}
+
 void 
 reset_cache () 
 {
@@ -212,3 +304,79 @@ long long number_device_reads() {
 long long number_device_writes() {
   return syscall0(SYS_NUM_DEVICE_WRITES);
 }
+
+long long number_seek_distance() {
+  return syscall0(SYS_NUM_SEEK_DISTANCE);
+}
+
+int number_dcache_hits() {
+  return syscall0(SYS_NUM_DCACHE_HITS);
+}
+
+int number_dcache_misses() {
+  return syscall0(SYS_NUM_DCACHE_MISSES);
+}
+
+int number_extents(int fd) {
+  return syscall1(SYS_NUM_EXTENTS, fd);
+}
+
+int
+readv (int fd, const struct iovec *iov, int cnt)
+{
+  return syscall3 (SYS_READV, fd, iov, cnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int cnt)
+{
+  return syscall3 (SYS_WRITEV, fd, iov, cnt);
+}
+
+int
+copy_file_range (int fd_in, int fd_out, unsigned size)
+{
+  return syscall3 (SYS_COPY_FILE_RANGE, fd_in, fd_out, size);
+}
+
+bool
+ring_setup (struct ring *ring)
+{
+  return syscall1 (SYS_RING_SETUP, ring);
+}
+
+int
+ring_enter (unsigned to_submit)
+{
+  return syscall1 (SYS_RING_ENTER, to_submit);
+}
+
+int
+aio_read (int fd, void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_AIO_READ, fd, buffer, size, offset);
+}
+
+int
+aio_write (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_AIO_WRITE, fd, buffer, size, offset);
+}
+
+int
+aio_wait (int id)
+{
+  return syscall1 (SYS_AIO_WAIT, id);
+}
+
+int
+aio_poll (int id)
+{
+  return syscall1 (SYS_AIO_POLL, id);
+}
+
+int
+syscall_stats (int scope, struct syscall_stat *stats, unsigned cnt)
+{
+  return syscall3 (SYS_SYSCALL_STATS, scope, stats, cnt);
+}
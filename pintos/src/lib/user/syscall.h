@@ -3,6 +3,10 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <dirent.h>
+#include <ring.h>
+#include <syscall-stats.h>
+#include <uio.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -34,6 +38,7 @@ void seek (int fd, unsigned position);
 unsigned tell (int fd);
 void close (int fd);
 int practice (int i);
+bool syscall_use_sysenter (bool enable);
 
 /* Project 3 and optionally project 4. */
 mapid_t mmap (int fd, void *addr);
@@ -45,13 +50,32 @@ int number_cache_hits (void);
 int number_cache_accesses (void); 
 long long number_device_reads (void);
 long long number_device_writes (void);
+long long number_seek_distance (void);
+int number_dcache_hits (void);
+int number_dcache_misses (void);
+int number_extents (int fd);
 
 
 /* Project 4 only. */
 bool chdir (const char *dir);
 bool mkdir (const char *dir);
 bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
+int getdents (int fd, struct dirent *, unsigned cnt);
 bool isdir (int fd);
 int inumber (int fd);
+bool fallocate (int fd, unsigned offset, unsigned length);
+bool fsync (int fd);
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+int readv (int fd, const struct iovec *, int cnt);
+int writev (int fd, const struct iovec *, int cnt);
+int copy_file_range (int fd_in, int fd_out, unsigned size);
+bool ring_setup (struct ring *);
+int ring_enter (unsigned to_submit);
+int aio_read (int fd, void *buffer, unsigned length, unsigned offset);
+int aio_write (int fd, const void *buffer, unsigned length, unsigned offset);
+int aio_wait (int id);
+int aio_poll (int id);
+int syscall_stats (int scope, struct syscall_stat *, unsigned cnt);
 
 #endif /* lib/user/syscall.h */
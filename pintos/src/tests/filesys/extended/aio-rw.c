@@ -0,0 +1,65 @@
+/* Writes a file with asynchronous writes at several offsets,
+   reads it back with asynchronous reads, and checks aio_wait() and
+   aio_poll() on finished, unknown and refused requests. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static const char *chunks[] = {"aaaaaaaaaa", "bbbbbbbbbb", "cccccccccc",
+                               "dddddddddd"};
+
+void
+test_main (void)
+{
+  char buf[64];
+  int ids[4];
+  int fd, id, first = 0, i;
+
+  CHECK (create ("data", 0), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+
+  msg ("start writes in reverse order");
+  for (i = 3; i >= 0; i--)
+    if ((ids[i] = aio_write (fd, chunks[i], 10, i * 10)) < 0)
+      fail ("aio_write at offset %d failed", i * 10);
+  for (i = 0; i < 4; i++)
+    if (aio_wait (ids[i]) != 10)
+      fail ("aio_write at offset %d was short", i * 10);
+  CHECK (filesize (fd) == 40, "filesize is 40");
+  CHECK (tell (fd) == 0, "position is still 0");
+  CHECK (aio_wait (ids[0]) == -1, "aio_wait on a finished id fails");
+  CHECK (aio_poll (ids[0]) == -1, "aio_poll on a finished id fails");
+
+  memset (buf, 0, sizeof buf);
+  CHECK ((id = aio_read (fd, buf, 15, 15)) > 0, "start read at offset 15");
+  while (aio_poll (id) == 0)
+    continue;
+  CHECK (aio_poll (id) == 1, "aio_poll reports the read done");
+  CHECK (aio_wait (id) == 15, "aio_wait returns 15");
+  CHECK (!strcmp (buf, "bbbbbcccccccccc"), "read returned the right bytes");
+  CHECK ((id = aio_read (fd, buf, 20, 40)) > 0 && aio_wait (id) == 0,
+         "read at the end returns 0");
+
+  CHECK (aio_write (1, "x", 1, 0) == -1,
+         "aio_write to the console fails");
+  CHECK (aio_read (fd, buf, 0, 0) == -1, "empty aio_read fails");
+  CHECK (aio_read (fd, buf, 10, 0xffffff00) == -1,
+         "aio_read at an offset past INT_MAX fails");
+  CHECK (aio_write (fd, "x", 1, 0xffffff00) == -1,
+         "aio_write at an offset past INT_MAX fails");
+
+  /* Request ids run consecutively, from FIRST. */
+  for (i = 0; i < 1000 && (id = aio_read (fd, buf, 10, 0)) > 0; i++)
+    if (i == 0)
+      first = id;
+  CHECK (i > 0 && i < 1000, "outstanding requests are limited");
+  while (i-- > 0)
+    if (aio_wait (first + i) != 10)
+      fail ("aio_read of a limited request failed");
+
+  msg ("close \"data\" with a write in progress");
+  aio_write (fd, "e", 1, 40);
+  close (fd);
+}
@@ -0,0 +1,27 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(aio-rw) begin
+(aio-rw) create "data"
+(aio-rw) open "data"
+(aio-rw) start writes in reverse order
+(aio-rw) filesize is 40
+(aio-rw) position is still 0
+(aio-rw) aio_wait on a finished id fails
+(aio-rw) aio_poll on a finished id fails
+(aio-rw) start read at offset 15
+(aio-rw) aio_poll reports the read done
+(aio-rw) aio_wait returns 15
+(aio-rw) read returned the right bytes
+(aio-rw) read at the end returns 0
+(aio-rw) aio_write to the console fails
+(aio-rw) empty aio_read fails
+(aio-rw) aio_read at an offset past INT_MAX fails
+(aio-rw) aio_write at an offset past INT_MAX fails
+(aio-rw) outstanding requests are limited
+(aio-rw) close "data" with a write in progress
+(aio-rw) end
+EOF
+pass;
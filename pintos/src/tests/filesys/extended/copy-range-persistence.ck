@@ -0,0 +1,8 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($data) = join ('', map (chr (ord ('a') + $_ % 26), 0..1999));
+my ($src) = $data . "\0" x 3000 . substr ($data, 0, 1000);
+check_archive ({"src" => [$src], "dst" => [substr ($src, 100)]});
+pass;
@@ -0,0 +1,52 @@
+/* Copies parts of a file to another with copy_file_range(),
+   including a hole in the middle of the source, and checks the
+   copied bytes and that both file positions advance. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf1[2000], buf2[6000];
+
+void
+test_main (void)
+{
+  int src, dst;
+  size_t i;
+
+  for (i = 0; i < sizeof buf1; i++)
+    buf1[i] = 'a' + i % 26;
+  CHECK (create ("src", 0), "create \"src\"");
+  CHECK ((src = open ("src")) > 1, "open \"src\"");
+  CHECK (write (src, buf1, sizeof buf1) == (int) sizeof buf1,
+         "write 2000 bytes to \"src\"");
+  CHECK (pwrite (src, buf1, 1000, 5000) == 1000,
+         "write 1000 bytes at offset 5000 of \"src\"");
+  CHECK (create ("dst", 0), "create \"dst\"");
+  CHECK ((dst = open ("dst")) > 1, "open \"dst\"");
+
+  seek (src, 100);
+  CHECK (copy_file_range (src, dst, 1000) == 1000, "copy 1000 bytes");
+  CHECK (tell (src) == 1100 && tell (dst) == 1000, "positions advanced");
+  CHECK (copy_file_range (src, dst, 10000) == 4900, "copy the rest");
+  CHECK (copy_file_range (src, dst, 10000) == 0, "copy at the end");
+  CHECK (filesize (dst) == 5900, "filesize is 5900");
+
+  seek (dst, 0);
+  CHECK (read (dst, buf2, sizeof buf2) == 5900, "read \"dst\"");
+  for (i = 0; i < 5900; i++)
+    {
+      size_t ofs = i + 100;
+      char want = ofs < 2000 ? buf1[ofs] : ofs < 5000 ? 0 : buf1[ofs - 5000];
+      if (buf2[i] != want)
+        fail ("byte %zu of \"dst\" is %d, not %d", i, buf2[i], want);
+    }
+  msg ("\"dst\" holds the copied bytes");
+  CHECK (copy_file_range (src, src, 10) == -1, "copy to the same file fails");
+
+  msg ("close \"src\"");
+  close (src);
+  msg ("close \"dst\"");
+  close (dst);
+}
@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(copy-range) begin
+(copy-range) create "src"
+(copy-range) open "src"
+(copy-range) write 2000 bytes to "src"
+(copy-range) write 1000 bytes at offset 5000 of "src"
+(copy-range) create "dst"
+(copy-range) open "dst"
+(copy-range) copy 1000 bytes
+(copy-range) positions advanced
+(copy-range) copy the rest
+(copy-range) copy at the end
+(copy-range) filesize is 5900
+(copy-range) read "dst"
+(copy-range) "dst" holds the copied bytes
+(copy-range) copy to the same file fails
+(copy-range) close "src"
+(copy-range) close "dst"
+(copy-range) end
+EOF
+pass;
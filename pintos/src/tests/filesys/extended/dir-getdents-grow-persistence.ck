@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($dir) = {};
+$dir->{"f$_"} = [""] foreach 0 .. 39;
+$dir->{"g$_"} = [""] foreach 0 .. 199;
+check_archive ({"a" => $dir});
+pass;
@@ -0,0 +1,94 @@
+/* Lists a directory with getdents() while creating files in it,
+   enough for it to change to the hashed format and split its
+   buckets during the listing, and checks that no entry comes back
+   twice and that every entry that was there all along comes back.
+   Then lists it again and checks that every entry comes back
+   once. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define OLD_CNT 40              /* Files present before listing. */
+#define NEW_CNT 200             /* Files created while listing. */
+
+static bool seen[OLD_CNT + NEW_CNT];
+
+/* Lists the directory open as FD to the end, creating files in it
+   between batches while NEW_CNT has not been reached if GROW is
+   true, and returns the number of entries listed. */
+static int
+list (int fd, bool grow)
+{
+  struct dirent entries[4];
+  char name[16];
+  int cnt, created = 0, total = 0;
+  int i;
+
+  memset (seen, 0, sizeof seen);
+  while ((cnt = getdents (fd, entries, sizeof entries / sizeof *entries)) > 0)
+    {
+      for (i = 0; i < cnt; i++)
+        {
+          const char *n = entries[i].name;
+          int idx;
+
+          if (!strcmp (n, ".") || !strcmp (n, ".."))
+            continue;
+          if (n[0] == 'f')
+            idx = atoi (n + 1);
+          else if (n[0] == 'g')
+            idx = OLD_CNT + atoi (n + 1);
+          else
+            fail ("unexpected entry \"%s\"", n);
+          if (seen[idx])
+            fail ("\"%s\" listed twice", n);
+          seen[idx] = true;
+          total++;
+        }
+
+      for (i = 0; grow && i < 20 && created < NEW_CNT; i++, created++)
+        {
+          snprintf (name, sizeof name, "a/g%d", created);
+          if (!create (name, 0))
+            fail ("create \"%s\" failed", name);
+        }
+    }
+  if (cnt != 0)
+    fail ("getdents failed");
+  for (i = 0; i < OLD_CNT; i++)
+    if (!seen[i])
+      fail ("\"f%d\" not listed", i);
+  return total;
+}
+
+void
+test_main (void)
+{
+  char name[16];
+  int fd, i;
+
+  CHECK (mkdir ("a"), "mkdir \"a\"");
+  msg ("creating a/f0 through a/f%d...", OLD_CNT - 1);
+  for (i = 0; i < OLD_CNT; i++)
+    {
+      snprintf (name, sizeof name, "a/f%d", i);
+      if (!create (name, 0))
+        fail ("create \"%s\" failed", name);
+    }
+
+  CHECK ((fd = open ("a")) > 1, "open \"a\"");
+  list (fd, true);
+  msg ("listing while creating a/g0 through a/g%d lists no entry twice",
+       NEW_CNT - 1);
+  msg ("close \"a\"");
+  close (fd);
+
+  CHECK ((fd = open ("a")) > 1, "open \"a\"");
+  CHECK (list (fd, false) == OLD_CNT + NEW_CNT, "every entry listed once");
+  msg ("close \"a\"");
+  close (fd);
+}
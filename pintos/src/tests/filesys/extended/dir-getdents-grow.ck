@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-getdents-grow) begin
+(dir-getdents-grow) mkdir "a"
+(dir-getdents-grow) creating a/f0 through a/f39...
+(dir-getdents-grow) open "a"
+(dir-getdents-grow) listing while creating a/g0 through a/g199 lists no entry twice
+(dir-getdents-grow) close "a"
+(dir-getdents-grow) open "a"
+(dir-getdents-grow) every entry listed once
+(dir-getdents-grow) close "a"
+(dir-getdents-grow) end
+EOF
+pass;
@@ -0,0 +1,68 @@
+/* Creates a directory holding files and a subdirectory, then
+   lists it a few entries at a time with getdents() and checks
+   that every entry comes back once, with the right type and
+   inode number. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 10
+
+void
+test_main (void)
+{
+  bool seen[FILE_CNT + 1];
+  struct dirent entries[4];
+  char name[16];
+  int fd, cnt, total = 0;
+  int i;
+
+  CHECK (mkdir ("a"), "mkdir \"a\"");
+  CHECK (mkdir ("a/sub"), "mkdir \"a/sub\"");
+  msg ("creating a/f0 through a/f%d...", FILE_CNT - 1);
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "a/f%d", i);
+      if (!create (name, 0))
+        fail ("create \"%s\" failed", name);
+    }
+
+  CHECK ((fd = open ("a")) > 1, "open \"a\"");
+  memset (seen, 0, sizeof seen);
+  while ((cnt = getdents (fd, entries, sizeof entries / sizeof *entries)) > 0)
+    for (i = 0; i < cnt; i++)
+      {
+        struct dirent *e = &entries[i];
+        int idx, entry_fd;
+
+        if (!strcmp (e->name, ".") || !strcmp (e->name, ".."))
+          continue;
+        if (!strcmp (e->name, "sub"))
+          idx = FILE_CNT;
+        else if (e->name[0] == 'f')
+          idx = atoi (e->name + 1);
+        else
+          fail ("unexpected entry \"%s\"", e->name);
+        if (seen[idx])
+          fail ("\"%s\" listed twice", e->name);
+        seen[idx] = true;
+        total++;
+
+        if (e->is_dir != (idx == FILE_CNT))
+          fail ("\"%s\" has the wrong type", e->name);
+        snprintf (name, sizeof name, "a/%s", e->name);
+        entry_fd = open (name);
+        if (entry_fd < 2 || inumber (entry_fd) != e->inumber)
+          fail ("\"%s\" has the wrong inode number", e->name);
+        close (entry_fd);
+      }
+  CHECK (cnt == 0, "getdents reaches the end of \"a\"");
+  CHECK (total == FILE_CNT + 1, "every entry listed once");
+  CHECK (getdents (fd, entries, 4) == 0, "getdents at end returns 0");
+  msg ("close \"a\"");
+  close (fd);
+}
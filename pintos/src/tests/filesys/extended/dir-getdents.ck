@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-getdents) begin
+(dir-getdents) mkdir "a"
+(dir-getdents) mkdir "a/sub"
+(dir-getdents) creating a/f0 through a/f9...
+(dir-getdents) open "a"
+(dir-getdents) getdents reaches the end of "a"
+(dir-getdents) every entry listed once
+(dir-getdents) getdents at end returns 0
+(dir-getdents) close "a"
+(dir-getdents) end
+EOF
+pass;
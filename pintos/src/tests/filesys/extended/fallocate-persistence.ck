@@ -0,0 +1,8 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($data) = random_bytes (1000);
+check_archive ({"prealloc" => ["\0" x 10000 . $data . "\0" x 54536]});
+pass;
@@ -0,0 +1,57 @@
+/* Preallocates 64 kB for an empty file and checks that this
+   extends the file, reserves one contiguous run of sectors
+   without writing them, and that the reserved range reads as
+   zeros except where data is later written. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (64 * 1024)
+#define DATA_OFS 10000
+#define DATA_SIZE 1000
+
+static char expected[FILE_SIZE];
+static char buf[4096];
+
+void
+test_main (void)
+{
+  const char *file_name = "prealloc";
+  long long writes;
+  size_t ofs;
+  int fd;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+  reset_cache ();
+  writes = number_device_writes ();
+  CHECK (fallocate (fd, 0, FILE_SIZE), "fallocate \"%s\"", file_name);
+  reset_cache ();
+  writes = number_device_writes () - writes;
+  CHECK (writes < 16, "fallocate does not write the reserved sectors");
+  CHECK (filesize (fd) == FILE_SIZE, "filesize \"%s\" is %d",
+         file_name, FILE_SIZE);
+  CHECK (number_extents (fd) <= 2, "reserved sectors are contiguous");
+
+  msg ("read \"%s\"", file_name);
+  for (ofs = 0; ofs < FILE_SIZE; ofs += sizeof buf)
+    {
+      if (read (fd, buf, sizeof buf) != sizeof buf)
+        fail ("read of \"%s\" failed", file_name);
+      compare_bytes (buf, expected + ofs, sizeof buf, ofs, file_name);
+    }
+
+  random_bytes (expected + DATA_OFS, DATA_SIZE);
+  msg ("seek \"%s\"", file_name);
+  seek (fd, DATA_OFS);
+  CHECK (write (fd, expected + DATA_OFS, DATA_SIZE) == DATA_SIZE,
+         "write \"%s\"", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+
+  check_file (file_name, expected, FILE_SIZE);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fallocate) begin
+(fallocate) create "prealloc"
+(fallocate) open "prealloc"
+(fallocate) fallocate "prealloc"
+(fallocate) fallocate does not write the reserved sectors
+(fallocate) filesize "prealloc" is 65536
+(fallocate) reserved sectors are contiguous
+(fallocate) read "prealloc"
+(fallocate) seek "prealloc"
+(fallocate) write "prealloc"
+(fallocate) close "prealloc"
+(fallocate) open "prealloc" for verification
+(fallocate) verified contents of "prealloc"
+(fallocate) close "prealloc"
+(fallocate) end
+EOF
+pass;
@@ -0,0 +1,38 @@
+/* Checks that open() hands out the lowest free handle, reusing
+   handles of closed files, and that many files can be open at
+   once. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 100
+
+void
+test_main (void)
+{
+  int fds[FILE_CNT];
+  int i, fd;
+
+  CHECK (create ("data", 0), "create \"data\"");
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      fds[i] = open ("data");
+      if (fds[i] != i + 2)
+        fail ("open %d returned handle %d", i, fds[i]);
+    }
+  msg ("opened \"data\" %d times", FILE_CNT);
+
+  close (fds[50]);
+  close (fds[10]);
+  CHECK ((fd = open ("data")) == fds[10], "open reuses the lowest handle");
+  CHECK ((fd = open ("data")) == fds[50], "open reuses the next handle");
+  CHECK ((fd = open ("data")) == FILE_CNT + 2, "open then extends the table");
+  CHECK (write (fds[FILE_CNT - 1], "x", 1) == 1, "write to the last handle");
+  CHECK (filesize (fds[0]) == 1, "first handle sees the write");
+
+  for (i = 0; i < FILE_CNT; i++)
+    close (fds[i]);
+  close (fd);
+  msg ("closed all handles");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fd-reuse) begin
+(fd-reuse) create "data"
+(fd-reuse) opened "data" 100 times
+(fd-reuse) open reuses the lowest handle
+(fd-reuse) open reuses the next handle
+(fd-reuse) open then extends the table
+(fd-reuse) write to the last handle
+(fd-reuse) first handle sees the write
+(fd-reuse) closed all handles
+(fd-reuse) end
+EOF
+pass;
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($tree) = {"d" => {}};
+for my $i (1...23) {
+    $tree->{"d"}{"f$i"} = [chr (ord ('a') + $i % 26) x 600];
+}
+check_archive ($tree);
+pass;
@@ -0,0 +1,49 @@
+/* Creates files in a new directory, making each one durable with
+   fsync(), then removes one of them and syncs again.  The test runs
+   with "-crash", so the kernel shuts down without writing back the
+   buffer cache, and the persistence check sees only what the
+   journal recovers at the next boot.  Enough transactions are
+   committed to fill the log, so recovery also has to cope with a
+   log that was emptied and reused. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 24
+#define FILE_SIZE 600
+
+static char buf[FILE_SIZE];
+
+void
+test_main (void)
+{
+  char name[16];
+  int fd, i;
+
+  /* Shutdown will not write back the files loaded for the test,
+     so write them now. */
+  reset_cache ();
+
+  CHECK (mkdir ("d"), "mkdir \"d\"");
+  msg ("create, write and fsync %d files in \"d\"", FILE_CNT);
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "d/f%d", i);
+      memset (buf, 'a' + i % 26, sizeof buf);
+      if (!create (name, 0) || (fd = open (name)) < 2)
+        fail ("create \"%s\" failed", name);
+      if (write (fd, buf, sizeof buf) != sizeof buf)
+        fail ("write \"%s\" failed", name);
+      if (!fsync (fd))
+        fail ("fsync \"%s\" failed", name);
+      close (fd);
+    }
+
+  CHECK (remove ("d/f0"), "remove \"d/f0\"");
+  CHECK ((fd = open ("d/f1")) > 1, "open \"d/f1\"");
+  CHECK (fsync (fd), "fsync \"d/f1\"");
+  close (fd);
+}
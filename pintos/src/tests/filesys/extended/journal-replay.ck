@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(journal-replay) begin
+(journal-replay) mkdir "d"
+(journal-replay) create, write and fsync 24 files in "d"
+(journal-replay) remove "d/f0"
+(journal-replay) open "d/f1"
+(journal-replay) fsync "d/f1"
+(journal-replay) end
+EOF
+pass;
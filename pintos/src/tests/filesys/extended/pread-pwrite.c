@@ -0,0 +1,55 @@
+/* Writes a file out of order with pwrite(), reads parts of it back
+   with pread(), and checks that neither call moves the file
+   position that read() and write() use. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static const char *chunks[] = {"aaaaaaaaaa", "bbbbbbbbbb", "cccccccccc",
+                               "dddddddddd"};
+
+void
+test_main (void)
+{
+  char buf[64];
+  int fd, i;
+
+  CHECK (create ("data", 0), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+
+  msg ("pwrite chunks in reverse order");
+  for (i = 3; i >= 0; i--)
+    if (pwrite (fd, chunks[i], 10, i * 10) != 10)
+      fail ("pwrite at offset %d failed", i * 10);
+  CHECK (filesize (fd) == 40, "filesize is 40");
+  CHECK (tell (fd) == 0, "position is still 0");
+
+  memset (buf, 0, sizeof buf);
+  CHECK (pread (fd, buf, 15, 15) == 15, "pread 15 bytes at offset 15");
+  CHECK (!strcmp (buf, "bbbbbcccccccccc"), "pread returned the right bytes");
+  CHECK (pread (fd, buf, 20, 30) == 10, "pread past the end is short");
+  CHECK (pread (fd, buf, 10, 40) == 0, "pread at the end returns 0");
+  CHECK (tell (fd) == 0, "position is still 0");
+
+  memset (buf, 0, sizeof buf);
+  CHECK (read (fd, buf, 10) == 10 && !strcmp (buf, chunks[0]),
+         "read starts at offset 0");
+  CHECK (pwrite (fd, "e", 1, 40) == 1, "pwrite at the end");
+  CHECK (filesize (fd) == 41, "filesize is 41");
+  CHECK (tell (fd) == 10, "position is still 10");
+
+  CHECK (pread (fd, buf, 10, 0xffffff00) == -1,
+         "pread at an offset past INT_MAX fails");
+  CHECK (pwrite (fd, "x", 1, 0xffffff00) == -1,
+         "pwrite at an offset past INT_MAX fails");
+  CHECK (pread (fd, buf, 100, 0x7fffffc0) == -1,
+         "pread reaching past INT_MAX fails");
+  seek (fd, 0x7fffff80);
+  CHECK (write (fd, buf, 10) <= 0, "write near INT_MAX fails");
+  CHECK (filesize (fd) == 41, "filesize is still 41");
+
+  msg ("close \"data\"");
+  close (fd);
+}
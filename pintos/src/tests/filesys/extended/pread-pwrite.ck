@@ -0,0 +1,29 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(pread-pwrite) begin
+(pread-pwrite) create "data"
+(pread-pwrite) open "data"
+(pread-pwrite) pwrite chunks in reverse order
+(pread-pwrite) filesize is 40
+(pread-pwrite) position is still 0
+(pread-pwrite) pread 15 bytes at offset 15
+(pread-pwrite) pread returned the right bytes
+(pread-pwrite) pread past the end is short
+(pread-pwrite) pread at the end returns 0
+(pread-pwrite) position is still 0
+(pread-pwrite) read starts at offset 0
+(pread-pwrite) pwrite at the end
+(pread-pwrite) filesize is 41
+(pread-pwrite) position is still 10
+(pread-pwrite) pread at an offset past INT_MAX fails
+(pread-pwrite) pwrite at an offset past INT_MAX fails
+(pread-pwrite) pread reaching past INT_MAX fails
+(pread-pwrite) write near INT_MAX fails
+(pread-pwrite) filesize is still 41
+(pread-pwrite) close "data"
+(pread-pwrite) end
+EOF
+pass;
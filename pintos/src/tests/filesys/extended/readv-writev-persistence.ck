@@ -0,0 +1,8 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($body) = join ('', map (chr (ord ('a') + $_ % 26), 0..599));
+my ($record) = "HEAD" . $body . "end";
+check_archive ({"data" => [$record x 2]});
+pass;
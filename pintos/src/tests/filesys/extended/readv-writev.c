@@ -0,0 +1,58 @@
+/* Writes records made of several buffers with writev(), then reads
+   them back with readv() into buffers cut at different places, and
+   checks that both calls advance the file position by what they
+   moved. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char head[4] = "HEAD", body[600], tail[3] = "end";
+  char a[5], b[700], c[100];
+  struct iovec out[4], in[3];
+  int fd;
+  size_t i;
+
+  for (i = 0; i < sizeof body; i++)
+    body[i] = 'a' + i % 26;
+  out[0].iov_base = head;
+  out[0].iov_len = sizeof head;
+  out[1].iov_base = body;
+  out[1].iov_len = sizeof body;
+  out[2].iov_base = NULL;
+  out[2].iov_len = 0;
+  out[3].iov_base = tail;
+  out[3].iov_len = sizeof tail;
+
+  CHECK (create ("data", 0), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+  CHECK (writev (fd, out, 4) == 607, "writev 4 buffers");
+  CHECK (writev (fd, out, 4) == 607, "writev 4 buffers again");
+  CHECK (filesize (fd) == 1214, "filesize is 1214");
+  CHECK (tell (fd) == 1214, "position is 1214");
+
+  seek (fd, 0);
+  in[0].iov_base = a;
+  in[0].iov_len = sizeof a;
+  in[1].iov_base = b;
+  in[1].iov_len = sizeof b;
+  in[2].iov_base = c;
+  in[2].iov_len = sizeof c;
+  CHECK (readv (fd, in, 3) == 805, "readv 3 buffers");
+  CHECK (tell (fd) == 805, "position is 805");
+  if (memcmp (a, "HEADa", 5) || memcmp (b, body + 1, 599)
+      || memcmp (b + 599, "end", 3) || memcmp (b + 602, "HEAD", 4)
+      || memcmp (b + 606, body, 94) || memcmp (c, body + 94, 100))
+    fail ("readv returned the wrong bytes");
+  msg ("readv returned the right bytes");
+  CHECK (readv (fd, in, 3) == 409, "readv at the tail is short");
+  CHECK (readv (fd, in, 3) == 0, "readv at the end returns 0");
+  CHECK (writev (fd, out, 1000) == -1, "writev rejects too many buffers");
+
+  msg ("close \"data\"");
+  close (fd);
+}
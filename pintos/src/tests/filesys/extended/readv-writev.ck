@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(readv-writev) begin
+(readv-writev) create "data"
+(readv-writev) open "data"
+(readv-writev) writev 4 buffers
+(readv-writev) writev 4 buffers again
+(readv-writev) filesize is 1214
+(readv-writev) position is 1214
+(readv-writev) readv 3 buffers
+(readv-writev) position is 805
+(readv-writev) readv returned the right bytes
+(readv-writev) readv at the tail is short
+(readv-writev) readv at the end returns 0
+(readv-writev) writev rejects too many buffers
+(readv-writev) close "data"
+(readv-writev) end
+EOF
+pass;
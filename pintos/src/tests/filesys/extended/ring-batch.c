@@ -0,0 +1,94 @@
+/* Queues file system calls on a submission ring, runs them with
+   ring_enter(), and checks their completions, including that calls
+   which may not be queued fail, that a full completion queue stops
+   submission, and that calls run from the ring are counted in the
+   system call statistics. */
+
+#include <string.h>
+#include <syscall.h>
+#include <syscall-nr.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static struct ring ring;
+static struct syscall_stat stats[SYSCALL_STATS_MAX];
+
+/* Queues system call CALL_NR with arguments A0...A2, tagged with
+   USER_DATA. */
+static void
+queue (unsigned call_nr, int a0, int a1, int a2, unsigned user_data)
+{
+  struct ring_sqe *sqe = &ring.sq[ring.sq_tail % RING_SIZE];
+
+  sqe->call_nr = call_nr;
+  sqe->args[0] = a0;
+  sqe->args[1] = a1;
+  sqe->args[2] = a2;
+  sqe->args[3] = 0;
+  sqe->user_data = user_data;
+  ring.sq_tail++;
+}
+
+/* Reaps the next completion, which must carry USER_DATA, and
+   returns its result. */
+static int
+reap (unsigned user_data)
+{
+  struct ring_cqe *cqe;
+
+  if (ring.cq_head == ring.cq_tail)
+    fail ("no completion for %u", user_data);
+  cqe = &ring.cq[ring.cq_head++ % RING_SIZE];
+  if (cqe->user_data != user_data)
+    fail ("completion for %u, expected %u", cqe->user_data, user_data);
+  return cqe->result;
+}
+
+void
+test_main (void)
+{
+  char buf[32];
+  int fd, i;
+
+  CHECK (ring_enter (1) == -1, "ring_enter without a ring fails");
+  CHECK (ring_setup (&ring), "ring_setup");
+
+  queue (SYS_CREATE, (int) "data", 0, 0, 1);
+  queue (SYS_OPEN, (int) "data", 0, 0, 2);
+  CHECK (ring_enter (2) == 2, "submit create and open");
+  CHECK (reap (1) == 1, "create \"data\" completed");
+  CHECK ((fd = reap (2)) > 1, "open \"data\" completed");
+
+  memset (buf, 0, sizeof buf);
+  queue (SYS_WRITE, fd, (int) "ring", 4, 3);
+  queue (SYS_WRITE, fd, (int) "-batch", 6, 4);
+  queue (SYS_SEEK, fd, 0, 0, 5);
+  queue (SYS_READ, fd, (int) buf, sizeof buf, 6);
+  queue (SYS_EXEC, (int) "data", 0, 0, 7);
+  CHECK (ring_enter (5) == 5, "submit write, write, seek, read, exec");
+  CHECK (reap (3) == 4, "first write completed");
+  CHECK (reap (4) == 6, "second write completed");
+  reap (5);
+  CHECK (reap (6) == 10 && !strcmp (buf, "ring-batch"),
+         "read completed with the written bytes");
+  CHECK (reap (7) == -1, "exec may not be queued");
+
+  msg ("fill the completion queue");
+  for (i = 0; i <= RING_SIZE; i++)
+    queue (SYS_PRACTICE, i, 0, 0, 100 + i);
+  CHECK (ring_enter (RING_SIZE + 1) == RING_SIZE,
+         "submission stops when the completion queue is full");
+  for (i = 0; i < RING_SIZE; i++)
+    if (reap (100 + i) != i + 1)
+      fail ("practice %d returned the wrong value", i);
+  CHECK (ring_enter (1) == 1 && reap (100 + RING_SIZE) == RING_SIZE + 1,
+         "the last call runs once completions are reaped");
+  CHECK (syscall_stats (SYSCALL_STATS_SELF, stats, SYSCALL_STATS_MAX) > 0
+         && stats[SYS_PRACTICE].calls == RING_SIZE + 1,
+         "every queued practice call is counted");
+
+  queue (SYS_CLOSE, fd, 0, 0, 8);
+  CHECK (ring_enter (1) == 1, "submit close");
+  reap (8);
+  CHECK (ring_setup (NULL), "unregister the ring");
+}
@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(ring-batch) begin
+(ring-batch) ring_enter without a ring fails
+(ring-batch) ring_setup
+(ring-batch) submit create and open
+(ring-batch) create "data" completed
+(ring-batch) open "data" completed
+(ring-batch) submit write, write, seek, read, exec
+(ring-batch) first write completed
+(ring-batch) second write completed
+(ring-batch) read completed with the written bytes
+(ring-batch) exec may not be queued
+(ring-batch) fill the completion queue
+(ring-batch) submission stops when the completion queue is full
+(ring-batch) the last call runs once completions are reaped
+(ring-batch) every queued practice call is counted
+(ring-batch) submit close
+(ring-batch) unregister the ring
+(ring-batch) end
+EOF
+pass;
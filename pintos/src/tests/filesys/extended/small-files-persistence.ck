@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my (%files);
+for my $i (0...19) {
+    $files{"small$i"} = [random_bytes (100 + $i)];
+}
+check_archive (\%files);
+pass;
@@ -0,0 +1,55 @@
+/* Creates many files of a few hundred bytes each, then reads them
+   all back from a cold cache and checks that each costs about two
+   device reads, not three: small files keep their data inline, in
+   the same sector as their length. */
+
+#include <random.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 20
+#define FILE_SIZE(I) (100 + (I))
+
+static char data[FILE_CNT][FILE_SIZE (FILE_CNT)];
+static char buf[512];
+
+void
+test_main (void)
+{
+  char file_name[16];
+  long long reads;
+  int fd, i;
+
+  random_init (0);
+  msg ("create %d small files", FILE_CNT);
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (file_name, sizeof file_name, "small%d", i);
+      random_bytes (data[i], FILE_SIZE (i));
+      if (!create (file_name, 0))
+        fail ("create \"%s\" failed", file_name);
+      if ((fd = open (file_name)) < 2)
+        fail ("open \"%s\" failed", file_name);
+      if (write (fd, data[i], FILE_SIZE (i)) != FILE_SIZE (i))
+        fail ("write \"%s\" failed", file_name);
+      close (fd);
+    }
+
+  reset_cache ();
+  reads = number_device_reads ();
+  msg ("read %d small files", FILE_CNT);
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (file_name, sizeof file_name, "small%d", i);
+      if ((fd = open (file_name)) < 2)
+        fail ("open \"%s\" failed", file_name);
+      if (read (fd, buf, sizeof buf) != FILE_SIZE (i))
+        fail ("read \"%s\" returned wrong size", file_name);
+      compare_bytes (buf, data[i], FILE_SIZE (i), 0, file_name);
+      close (fd);
+    }
+  reads = number_device_reads () - reads;
+  CHECK (reads <= 2 * FILE_CNT + 8, "about two device reads per file");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(small-files) begin
+(small-files) create 20 small files
+(small-files) read 20 small files
+(small-files) about two device reads per file
+(small-files) end
+EOF
+pass;
@@ -0,0 +1,70 @@
+/* Writes one sector 8 MB past the start of an empty file, which
+   is far larger than the file system itself, and checks that the
+   hole in between costs no disk space or device I/O: the write
+   and a read back through the hole must each touch only a handful
+   of sectors, no matter how long the file is. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define HOLE_SIZE (8 * 1024 * 1024)
+
+static char buf[512];
+static char hole[4096];
+
+void
+test_main (void)
+{
+  const char *file_name = "sparse";
+  long long writes, reads;
+  size_t ofs;
+  int fd;
+
+  random_bytes (buf, sizeof buf);
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+  /* Write the tail and flush it, counting device writes. */
+  reset_cache ();
+  writes = number_device_writes ();
+  msg ("seek \"%s\"", file_name);
+  seek (fd, HOLE_SIZE);
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf, "write \"%s\"", file_name);
+  reset_cache ();
+  writes = number_device_writes () - writes;
+  CHECK (writes < 16, "few device writes for a one-sector write");
+  CHECK (filesize (fd) == HOLE_SIZE + (int) sizeof buf,
+         "filesize \"%s\" covers the hole", file_name);
+
+  /* Read 64 kB from the middle of the hole, counting device reads. */
+  reads = number_device_reads ();
+  msg ("read hole in \"%s\"", file_name);
+  seek (fd, HOLE_SIZE / 2);
+  for (ofs = 0; ofs < 64 * 1024; ofs += sizeof hole)
+    {
+      size_t i;
+
+      if (read (fd, hole, sizeof hole) != sizeof hole)
+        fail ("read of hole in \"%s\" failed", file_name);
+      for (i = 0; i < sizeof hole; i++)
+        if (hole[i] != 0)
+          fail ("byte %zu of hole is %02hhx, not zero",
+                HOLE_SIZE / 2 + ofs + i, hole[i]);
+    }
+  reads = number_device_reads () - reads;
+  CHECK (reads < 8, "few device reads for a 64 kB hole");
+
+  /* The data after the hole must have survived the flushes. */
+  msg ("read tail of \"%s\"", file_name);
+  seek (fd, HOLE_SIZE);
+  if (read (fd, hole, sizeof buf) != sizeof buf)
+    fail ("read of tail of \"%s\" failed", file_name);
+  compare_bytes (hole, buf, sizeof buf, HOLE_SIZE, file_name);
+
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  CHECK (remove (file_name), "remove \"%s\"", file_name);
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sparse-holes) begin
+(sparse-holes) create "sparse"
+(sparse-holes) open "sparse"
+(sparse-holes) seek "sparse"
+(sparse-holes) write "sparse"
+(sparse-holes) few device writes for a one-sector write
+(sparse-holes) filesize "sparse" covers the hole
+(sparse-holes) read hole in "sparse"
+(sparse-holes) few device reads for a 64 kB hole
+(sparse-holes) read tail of "sparse"
+(sparse-holes) close "sparse"
+(sparse-holes) remove "sparse"
+(sparse-holes) end
+EOF
+pass;
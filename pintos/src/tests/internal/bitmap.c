@@ -0,0 +1,154 @@
+/* Test program and microbenchmark for lib/kernel/bitmap.c.
+
+   Checks bitmap_scan(), bitmap_count() and bitmap_contains()
+   against a bit-at-a-time reference on randomly fragmented
+   bitmaps, then reports how many cycles a scan for a run of
+   free bits takes with each, at several fill levels.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <bitmap.h>
+#include <debug.h>
+#include <random.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Bits in each test bitmap, the size of the free map for a
+   32 MB disk. */
+#define BIT_CNT 65536
+
+/* Scans timed at each fill level. */
+#define SCAN_CNT 64
+
+static void fragment (struct bitmap *, int percent_full);
+static size_t ref_scan (const struct bitmap *, size_t start, size_t cnt,
+                        bool value);
+static size_t ref_count (const struct bitmap *, size_t start, size_t cnt,
+                         bool value);
+static void verify (const struct bitmap *);
+static uint64_t rdtsc (void);
+
+/* Test and time the bitmap scanning implementation. */
+void
+test (void)
+{
+  static const int fill_levels[] = {10, 50, 90, 99};
+  struct bitmap *b = bitmap_create (BIT_CNT);
+  size_t i;
+
+  ASSERT (b != NULL);
+
+  printf ("testing fragmented bitmaps:");
+  for (i = 0; i < sizeof fill_levels / sizeof *fill_levels; i++)
+    {
+      printf (" %d%%", fill_levels[i]);
+      fragment (b, fill_levels[i]);
+      verify (b);
+    }
+  printf (" done\n");
+
+  for (i = 0; i < sizeof fill_levels / sizeof *fill_levels; i++)
+    {
+      uint64_t fast = 0, slow = 0;
+      int j;
+
+      fragment (b, fill_levels[i]);
+      for (j = 0; j < SCAN_CNT; j++)
+        {
+          size_t cnt = 1 << (j % 6);
+          uint64_t t0, t1, t2;
+          size_t fast_idx, slow_idx;
+
+          t0 = rdtsc ();
+          fast_idx = bitmap_scan (b, 0, cnt, false);
+          t1 = rdtsc ();
+          slow_idx = ref_scan (b, 0, cnt, false);
+          t2 = rdtsc ();
+          ASSERT (fast_idx == slow_idx);
+          fast += t1 - t0;
+          slow += t2 - t1;
+        }
+      printf ("%d%% full: %llu cycles/scan, bit-at-a-time %llu\n",
+              fill_levels[i], fast / SCAN_CNT, slow / SCAN_CNT);
+    }
+
+  bitmap_destroy (b);
+  printf ("bitmap: PASS\n");
+}
+
+/* Fills the front of B solidly and the rest at random, so that
+   about PERCENT_FULL percent of its bits end up set.  That is
+   the shape the free map takes on a well-used disk. */
+static void
+fragment (struct bitmap *b, int percent_full)
+{
+  size_t solid = bitmap_size (b) * percent_full / 200;
+  size_t i;
+
+  bitmap_set_all (b, false);
+  bitmap_set_multiple (b, 0, solid, true);
+  for (i = solid; i < bitmap_size (b); i++)
+    if ((int) (random_ulong () % 100) < percent_full / 2)
+      bitmap_mark (b, i);
+}
+
+/* Compares B's word-at-a-time operations against the reference
+   on a selection of ranges. */
+static void
+verify (const struct bitmap *b)
+{
+  int i;
+
+  for (i = 0; i < 256; i++)
+    {
+      size_t start = random_ulong () % BIT_CNT;
+      size_t cnt = random_ulong () % (BIT_CNT - start);
+      bool value = random_ulong () % 2;
+      size_t run = random_ulong () % 24;
+
+      ASSERT (bitmap_count (b, start, cnt, value)
+              == ref_count (b, start, cnt, value));
+      ASSERT (bitmap_contains (b, start, cnt % 70, value)
+              == (ref_count (b, start, cnt % 70, value) != 0));
+      ASSERT (bitmap_scan (b, start, run, value)
+              == ref_scan (b, start, run, value));
+    }
+}
+
+/* Bit-at-a-time equivalent of bitmap_scan(). */
+static size_t
+ref_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t i;
+
+  if (cnt > bitmap_size (b))
+    return BITMAP_ERROR;
+  for (i = start; i + cnt <= bitmap_size (b); i++)
+    if (ref_count (b, i, cnt, value) == cnt)
+      return i;
+  return BITMAP_ERROR;
+}
+
+/* Bit-at-a-time equivalent of bitmap_count(). */
+static size_t
+ref_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t i, value_cnt = 0;
+
+  for (i = 0; i < cnt; i++)
+    if (bitmap_test (b, start + i) == value)
+      value_cnt++;
+  return value_cnt;
+}
+
+/* Returns the processor's time-stamp counter. */
+static uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
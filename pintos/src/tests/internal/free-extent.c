@@ -0,0 +1,203 @@
+/* Test program for filesys/free-extent.c.
+
+   Keeps a bitmap of free sectors alongside the extent index,
+   adds and removes random runs in both, and after each change
+   checks free_extent_next_fit(), free_extent_best_fit() and
+   free_extent_largest() against answers worked out from the
+   bitmap.  A few fixed cases first check that an added run
+   merges with the extents on either side of it.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <bitmap.h>
+#include <debug.h>
+#include <random.h>
+#include <stdio.h>
+#include "filesys/free-extent.h"
+#include "threads/test.h"
+
+/* Sectors on the pretend device. */
+#define SECTOR_CNT 4096
+
+/* Random changes to make. */
+#define CHANGE_CNT 4096
+
+static void mark_free (struct bitmap *, block_sector_t start, size_t cnt);
+static void mark_used (struct bitmap *, block_sector_t start, size_t cnt);
+static void verify (const struct bitmap *);
+static size_t run_end (const struct bitmap *, size_t start, bool value);
+static block_sector_t ref_best_fit (const struct bitmap *, size_t cnt);
+static size_t ref_largest (const struct bitmap *);
+
+/* Test the free extent index. */
+void
+test (void)
+{
+  struct bitmap *map = bitmap_create (SECTOR_CNT);
+  int i;
+
+  ASSERT (map != NULL);
+  free_extent_clear ();
+
+  /* Runs added next to each other become one extent, whichever
+     side the new run is on. */
+  mark_free (map, 100, 10);
+  mark_free (map, 120, 10);
+  ASSERT (free_extent_largest () == 10);
+  mark_free (map, 110, 10);
+  ASSERT (free_extent_largest () == 30);
+  ASSERT (free_extent_best_fit (30) == 100);
+  ASSERT (free_extent_next_fit (0, 30) == 100);
+  mark_free (map, 90, 10);
+  mark_free (map, 130, 5);
+  ASSERT (free_extent_largest () == 45);
+  ASSERT (free_extent_best_fit (45) == 90);
+  ASSERT (free_extent_best_fit (46) == FREE_EXTENT_NONE);
+
+  /* Taking from the middle splits it again. */
+  mark_used (map, 110, 5);
+  ASSERT (free_extent_largest () == 20);
+  ASSERT (free_extent_best_fit (20) == 90);
+  ASSERT (free_extent_best_fit (21) == FREE_EXTENT_NONE);
+  ASSERT (free_extent_next_fit (100, 15) == 115);
+  verify (map);
+  mark_used (map, 90, 20);
+  mark_used (map, 115, 20);
+  ASSERT (free_extent_largest () == 0);
+  verify (map);
+
+  /* Random changes. */
+  printf ("testing random changes:");
+  for (i = 0; i < CHANGE_CNT; i++)
+    {
+      block_sector_t start = random_ulong () % SECTOR_CNT;
+      bool is_free = bitmap_test (map, start);
+      size_t room = run_end (map, start, is_free) - start;
+      size_t cnt = random_ulong () % (room < 64 ? room : 64) + 1;
+
+      if (is_free)
+        mark_used (map, start, cnt);
+      else
+        mark_free (map, start, cnt);
+      if (i % 64 == 0)
+        verify (map);
+      if (i % (CHANGE_CNT / 8) == 0)
+        printf (" %zu", bitmap_count (map, 0, SECTOR_CNT, true));
+    }
+  verify (map);
+  printf (" done\n");
+
+  free_extent_clear ();
+  ASSERT (free_extent_largest () == 0);
+  bitmap_destroy (map);
+  printf ("free-extent: PASS\n");
+}
+
+/* Marks the CNT sectors starting at START free in both MAP and
+   the index. */
+static void
+mark_free (struct bitmap *map, block_sector_t start, size_t cnt)
+{
+  bool ok;
+
+  ASSERT (bitmap_none (map, start, cnt));
+  ok = free_extent_add (start, cnt);
+  ASSERT (ok);
+  bitmap_set_multiple (map, start, cnt, true);
+}
+
+/* Marks the CNT sectors starting at START in use in both MAP
+   and the index. */
+static void
+mark_used (struct bitmap *map, block_sector_t start, size_t cnt)
+{
+  bool ok;
+
+  ASSERT (bitmap_all (map, start, cnt));
+  ok = free_extent_remove (start, cnt);
+  ASSERT (ok);
+  bitmap_set_multiple (map, start, cnt, false);
+}
+
+/* Checks the index's searches against MAP for a selection of
+   sizes and starting sectors. */
+static void
+verify (const struct bitmap *map)
+{
+  size_t cnt;
+  int i;
+
+  ASSERT (free_extent_largest () == ref_largest (map));
+  for (cnt = 1; cnt <= 80; cnt++)
+    ASSERT (free_extent_best_fit (cnt) == ref_best_fit (map, cnt));
+  for (i = 0; i < 256; i++)
+    {
+      block_sector_t start = random_ulong () % SECTOR_CNT;
+      size_t fit;
+
+      cnt = random_ulong () % 80 + 1;
+      fit = bitmap_scan (map, start, cnt, true);
+      ASSERT (free_extent_next_fit (start, cnt)
+              == (fit != BITMAP_ERROR ? fit : FREE_EXTENT_NONE));
+    }
+}
+
+/* Returns the first sector at or after START whose bit in B is
+   not VALUE, or the size of B if there is none. */
+static size_t
+run_end (const struct bitmap *b, size_t start, bool value)
+{
+  while (start < bitmap_size (b) && bitmap_test (b, start) == value)
+    start++;
+  return start;
+}
+
+/* Returns the start of the smallest run of free sectors in MAP
+   with at least CNT sectors, the lowest-numbered one if several
+   tie, or FREE_EXTENT_NONE if there is none. */
+static block_sector_t
+ref_best_fit (const struct bitmap *map, size_t cnt)
+{
+  block_sector_t best = FREE_EXTENT_NONE;
+  size_t best_cnt = 0;
+  size_t start = 0;
+
+  while (start < bitmap_size (map))
+    if (bitmap_test (map, start))
+      {
+        size_t end = run_end (map, start, true);
+        if (end - start >= cnt && (best_cnt == 0 || end - start < best_cnt))
+          {
+            best = start;
+            best_cnt = end - start;
+          }
+        start = end;
+      }
+    else
+      start++;
+  return best;
+}
+
+/* Returns the number of sectors in the longest run of free
+   sectors in MAP. */
+static size_t
+ref_largest (const struct bitmap *map)
+{
+  size_t largest = 0;
+  size_t start = 0;
+
+  while (start < bitmap_size (map))
+    if (bitmap_test (map, start))
+      {
+        size_t end = run_end (map, start, true);
+        if (end - start > largest)
+          largest = end - start;
+        start = end;
+      }
+    else
+      start++;
+  return largest;
+}
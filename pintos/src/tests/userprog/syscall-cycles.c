@@ -0,0 +1,70 @@
+/* Checks that system calls work when entered with SYSENTER as
+   well as with int $0x30, and reports the round-trip cost of a
+   null system call, practice(), on each path. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Calls per timing. */
+#define CALLS 10000
+
+/* Returns the processor's time-stamp counter. */
+static long long
+rdtsc (void)
+{
+  long long tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Returns the average cycles of a practice() call. */
+static long long
+time_practice (void)
+{
+  long long tsc;
+  int i, sum = 0;
+
+  for (i = 0; i < 100; i++)
+    practice (i);
+  tsc = rdtsc ();
+  for (i = 0; i < CALLS; i++)
+    sum += practice (i) - i;
+  tsc = rdtsc () - tsc;
+  if (sum != CALLS)
+    fail ("practice returned wrong values");
+  return tsc / CALLS;
+}
+
+/* Checks calls with several arguments on the current path. */
+static void
+check_calls (const char *path)
+{
+  int fd;
+
+  CHECK (practice (5) == 6, "practice through %s", path);
+  CHECK (create ("quux", 512), "create \"quux\" through %s", path);
+  CHECK ((fd = open ("quux")) > 1, "open \"quux\" through %s", path);
+  CHECK (filesize (fd) == 512, "filesize through %s", path);
+  close (fd);
+  CHECK (remove ("quux"), "remove \"quux\" through %s", path);
+}
+
+void
+test_main (void)
+{
+  long long int_cycles;
+
+  check_calls ("int $0x30");
+  int_cycles = time_practice ();
+  msg ("int $0x30: %lld cycles per call", int_cycles);
+
+  if (!syscall_use_sysenter (true))
+    {
+      msg ("SYSENTER not supported");
+      return;
+    }
+  check_calls ("sysenter");
+  msg ("sysenter: %lld cycles per call", time_practice ());
+  syscall_use_sysenter (false);
+}
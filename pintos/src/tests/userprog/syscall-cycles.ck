@@ -0,0 +1,39 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# Cycle counts differ from run to run, so check their form only.
+fail "missing int \$0x30 timing\n"
+  unless grep (/^\(syscall-cycles\) int \$0x30: \d+ cycles per call$/,
+               @output);
+@output = grep (!/^\(syscall-cycles\) .*: \d+ cycles per call$/, @output);
+
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF', <<'EOF']);
+(syscall-cycles) begin
+(syscall-cycles) practice through int $0x30
+(syscall-cycles) create "quux" through int $0x30
+(syscall-cycles) open "quux" through int $0x30
+(syscall-cycles) filesize through int $0x30
+(syscall-cycles) remove "quux" through int $0x30
+(syscall-cycles) practice through sysenter
+(syscall-cycles) create "quux" through sysenter
+(syscall-cycles) open "quux" through sysenter
+(syscall-cycles) filesize through sysenter
+(syscall-cycles) remove "quux" through sysenter
+(syscall-cycles) end
+EOF
+(syscall-cycles) begin
+(syscall-cycles) practice through int $0x30
+(syscall-cycles) create "quux" through int $0x30
+(syscall-cycles) open "quux" through int $0x30
+(syscall-cycles) filesize through int $0x30
+(syscall-cycles) remove "quux" through int $0x30
+(syscall-cycles) SYSENTER not supported
+(syscall-cycles) end
+EOF
+pass;
@@ -0,0 +1,48 @@
+/* Makes a known number of practice() calls and checks that the
+   process's and the system's system call accounting count them. */
+
+#include <string.h>
+#include <syscall.h>
+#include <syscall-nr.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Number of practice() calls to make. */
+#define CALLS 100
+
+static struct syscall_stat self[SYSCALL_STATS_MAX];
+static struct syscall_stat all[SYSCALL_STATS_MAX];
+
+void
+test_main (void)
+{
+  const struct syscall_stat *st = &self[SYS_PRACTICE];
+  unsigned hist_total = 0;
+  int i, cnt;
+
+  for (i = 0; i < CALLS; i++)
+    practice (i);
+
+  cnt = syscall_stats (SYSCALL_STATS_SELF, self, SYSCALL_STATS_MAX);
+  CHECK (cnt > SYS_SYSCALL_STATS && cnt <= SYSCALL_STATS_MAX,
+         "syscall_stats reports every system call");
+  CHECK (!strcmp (st->name, "practice"), "entry is named \"practice\"");
+  CHECK (st->calls == CALLS, "process made %d practice calls", CALLS);
+  CHECK (st->cycles > 0, "practice calls took some cycles");
+  for (i = 0; i < SYSCALL_HIST_CNT; i++)
+    hist_total += st->hist[i];
+  CHECK (hist_total == CALLS, "histogram counts every call");
+  CHECK (self[SYS_SYSCALL_STATS].calls == 0,
+         "syscall_stats is counted after it returns");
+
+  CHECK (syscall_stats (SYSCALL_STATS_ALL, all, SYSCALL_STATS_MAX) == cnt,
+         "system-wide syscall_stats");
+  CHECK (all[SYS_PRACTICE].calls >= CALLS
+         && all[SYS_PRACTICE].cycles >= st->cycles,
+         "system counts at least the process's calls");
+  CHECK (syscall_stats (SYSCALL_STATS_SELF, self, SYSCALL_STATS_MAX) == cnt
+         && self[SYS_SYSCALL_STATS].calls == 1,
+         "process made 1 syscall_stats call");
+  CHECK (syscall_stats (-1, self, SYSCALL_STATS_MAX) == -1,
+         "unknown scope fails");
+}
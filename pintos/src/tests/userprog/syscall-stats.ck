@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(syscall-stats) begin
+(syscall-stats) syscall_stats reports every system call
+(syscall-stats) entry is named "practice"
+(syscall-stats) process made 100 practice calls
+(syscall-stats) practice calls took some cycles
+(syscall-stats) histogram counts every call
+(syscall-stats) syscall_stats is counted after it returns
+(syscall-stats) system-wide syscall_stats
+(syscall-stats) system counts at least the process's calls
+(syscall-stats) process made 1 syscall_stats call
+(syscall-stats) unknown scope fails
+(syscall-stats) end
+syscall-stats: exit(0)
+EOF
+pass;
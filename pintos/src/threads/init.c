@@ -28,6 +28,7 @@
 #include "userprog/gdt.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
+#include "userprog/aio.h"
 #else
 #include "tests/threads/tests.h"
 #endif
@@ -35,7 +36,9 @@
 #include "devices/block.h"
 #include "devices/ide.h"
 #include "filesys/filesys.h"
+#include "filesys/free-map.h"
 #include "filesys/fsutil.h"
+#include "filesys/inode.h"
 #endif
 
 /* Page directory with kernel mappings only. */
@@ -127,6 +130,11 @@ main (void)
   filesys_init (format_filesys);
 #endif
 
+#ifdef USERPROG
+  /* Start the asynchronous file I/O workers. */
+  aio_init ();
+#endif
+
   printf ("Boot complete.\n");
   
   /* Run actions specified on kernel command line. */
@@ -247,6 +255,12 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-bgfree"))
+        inode_background_reclaim = true;
+      else if (!strcmp (name, "-fmdefer"))
+        free_map_defer = true;
+      else if (!strcmp (name, "-crash"))
+        filesys_crash = true;
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
@@ -373,6 +387,9 @@ usage (void)
           "  -f                 Format file system device during startup.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -bgfree            Free large deleted files in the background.\n"
+          "  -fmdefer           Defer free map writes if there is no journal.\n"
+          "  -crash             Lose unwritten file system data at shutdown.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif
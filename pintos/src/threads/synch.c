@@ -336,3 +336,84 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   while (!list_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Initializes RWLOCK.  Any number of threads may hold a
+   readers-writer lock for reading at once, but a thread holding
+   it for writing excludes every other holder.  Once a writer is
+   waiting, new readers wait behind it, so a steady stream of
+   readers cannot starve writers. */
+void
+rwlock_init (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  lock_init (&rwlock->lock);
+  cond_init (&rwlock->readers);
+  cond_init (&rwlock->writers);
+  rwlock->reader_cnt = 0;
+  rwlock->writer_waiting_cnt = 0;
+  rwlock->writing = false;
+}
+
+/* Acquires RWLOCK for reading, sleeping until no thread is
+   writing or waiting to write. */
+void
+rwlock_acquire_read (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rwlock->lock);
+  while (rwlock->writing || rwlock->writer_waiting_cnt > 0)
+    cond_wait (&rwlock->readers, &rwlock->lock);
+  rwlock->reader_cnt++;
+  lock_release (&rwlock->lock);
+}
+
+/* Releases RWLOCK, which the current thread holds for reading. */
+void
+rwlock_release_read (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  lock_acquire (&rwlock->lock);
+  ASSERT (rwlock->reader_cnt > 0);
+  if (--rwlock->reader_cnt == 0)
+    cond_signal (&rwlock->writers, &rwlock->lock);
+  lock_release (&rwlock->lock);
+}
+
+/* Acquires RWLOCK for writing, sleeping until no other thread
+   holds it. */
+void
+rwlock_acquire_write (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rwlock->lock);
+  rwlock->writer_waiting_cnt++;
+  while (rwlock->writing || rwlock->reader_cnt > 0)
+    cond_wait (&rwlock->writers, &rwlock->lock);
+  rwlock->writer_waiting_cnt--;
+  rwlock->writing = true;
+  lock_release (&rwlock->lock);
+}
+
+/* Releases RWLOCK, which the current thread holds for writing.
+   Waiting writers go first; readers are let in once there are
+   none. */
+void
+rwlock_release_write (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  lock_acquire (&rwlock->lock);
+  ASSERT (rwlock->writing);
+  rwlock->writing = false;
+  if (rwlock->writer_waiting_cnt > 0)
+    cond_signal (&rwlock->writers, &rwlock->lock);
+  else
+    cond_broadcast (&rwlock->readers, &rwlock->lock);
+  lock_release (&rwlock->lock);
+}
@@ -41,6 +41,23 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Readers-writer lock. */
+struct rwlock
+  {
+    struct lock lock;           /* Guards the members below. */
+    struct condition readers;   /* Signaled when readers may enter. */
+    struct condition writers;   /* Signaled when a writer may enter. */
+    int reader_cnt;             /* Number of threads reading. */
+    int writer_waiting_cnt;     /* Number of threads waiting to write. */
+    bool writing;               /* True while a thread is writing. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
@@ -466,8 +466,13 @@ init_thread (struct thread *t, const char *name, int priority)
   t->priority = priority;
   list_init (&t->children);
   t->wait_status = NULL;
-  list_init (&t->fds);
-  t->next_handle = 2;
+  t->fds = NULL;
+  t->fd_cap = 0;
+  t->fd_free = 2;
+  t->ring = NULL;
+  t->call_stats = NULL;
+  list_init (&t->aio_requests);
+  t->aio_next_id = 1;
   t->magic = THREAD_MAGIC;
 
   old_level = intr_disable ();
@@ -108,8 +108,20 @@ struct thread
     struct file *bin_file;              /* Executable. */
 
     /* Owned by syscall.c. */
-    struct list fds;                    /* List of file descriptors. */
-    int next_handle;                    /* Next handle value. */
+    struct file_descriptor *fds;        /* File descriptors, by handle. */
+    int fd_cap;                         /* Number of slots in fds. */
+    int fd_free;                        /* No free handle lies below. */
+    struct ring *ring;                  /* Submission ring, user address. */
+    struct call_stats *call_stats;      /* Per-syscall accounting. */
+
+    /* Owned by userprog/aio.c. */
+    struct list aio_requests;           /* Asynchronous I/O requests. */
+    int aio_next_id;                    /* Id for the next request. */
+
+    /* Owned by filesys/journal.c. */
+    int journal_depth;                  /* Nesting of journal_begin(). */
+    int journal_credits;                /* Transaction sectors set aside
+                                           and not yet used. */
 
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
@@ -0,0 +1,130 @@
+#include "userprog/aio.h"
+#include <debug.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+
+/* Number of worker threads. */
+#define AIO_WORKERS 4
+
+/* Requests waiting for a worker, oldest first. */
+static struct list aio_queue;
+static struct lock aio_lock;            /* Protects aio_queue. */
+static struct condition aio_queued;     /* Signaled when one is added. */
+
+static thread_func aio_worker NO_RETURN;
+
+/* Initializes the queue and starts the worker threads. */
+void
+aio_init (void)
+{
+  int i;
+
+  list_init (&aio_queue);
+  lock_init (&aio_lock);
+  cond_init (&aio_queued);
+  for (i = 0; i < AIO_WORKERS; i++)
+    thread_create ("aio", PRI_DEFAULT, aio_worker, NULL);
+}
+
+/* Queues R, whose FILE, BUFFER, UDST, SIZE, OFFSET and WRITE the
+   caller has filled in, for a worker and makes it a request of
+   the current process.  R's FILE and BUFFER then belong to the
+   request, and are closed and freed by aio_release().  Returns
+   R's id. */
+int
+aio_submit (struct aio_request *r)
+{
+  struct thread *cur = thread_current ();
+
+  r->id = cur->aio_next_id++;
+  r->result = -1;
+  r->done = false;
+  sema_init (&r->done_sema, 0);
+  list_push_back (&cur->aio_requests, &r->proc_elem);
+
+  lock_acquire (&aio_lock);
+  list_push_back (&aio_queue, &r->queue_elem);
+  cond_signal (&aio_queued, &aio_lock);
+  lock_release (&aio_lock);
+  return r->id;
+}
+
+/* Returns the current process's request with the given ID, or a
+   null pointer if it has none. */
+struct aio_request *
+aio_find (int id)
+{
+  struct thread *cur = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&cur->aio_requests); e != list_end (&cur->aio_requests);
+       e = list_next (e))
+    {
+      struct aio_request *r = list_entry (e, struct aio_request, proc_elem);
+      if (r->id == id)
+        return r;
+    }
+  return NULL;
+}
+
+/* Waits for R's transfer to finish.  Always downs R's semaphore,
+   even if R is already done, so that R is not released while its
+   worker is still upping it. */
+void
+aio_wait (struct aio_request *r)
+{
+  sema_down (&r->done_sema);
+}
+
+/* Removes R, which aio_wait() must have been called for, from its
+   process and frees it. */
+void
+aio_release (struct aio_request *r)
+{
+  ASSERT (r->done);
+
+  list_remove (&r->proc_elem);
+  file_close (r->file);
+  free (r->buffer);
+  free (r);
+}
+
+/* Waits for and releases all the current process's requests. */
+void
+aio_exit (void)
+{
+  struct thread *cur = thread_current ();
+
+  while (!list_empty (&cur->aio_requests))
+    {
+      struct aio_request *r = list_entry (list_front (&cur->aio_requests),
+                                          struct aio_request, proc_elem);
+      aio_wait (r);
+      aio_release (r);
+    }
+}
+
+/* Worker thread: carries out queued requests, oldest first. */
+static void
+aio_worker (void *aux UNUSED)
+{
+  for (;;)
+    {
+      struct aio_request *r;
+
+      lock_acquire (&aio_lock);
+      while (list_empty (&aio_queue))
+        cond_wait (&aio_queued, &aio_lock);
+      r = list_entry (list_pop_front (&aio_queue), struct aio_request,
+                      queue_elem);
+      lock_release (&aio_lock);
+
+      if (r->write)
+        r->result = file_write_at (r->file, r->buffer, r->size, r->offset);
+      else
+        r->result = file_read_at (r->file, r->buffer, r->size, r->offset);
+      r->done = true;
+      sema_up (&r->done_sema);
+    }
+}
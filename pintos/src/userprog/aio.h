@@ -0,0 +1,46 @@
+#ifndef USERPROG_AIO_H
+#define USERPROG_AIO_H
+
+#include <list.h>
+#include <stdbool.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+
+/* Largest read or write one asynchronous request may make. */
+#define AIO_MAX_SIZE (16 * 1024)
+
+/* Most requests a process may have outstanding, each holding up to
+   AIO_MAX_SIZE bytes of kernel heap. */
+#define AIO_MAX_REQUESTS 16
+
+/* An asynchronous read or write, carried out by a worker thread.
+   Workers cannot reach the submitting process's memory, so data
+   passes through BUFFER, a kernel copy: a write's data is copied
+   in when it is submitted and a read's data is copied out to UDST
+   when the process waits for it. */
+struct aio_request
+  {
+    struct list_elem queue_elem;        /* In the workers' queue. */
+    struct list_elem proc_elem;         /* In owner's aio_requests. */
+    int id;                             /* Request id, unique in owner. */
+    bool write;                         /* Write rather than read? */
+    struct file *file;                  /* Private handle on the file. */
+    void *buffer;                       /* Kernel copy of the data. */
+    void *udst;                         /* Read's user destination. */
+    off_t size;                         /* Bytes to transfer. */
+    off_t offset;                       /* File offset to start at. */
+
+    /* Set by the worker. */
+    int result;                         /* Bytes transferred, or -1. */
+    bool done;                          /* Transfer finished? */
+    struct semaphore done_sema;         /* Upped when done. */
+  };
+
+void aio_init (void);
+int aio_submit (struct aio_request *);
+struct aio_request *aio_find (int id);
+void aio_wait (struct aio_request *);
+void aio_release (struct aio_request *);
+void aio_exit (void);
+
+#endif /* userprog/aio.h */
@@ -1,15 +1,25 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
 #include <string.h>
+#include <dirent.h>
+#include <limits.h>
+#include <ring.h>
+#include <syscall-stats.h>
+#include <uio.h>
 #include <syscall-nr.h>
 #include "userprog/process.h"
+#include "userprog/aio.h"
 #include "userprog/pagedir.h"
 #include "devices/input.h"
 #include "devices/shutdown.h"
 #include "filesys/directory.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
+#include "filesys/inode.h"
+#include "filesys/free-map.h"
 #include "filesys/cache.h"
+#include "filesys/dcache.h"
+#include "filesys/journal.h"
 #include "threads/interrupt.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
@@ -36,14 +46,39 @@ static bool sys_mkdir (const char *dir);
 static bool sys_readdir (int handle, const char *ufile);
 static bool sys_isdir (int handle);
 static int sys_inumber (int handle);
+static int sys_getdents (int handle, struct dirent *udst, unsigned cnt);
  
 static void syscall_handler (struct intr_frame *);
 static void copy_in (void *, const void *, size_t);
+static void copy_out (void *, const void *, size_t);
+static void string_slab_init (void);
 static void sys_reset_cache (void);
 static int sys_num_cache_hits (void);
 static int sys_num_cache_accesses (void);
 static long long sys_num_device_reads (void);
 static long long sys_num_device_writes (void);
+static long long sys_num_seek_distance (void);
+static int sys_num_dcache_hits (void);
+static int sys_num_dcache_misses (void);
+static int sys_num_extents (int handle);
+static bool sys_fallocate (int handle, unsigned offset, unsigned length);
+static bool sys_fsync (int handle);
+static int sys_pread (int handle, void *udst_, unsigned size, unsigned offset);
+static int sys_pwrite (int handle, void *usrc_, unsigned size,
+                       unsigned offset);
+static int sys_readv (int handle, const struct iovec *uiov, int cnt);
+static int sys_writev (int handle, const struct iovec *uiov, int cnt);
+static int sys_copy_file_range (int in_handle, int out_handle, unsigned size);
+static bool sys_ring_setup (struct ring *uring);
+static int sys_ring_enter (unsigned to_submit);
+static int sys_aio_read (int handle, void *udst, unsigned size,
+                         unsigned offset);
+static int sys_aio_write (int handle, const void *usrc, unsigned size,
+                          unsigned offset);
+static int sys_aio_wait (int id);
+static int sys_aio_poll (int id);
+static int sys_syscall_stats (int scope, struct syscall_stat *ustats,
+                              unsigned cnt);
  
 /* Serializes file system operations. */
 //static struct lock fs_lock;
@@ -52,60 +87,171 @@ void
 syscall_init (void) 
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
+  string_slab_init ();
   //lock_init (&fs_lock);
 }
  
-/* System call handler. */
+typedef int syscall_function (int, int, int, int);
+
+/* A system call. */
+struct syscall 
+  {
+    size_t arg_cnt;           /* Number of arguments. */
+    syscall_function *func;   /* Implementation. */
+    const char *name;         /* Name, for statistics. */
+  };
+
+/* Table of system calls, indexed by number.  Used both by
+   syscall_handler() and by sys_ring_enter() to run queued calls. */
+static const struct syscall syscall_table[] =
+  {
+    {0, (syscall_function *) sys_halt, "halt"},
+    {1, (syscall_function *) sys_exit, "exit"},
+    {1, (syscall_function *) sys_exec, "exec"},
+    {1, (syscall_function *) sys_wait, "wait"},
+    {2, (syscall_function *) sys_create, "create"},
+    {1, (syscall_function *) sys_remove, "remove"},
+    {1, (syscall_function *) sys_open, "open"},
+    {1, (syscall_function *) sys_filesize, "filesize"},
+    {3, (syscall_function *) sys_read, "read"},
+    {3, (syscall_function *) sys_write, "write"},
+    {2, (syscall_function *) sys_seek, "seek"},
+    {1, (syscall_function *) sys_tell, "tell"},
+    {1, (syscall_function *) sys_close, "close"},
+    {1, (syscall_function *) sys_practice, "practice"},
+    {1, (syscall_function *) sys_chdir, "chdir"},
+    {1, (syscall_function *) sys_mkdir, "mkdir"},
+    {2, (syscall_function *) sys_readdir, "readdir"},
+    {1, (syscall_function *) sys_isdir, "isdir"},
+    {1, (syscall_function *) sys_inumber, "inumber"},
+    {0, (syscall_function *) sys_reset_cache, "reset_cache"},
+    {0, (syscall_function *) sys_num_cache_hits, "num_cache_hits"},
+    {0, (syscall_function *) sys_num_cache_accesses, "num_cache_accesses"},
+    {0, (syscall_function *) sys_num_device_reads, "num_device_reads"},
+    {0, (syscall_function *) sys_num_device_writes, "num_device_writes"},
+    {2, NULL, "mmap"},        /* mmap() is not implemented. */
+    {1, NULL, "munmap"},      /* munmap() is not implemented. */
+    {1, (syscall_function *) sys_num_extents, "num_extents"},
+    {3, (syscall_function *) sys_fallocate, "fallocate"},
+    {0, (syscall_function *) sys_num_seek_distance, "num_seek_distance"},
+    {0, (syscall_function *) sys_num_dcache_hits, "num_dcache_hits"},
+    {0, (syscall_function *) sys_num_dcache_misses, "num_dcache_misses"},
+    {3, (syscall_function *) sys_getdents, "getdents"},
+    {1, (syscall_function *) sys_fsync, "fsync"},
+    {4, (syscall_function *) sys_pread, "pread"},
+    {4, (syscall_function *) sys_pwrite, "pwrite"},
+    {3, (syscall_function *) sys_readv, "readv"},
+    {3, (syscall_function *) sys_writev, "writev"},
+    {3, (syscall_function *) sys_copy_file_range, "copy_file_range"},
+    {1, (syscall_function *) sys_ring_setup, "ring_setup"},
+    {1, (syscall_function *) sys_ring_enter, "ring_enter"},
+    {4, (syscall_function *) sys_aio_read, "aio_read"},
+    {4, (syscall_function *) sys_aio_write, "aio_write"},
+    {1, (syscall_function *) sys_aio_wait, "aio_wait"},
+    {1, (syscall_function *) sys_aio_poll, "aio_poll"},
+    {3, (syscall_function *) sys_syscall_stats, "syscall_stats"}
+  };
+
+/* Number of system calls. */
+#define SYSCALL_CNT (sizeof syscall_table / sizeof *syscall_table)
+
+/* Accounting for one system call, kept for the whole system and
+   for each process.  See lib/syscall-stats.h. */
+struct call_stats
+  {
+    unsigned calls;                     /* Number of calls. */
+    long long cycles;                   /* Total cycles across calls. */
+    unsigned hist[SYSCALL_HIST_CNT];    /* Latency histogram. */
+  };
+
+/* Accounting for every process since boot, by system call number.
+   Updated with interrupts off. */
+static struct call_stats global_stats[SYSCALL_CNT];
+
+/* Returns the processor's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Adds a call that took CYCLES cycles to CS. */
 static void
-syscall_handler (struct intr_frame *f) 
+count_call (struct call_stats *cs, uint64_t cycles)
 {
-  typedef int syscall_function (int, int, int);
+  uint64_t c = cycles >> SYSCALL_HIST_SHIFT;
+  int bucket = 0;
 
-  /* A system call. */
-  struct syscall 
+  while (c != 0 && bucket < SYSCALL_HIST_CNT - 1)
     {
-      size_t arg_cnt;           /* Number of arguments. */
-      syscall_function *func;   /* Implementation. */
-    };
+      c >>= 1;
+      bucket++;
+    }
+  cs->calls++;
+  cs->cycles += cycles;
+  cs->hist[bucket]++;
+}
+
+/* Records that system call CALL_NR took CYCLES cycles, for the
+   current process and for the whole system.  The process's
+   accounting is allocated on its first call; if that fails, only
+   the system's is kept. */
+static void
+record_call (unsigned call_nr, uint64_t cycles)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
 
-  /* Table of system calls. */
-  static const struct syscall syscall_table[] =
+  if (cur->call_stats == NULL)
+    cur->call_stats = calloc (SYSCALL_CNT, sizeof *cur->call_stats);
+  if (cur->call_stats != NULL)
+    count_call (&cur->call_stats[call_nr], cycles);
+
+  old_level = intr_disable ();
+  count_call (&global_stats[call_nr], cycles);
+  intr_set_level (old_level);
+}
+
+/* Prints system call statistics for the whole system. */
+void
+syscall_print_stats (void)
+{
+  unsigned calls = 0;
+  long long cycles = 0;
+  size_t i;
+
+  for (i = 0; i < SYSCALL_CNT; i++)
     {
-      {0, (syscall_function *) sys_halt},
-      {1, (syscall_function *) sys_exit},
-      {1, (syscall_function *) sys_exec},
-      {1, (syscall_function *) sys_wait},
-      {2, (syscall_function *) sys_create},
-      {1, (syscall_function *) sys_remove},
-      {1, (syscall_function *) sys_open},
-      {1, (syscall_function *) sys_filesize},
-      {3, (syscall_function *) sys_read},
-      {3, (syscall_function *) sys_write},
-      {2, (syscall_function *) sys_seek},
-      {1, (syscall_function *) sys_tell},
-      {1, (syscall_function *) sys_close},
-      {1, (syscall_function *) sys_practice},
-      {1, (syscall_function *) sys_chdir},
-      {1, (syscall_function *) sys_mkdir},
-      {2, (syscall_function *) sys_readdir},
-      {1, (syscall_function *) sys_isdir},
-      {1, (syscall_function *) sys_inumber},
-      {0, (syscall_function *) sys_reset_cache},
-      {0, (syscall_function *) sys_num_cache_hits},
-      {0, (syscall_function *) sys_num_cache_accesses},
-      {0, (syscall_function *) sys_num_device_reads},
-      {0, (syscall_function *) sys_num_device_writes}
-    };
+      calls += global_stats[i].calls;
+      cycles += global_stats[i].cycles;
+    }
+  printf ("Syscalls: %u calls, %lld cycles\n", calls, cycles);
+  for (i = 0; i < SYSCALL_CNT; i++)
+    if (global_stats[i].calls > 0)
+      printf ("  %s: %u calls, %lld cycles, %lld cycles/call\n",
+              syscall_table[i].name, global_stats[i].calls,
+              global_stats[i].cycles,
+              global_stats[i].cycles / global_stats[i].calls);
+}
 
+/* System call handler. */
+static void
+syscall_handler (struct intr_frame *f) 
+{
   const struct syscall *sc;
   unsigned call_nr;
-  int args[3];
+  int args[4];
+  uint64_t start;
 
   /* Get the system call. */
   copy_in (&call_nr, f->esp, sizeof call_nr);
   if (call_nr >= sizeof syscall_table / sizeof *syscall_table)
     thread_exit ();
   sc = syscall_table + call_nr;
+  if (sc->func == NULL)
+    thread_exit ();
 
   /* Get the system call arguments. */
   ASSERT (sc->arg_cnt <= sizeof args / sizeof *args);
@@ -114,7 +260,9 @@ syscall_handler (struct intr_frame *f)
 
   /* Execute the system call,
      and set the return value. */
-  f->eax = sc->func (args[0], args[1], args[2]);
+  start = rdtsc ();
+  f->eax = sc->func (args[0], args[1], args[2], args[3]);
+  record_call (call_nr, rdtsc () - start);
 }
  
 /* Returns true if UADDR is a valid, mapped user address,
@@ -126,71 +274,166 @@ verify_user (const void *uaddr)
           && pagedir_get_page (thread_current ()->pagedir, uaddr) != NULL);
 }
  
-/* Copies a byte from user address USRC to kernel address DST.
-   USRC must be below PHYS_BASE.
+/* Writes BYTE to user address UDST.
+   UDST must be below PHYS_BASE.
    Returns true if successful, false if a segfault occurred. */
 static inline bool
-get_user (uint8_t *dst, const uint8_t *usrc)
+put_user (uint8_t *udst, uint8_t byte)
 {
   int eax;
-  asm ("movl $1f, %%eax; movb %2, %%al; movb %%al, %0; 1:"
-       : "=m" (*dst), "=&a" (eax) : "m" (*usrc));
+  asm ("movl $1f, %%eax; movb %b2, %0; 1:"
+       : "=m" (*udst), "=&a" (eax) : "q" (byte));
   return eax != 0;
 }
  
-/* Writes BYTE to user address UDST.
-   UDST must be below PHYS_BASE.
+/* Copies SIZE bytes from SRC to DST, either of which may be a user
+   address below PHYS_BASE, a word at a time and then the last few
+   bytes singly.  Each page is checked by the MMU as the copy reaches
+   it; a fault on an unmapped page makes page_fault() resume at the
+   recovery label with EAX zeroed, as for put_user().
    Returns true if successful, false if a segfault occurred. */
 static inline bool
-put_user (uint8_t *udst, uint8_t byte)
+copy_user_bytes (void *dst, const void *src, size_t size)
 {
   int eax;
-  asm ("movl $1f, %%eax; movb %b2, %0; 1:"
-       : "=m" (*udst), "=&a" (eax) : "q" (byte));
+  asm volatile ("movl $1f, %%eax; movl %%ecx, %%edx; shrl $2, %%ecx; "
+                "rep movsl; movl %%edx, %%ecx; andl $3, %%ecx; "
+                "rep movsb; 1:"
+                : "=&a" (eax), "+D" (dst), "+S" (src), "+c" (size)
+                : : "edx", "memory");
   return eax != 0;
 }
- 
+
+/* Returns true if the SIZE bytes at UADDR lie wholly below
+   PHYS_BASE. */
+static inline bool
+is_user_range (const void *uaddr, size_t size)
+{
+  return (uaddr < PHYS_BASE
+          && size <= (size_t) ((uint8_t *) PHYS_BASE - (uint8_t *) uaddr));
+}
+
 /* Copies SIZE bytes from user address USRC to kernel address
    DST.
    Call thread_exit() if any of the user accesses are invalid. */
 static void
-copy_in (void *dst_, const void *usrc_, size_t size) 
+copy_in (void *dst, const void *usrc, size_t size) 
 {
-  uint8_t *dst = dst_;
-  const uint8_t *usrc = usrc_;
- 
-  for (; size > 0; size--, dst++, usrc++) 
-    if (usrc >= (uint8_t *) PHYS_BASE || !get_user (dst, usrc)) 
-      thread_exit ();
+  if (!is_user_range (usrc, size) || !copy_user_bytes (dst, usrc, size))
+    thread_exit ();
 }
- 
+
+/* Copies SIZE bytes from kernel address SRC to user address
+   UDST.
+   Call thread_exit() if any of the user accesses are invalid. */
+static void
+copy_out (void *udst, const void *src, size_t size) 
+{
+  if (!is_user_range (udst, size) || !copy_user_bytes (udst, src, size))
+    thread_exit ();
+}
+
+/* Kernel copies of user strings come from a slab of small buffers
+   carved out of one page, since most are short paths, and only
+   longer ones take a page of their own. */
+#define STRING_SLAB_SIZE 128    /* Bytes per slab buffer. */
+#define STRING_SLAB_CNT (PGSIZE / STRING_SLAB_SIZE)
+static char *string_slab;               /* The slab's page. */
+static char *string_free[STRING_SLAB_CNT]; /* Free slab buffers. */
+static int string_free_cnt;
+static struct lock string_lock;         /* Protects the two above. */
+
+/* Initializes the string slab. */
+static void
+string_slab_init (void)
+{
+  lock_init (&string_lock);
+  string_slab = palloc_get_page (PAL_ASSERT);
+  for (string_free_cnt = 0; string_free_cnt < STRING_SLAB_CNT;
+       string_free_cnt++)
+    string_free[string_free_cnt]
+      = string_slab + string_free_cnt * STRING_SLAB_SIZE;
+}
+
+/* Frees KS, a string returned by copy_in_string(). */
+static void
+free_string (char *ks)
+{
+  if (ks >= string_slab && ks < string_slab + PGSIZE)
+    {
+      lock_acquire (&string_lock);
+      string_free[string_free_cnt++] = ks;
+      lock_release (&string_lock);
+    }
+  else
+    palloc_free_page (ks);
+}
+
+/* Copies user string US into KS, which holds SIZE bytes, starting
+   at byte OFS of both, a page of US at a time.  Returns the
+   string's length if it ends within SIZE bytes, or SIZE if not.
+   Call thread_exit() if any of the user accesses are invalid. */
+static size_t
+copy_in_string_to (char *ks, const char *us, size_t ofs, size_t size)
+{
+  while (ofs < size)
+    {
+      /* Copy through the end of US's page, which is mapped if its
+         first byte is, even past the string's end. */
+      size_t page_left = PGSIZE - pg_ofs (us + ofs);
+      size_t chunk = size - ofs < page_left ? size - ofs : page_left;
+      char *end;
+
+      if (!is_user_range (us + ofs, chunk)
+          || !copy_user_bytes (ks + ofs, us + ofs, chunk))
+        return SIZE_MAX;
+      end = memchr (ks + ofs, '\0', chunk);
+      if (end != NULL)
+        return end - ks;
+      ofs += chunk;
+    }
+  return size;
+}
+
 /* Creates a copy of user string US in kernel memory
-   and returns it as a page that must be freed with
-   palloc_free_page().
+   and returns it; free it with free_string().
    Truncates the string at PGSIZE bytes in size.
    Call thread_exit() if any of the user accesses are invalid. */
 static char *
 copy_in_string (const char *us) 
 {
-  char *ks;
+  char *ks = NULL;
   size_t length;
- 
-  ks = palloc_get_page (0);
-  if (ks == NULL) 
-    thread_exit ();
- 
-  for (length = 0; length < PGSIZE; length++)
+
+  lock_acquire (&string_lock);
+  if (string_free_cnt > 0)
+    ks = string_free[--string_free_cnt];
+  lock_release (&string_lock);
+
+  /* Try the slab buffer first and move to a page if the string
+     does not fit. */
+  length = ks != NULL ? copy_in_string_to (ks, us, 0, STRING_SLAB_SIZE)
+                      : 0;
+  if (ks == NULL || length == STRING_SLAB_SIZE)
     {
-      if (us >= (char *) PHYS_BASE || !get_user (ks + length, us++)) 
-        {
-          palloc_free_page (ks);
-          thread_exit (); 
-        }
-       
-      if (ks[length] == '\0')
-        return ks;
+      char *page = palloc_get_page (0);
+
+      if (page != NULL && ks != NULL)
+        memcpy (page, ks, STRING_SLAB_SIZE);
+      if (ks != NULL)
+        free_string (ks);
+      if (page == NULL)
+        thread_exit ();
+      ks = page;
+      length = copy_in_string_to (ks, us, length, PGSIZE);
+      if (length == PGSIZE)
+        ks[PGSIZE - 1] = '\0';
+    }
+  if (length == SIZE_MAX)
+    {
+      free_string (ks);
+      thread_exit ();
     }
-  ks[PGSIZE - 1] = '\0';
   return ks;
 }
 
@@ -206,6 +449,12 @@ static long long sys_num_device_writes (void)
   return fs_num_writes();
 }
 
+/* Totals the sectors the file system device has seeked across. */
+static long long sys_num_seek_distance (void) 
+{
+  return fs_seek_distance();
+}
+
 
 /* Counts the number of cache hits before sys_reset_cache. */
 static int
@@ -220,10 +469,26 @@ sys_num_cache_accesses (void) {
   return num_cache_accesses();
 }
 
+/* Counts the directory lookups answered by the dentry cache. */
+static int
+sys_num_dcache_hits (void)
+{
+  return dcache_hits ();
+}
+
+/* Counts the directory lookups the dentry cache could not answer. */
+static int
+sys_num_dcache_misses (void)
+{
+  return dcache_misses ();
+}
+
 /* Reset the cache system call. */
 static void 
 sys_reset_cache (void) 
 {
+  inode_flush_all();
+  journal_sync();
   cache_flush();
 }
  
@@ -261,7 +526,7 @@ sys_exec (const char *ufile)
   tid = process_execute (kfile);
   //lock_release (&fs_lock);
  
-  palloc_free_page (kfile);
+  free_string (kfile);
  
   return tid;
 }
@@ -284,7 +549,7 @@ sys_create (const char *ufile, unsigned initial_size)
   ok = filesys_create (kfile, initial_size);
   //lock_release (&fs_lock);
  
-  palloc_free_page (kfile);
+  free_string (kfile);
  
   return ok;
 }
@@ -300,46 +565,83 @@ sys_remove (const char *ufile)
   ok = filesys_remove (kfile);
   //lock_release (&fs_lock);
  
-  palloc_free_page (kfile);
+  free_string (kfile);
  
   return ok;
 }
  
-/* A file descriptor, for binding a file handle to a file. */
+/* A file descriptor, for binding a file handle to a file.  Each
+   process keeps its descriptors in an array indexed by handle,
+   thread_current ()->fds, in which a free slot has a null PTR. */
 struct file_descriptor
   {
-    struct list_elem elem;      /* List element. */
-    //struct file *file;          /* File. */
-    int handle;                 /* File handle. */
-    void *ptr;            /* Directory or File */
+    void *ptr;                  /* Directory or File, null if free. */
     bool f_or_d;                /* 0 if file, 1 if directory */
   };
- 
+
+/* Handles below this one are the console's. */
+#define FIRST_FILE_HANDLE 2
+
+/* Closes the file or directory that FD binds and frees FD's slot. */
+static void
+close_fd (struct file_descriptor *fd)
+{
+  if (fd->f_or_d)
+    dir_close ((struct dir *) fd->ptr);
+  else
+    file_close ((struct file *) fd->ptr);
+  fd->ptr = NULL;
+}
+
+/* Returns the lowest free handle of the running process, doubling
+   its descriptor table if every slot is taken, or -1 if memory
+   runs out.  Handing out the lowest free handle keeps the table no
+   larger than twice the most files the process has had open. */
+static int
+alloc_handle (void)
+{
+  struct thread *cur = thread_current ();
+  int handle;
+
+  for (handle = cur->fd_free; handle < cur->fd_cap; handle++)
+    if (cur->fds[handle].ptr == NULL)
+      break;
+  if (handle >= cur->fd_cap)
+    {
+      int cap = cur->fd_cap < 16 ? 16 : cur->fd_cap * 2;
+      struct file_descriptor *fds = realloc (cur->fds, cap * sizeof *fds);
+
+      if (fds == NULL)
+        return -1;
+      memset (fds + cur->fd_cap, 0, (cap - cur->fd_cap) * sizeof *fds);
+      cur->fds = fds;
+      cur->fd_cap = cap;
+    }
+  cur->fd_free = handle + 1;
+  return handle;
+}
+
 /* Open system call. */
 static int
 sys_open (const char *ufile) 
 {
   char *kfile = copy_in_string (ufile);
-  struct file_descriptor *fd;
+  struct file_descriptor fd;
   int handle = -1;
  
-  fd = malloc (sizeof *fd);
-  if (fd != NULL)
+  //lock_acquire (&fs_lock);
+  fd.ptr = filesys_open (kfile, &fd.f_or_d);
+  if (fd.ptr != NULL)
     {
-      //lock_acquire (&fs_lock);
-      fd->ptr = filesys_open (kfile, &(fd->f_or_d));
-      if (fd->ptr != NULL)
-        {
-          struct thread *cur = thread_current ();
-          handle = fd->handle = cur->next_handle++;
-          list_push_front (&cur->fds, &fd->elem);
-        }
-      else 
-        free (fd);
-      //lock_release (&fs_lock);
+      handle = alloc_handle ();
+      if (handle >= 0)
+        thread_current ()->fds[handle] = fd;
+      else
+        close_fd (&fd);
     }
+  //lock_release (&fs_lock);
   
-  palloc_free_page (kfile);
+  free_string (kfile);
   return handle;
 }
  
@@ -350,18 +652,11 @@ static struct file_descriptor *
 lookup_fd (int handle) 
 {
   struct thread *cur = thread_current ();
-  struct list_elem *e;
-   
-  for (e = list_begin (&cur->fds); e != list_end (&cur->fds);
-       e = list_next (e))
-    {
-      struct file_descriptor *fd;
-      fd = list_entry (e, struct file_descriptor, elem);
-      if (fd->handle == handle)
-        return fd;
-    }
- 
-  thread_exit ();
+
+  if (handle < FIRST_FILE_HANDLE || handle >= cur->fd_cap
+      || cur->fds[handle].ptr == NULL)
+    thread_exit ();
+  return &cur->fds[handle];
 }
  
 /* Filesize system call. */
@@ -529,16 +824,14 @@ sys_tell (int handle)
 static int
 sys_close (int handle) 
 {
+  struct thread *cur = thread_current ();
   struct file_descriptor *fd = lookup_fd (handle);
+
   //lock_acquire (&fs_lock);
-  if (fd->f_or_d) {
-    dir_close((struct dir *) fd->ptr);
-  } else {
-    file_close ((struct file *) fd->ptr);
-  }
+  close_fd (fd);
   //lock_release (&fs_lock);
-  list_remove (&fd->elem);
-  free (fd);
+  if (handle < cur->fd_free)
+    cur->fd_free = handle;
   return 0;
 }
  
@@ -547,35 +840,34 @@ void
 syscall_exit (void) 
 {
   struct thread *cur = thread_current ();
-  struct list_elem *e, *next;
+  int handle;
    
-  for (e = list_begin (&cur->fds); e != list_end (&cur->fds); e = next)
-    {
-      struct file_descriptor *fd;
-      fd = list_entry (e, struct file_descriptor, elem);
-      next = list_next (e);
-      //lock_acquire (&fs_lock);
-      if (fd->f_or_d) {
-        dir_close((struct dir *) fd->ptr);
-      } else {
-        file_close ((struct file *) fd->ptr);
+  for (handle = FIRST_FILE_HANDLE; handle < cur->fd_cap; handle++)
+    if (cur->fds[handle].ptr != NULL)
+      {
+        //lock_acquire (&fs_lock);
+        close_fd (&cur->fds[handle]);
+        //lock_release (&fs_lock);
       }
-      //lock_release (&fs_lock);
-      free (fd);
-    }
+  free (cur->fds);
+  cur->fds = NULL;
+  cur->fd_cap = 0;
+  aio_exit ();
+  free (cur->call_stats);
+  cur->call_stats = NULL;
 }
 
 static bool sys_chdir (const char *dir) {
   char *kfile = copy_in_string (dir);
   bool result = filesys_chdir(kfile);
-  palloc_free_page(kfile);
+  free_string (kfile);
   return result;
 }
 
 static bool sys_mkdir (const char *dir) {
   char *kfile = copy_in_string (dir);
   bool result = filesys_mkdir(kfile);
-  palloc_free_page(kfile);
+  free_string (kfile);
   return result;
 }
 
@@ -600,3 +892,529 @@ static int sys_inumber (int handle) {
   }
   return inode_get_inumber(file_get_inode((struct file *) fd->ptr));
 }
+
+/* Getdents system call.  Reads up to CNT entries from the
+   directory open as HANDLE into the array at UDST, continuing from
+   where the last readdir or getdents left off.  Returns the number
+   of entries read, 0 at the end of the directory, or -1 if HANDLE
+   is not a directory. */
+static int
+sys_getdents (int handle, struct dirent *udst, unsigned cnt)
+{
+  struct file_descriptor *fd = lookup_fd (handle);
+  struct dirent d;
+  block_sector_t sector;
+  unsigned i;
+
+  if (!fd->f_or_d)
+    return -1;
+  for (i = 0; i < cnt; i++)
+    {
+      if (!dir_readdir_entry ((struct dir *) fd->ptr, d.name, &sector,
+                              &d.is_dir))
+        break;
+      d.inumber = sector;
+      copy_out (udst + i, &d, sizeof d);
+    }
+  return i;
+}
+
+/* Counts the extents (contiguous runs of disk blocks) of the file
+   or directory open as HANDLE. */
+static int
+sys_num_extents (int handle)
+{
+  struct file_descriptor *fd = lookup_fd (handle);
+  struct inode *inode;
+
+  if (fd->f_or_d)
+    inode = dir_get_inode ((struct dir *) fd->ptr);
+  else
+    inode = file_get_inode ((struct file *) fd->ptr);
+  return inode_extent_count (inode);
+}
+
+/* Fallocate system call.  Reserves disk sectors for bytes
+   [OFFSET, OFFSET + LENGTH) of the file open as HANDLE, extending
+   it if necessary. */
+static bool
+sys_fallocate (int handle, unsigned offset, unsigned length)
+{
+  struct file_descriptor *fd = lookup_fd (handle);
+
+  if (fd->f_or_d)
+    return false;
+  return inode_allocate (file_get_inode ((struct file *) fd->ptr),
+                         offset, length);
+}
+
+/* Fsync system call.  Writes the dirty blocks of the file or
+   directory open as HANDLE to disk and commits the journal
+   transaction holding its metadata.  Other files' cached blocks are
+   left alone, and concurrent callers share one journal commit. */
+static bool
+sys_fsync (int handle)
+{
+  struct file_descriptor *fd = lookup_fd (handle);
+  struct inode *inode;
+
+  if (fd->f_or_d)
+    inode = dir_get_inode ((struct dir *) fd->ptr);
+  else
+    inode = file_get_inode ((struct file *) fd->ptr);
+  inode_sync (inode);
+  return true;
+}
+
+/* Returns true if SIZE bytes starting at OFFSET all lie at file
+   offsets that an off_t can represent. */
+static bool
+is_file_range (unsigned offset, unsigned size)
+{
+  return offset <= INT_MAX && size <= INT_MAX - offset;
+}
+
+/* Pread system call.  Reads like read(), but from byte OFFSET of the
+   file open as HANDLE, leaving the file position alone, so that
+   random reads take one call and readers sharing a handle do not
+   race on its position.  Returns -1 if the range read would reach
+   past the largest file offset. */
+static int
+sys_pread (int handle, void *udst_, unsigned size, unsigned offset)
+{
+  uint8_t *udst = udst_;
+  struct file_descriptor *fd = lookup_fd (handle);
+  int bytes_read = 0;
+
+  if (fd->f_or_d || !is_file_range (offset, size))
+    return -1;
+  while (size > 0)
+    {
+      /* How much to read into this page? */
+      size_t page_left = PGSIZE - pg_ofs (udst);
+      size_t read_amt = size < page_left ? size : page_left;
+      off_t retval;
+
+      if (!verify_user (udst))
+        thread_exit ();
+      retval = file_read_at ((struct file *) fd->ptr, udst, read_amt,
+                             offset + bytes_read);
+      if (retval < 0)
+        {
+          if (bytes_read == 0)
+            bytes_read = -1;
+          break;
+        }
+      bytes_read += retval;
+      if (retval != (off_t) read_amt)
+        break;
+      udst += retval;
+      size -= retval;
+    }
+  return bytes_read;
+}
+
+/* Pwrite system call.  Writes like write(), but at byte OFFSET of
+   the file open as HANDLE, leaving the file position alone.
+   Returns -1 if the range written would reach past the largest
+   file offset. */
+static int
+sys_pwrite (int handle, void *usrc_, unsigned size, unsigned offset)
+{
+  uint8_t *usrc = usrc_;
+  struct file_descriptor *fd = lookup_fd (handle);
+  int bytes_written = 0;
+
+  if (fd->f_or_d || !is_file_range (offset, size))
+    return -1;
+  while (size > 0)
+    {
+      /* How much to write from this page? */
+      size_t page_left = PGSIZE - pg_ofs (usrc);
+      size_t write_amt = size < page_left ? size : page_left;
+      off_t retval;
+
+      if (!verify_user (usrc))
+        thread_exit ();
+      retval = file_write_at ((struct file *) fd->ptr, usrc, write_amt,
+                              offset + bytes_written);
+      if (retval < 0)
+        {
+          if (bytes_written == 0)
+            bytes_written = -1;
+          break;
+        }
+      bytes_written += retval;
+      if (retval != (off_t) write_amt)
+        break;
+      usrc += retval;
+      size -= retval;
+    }
+  return bytes_written;
+}
+
+/* Copies the CNT-element iovec array at user address UIOV into IOV
+   and checks every page of every buffer it describes, once, so that
+   the file system can then move all the data without further
+   checks.  Returns the total length of the buffers, or -1 if CNT is
+   out of range or the total does not fit in an int.
+   Terminates the process if any buffer is not mapped. */
+static int
+copy_in_iovec (struct iovec *iov, const struct iovec *uiov, int cnt)
+{
+  int total = 0;
+  int i;
+
+  if (cnt < 0 || cnt > IOV_MAX)
+    return -1;
+  copy_in (iov, uiov, cnt * sizeof *iov);
+  for (i = 0; i < cnt; i++)
+    {
+      const uint8_t *start = iov[i].iov_base;
+      const uint8_t *end = start + iov[i].iov_len;
+      const uint8_t *page;
+
+      if (iov[i].iov_len > (size_t) (INT_MAX - total))
+        return -1;
+      total += iov[i].iov_len;
+      if (iov[i].iov_len == 0)
+        continue;
+      if (end < start || end > (uint8_t *) PHYS_BASE)
+        thread_exit ();
+      for (page = pg_round_down (start); page < end; page += PGSIZE)
+        if (!verify_user (page))
+          thread_exit ();
+    }
+  return total;
+}
+
+/* Readv system call.  Reads like read() into the CNT buffers that
+   UIOV describes, filling each before moving to the next.  The
+   buffers are checked once up front and the file is read under one
+   hold of its inode, rather than one call and one check per
+   buffer. */
+static int
+sys_readv (int handle, const struct iovec *uiov, int cnt)
+{
+  struct iovec iov[IOV_MAX];
+  struct file_descriptor *fd;
+  int bytes_read = 0;
+  int i;
+
+  if (copy_in_iovec (iov, uiov, cnt) < 0)
+    return -1;
+
+  /* Handle keyboard reads. */
+  if (handle == STDIN_FILENO)
+    {
+      for (i = 0; i < cnt; i++)
+        {
+          uint8_t *udst = iov[i].iov_base;
+          size_t j;
+
+          for (j = 0; j < iov[i].iov_len; j++)
+            udst[j] = input_getc ();
+          bytes_read += iov[i].iov_len;
+        }
+      return bytes_read;
+    }
+
+  fd = lookup_fd (handle);
+  if (fd->f_or_d)
+    return -1;
+  return file_readv ((struct file *) fd->ptr, iov, cnt);
+}
+
+/* Writev system call.  Writes like write() the CNT buffers that
+   UIOV describes, one after another, checking them once and
+   writing them in one journal transaction under one hold of the
+   file's inode. */
+static int
+sys_writev (int handle, const struct iovec *uiov, int cnt)
+{
+  struct iovec iov[IOV_MAX];
+  struct file_descriptor *fd;
+  int bytes_written = 0;
+  int i;
+
+  if (copy_in_iovec (iov, uiov, cnt) < 0)
+    return -1;
+
+  /* Handle console writes. */
+  if (handle == STDOUT_FILENO)
+    {
+      for (i = 0; i < cnt; i++)
+        {
+          putbuf (iov[i].iov_base, iov[i].iov_len);
+          bytes_written += iov[i].iov_len;
+        }
+      return bytes_written;
+    }
+
+  fd = lookup_fd (handle);
+  if (fd->f_or_d)
+    return -1;
+  return file_writev ((struct file *) fd->ptr, iov, cnt);
+}
+
+/* Copy_file_range system call.  Copies up to SIZE bytes from the
+   file open as IN_HANDLE to the file open as OUT_HANDLE, each at
+   and advancing its own file position, inside the kernel: the data
+   is moved from cache block to cache block instead of being read
+   into a user buffer and written back out of it.  Returns the
+   number of bytes copied, 0 at the end of the input, or -1 if
+   either handle is a directory or both name the same file. */
+static int
+sys_copy_file_range (int in_handle, int out_handle, unsigned size)
+{
+  struct file_descriptor *in = lookup_fd (in_handle);
+  struct file_descriptor *out = lookup_fd (out_handle);
+  struct file *src = (struct file *) in->ptr;
+  struct file *dst = (struct file *) out->ptr;
+
+  if (in->f_or_d || out->f_or_d
+      || file_get_inode (src) == file_get_inode (dst))
+    return -1;
+  if (size > INT_MAX)
+    size = INT_MAX;
+  return file_copy_range (src, dst, size);
+}
+
+/* Returns true if system call CALL_NR may be queued on a ring.
+   Only file calls that return to their caller qualify: not process
+   control, and not the ring calls themselves. */
+static bool
+ring_allowed (unsigned call_nr)
+{
+  switch (call_nr)
+    {
+    case SYS_CREATE:
+    case SYS_REMOVE:
+    case SYS_OPEN:
+    case SYS_FILESIZE:
+    case SYS_READ:
+    case SYS_WRITE:
+    case SYS_SEEK:
+    case SYS_TELL:
+    case SYS_CLOSE:
+    case SYS_PRACTICE:
+    case SYS_FSYNC:
+    case SYS_PREAD:
+    case SYS_PWRITE:
+    case SYS_READV:
+    case SYS_WRITEV:
+    case SYS_COPY_FILE_RANGE:
+      return true;
+    default:
+      return false;
+    }
+}
+
+/* Ring_setup system call.  Registers URING, a struct ring in user
+   memory, as the process's submission and completion ring, or
+   unregisters the current one if URING is null.  Returns false if
+   URING does not lie in user memory. */
+static bool
+sys_ring_setup (struct ring *uring)
+{
+  if (uring != NULL && !is_user_range (uring, sizeof *uring))
+    return false;
+  thread_current ()->ring = uring;
+  return true;
+}
+
+/* Ring_enter system call.  Runs up to TO_SUBMIT calls queued on
+   the process's ring, in order, through the same syscall_table
+   entries a trap would use, and posts a completion for each.  Each
+   call is counted and timed in the statistics as if trapped.  Stops
+   early when the submission queue empties or the completion queue
+   fills.  Returns the number of calls run, or -1 if no ring is
+   registered. */
+static int
+sys_ring_enter (unsigned to_submit)
+{
+  struct ring *uring = thread_current ()->ring;
+  unsigned ctl[4];              /* sq_head, sq_tail, cq_head, cq_tail. */
+  unsigned done;
+
+  if (uring == NULL)
+    return -1;
+
+  copy_in (ctl, uring, sizeof ctl);
+  for (done = 0; done < to_submit; done++)
+    {
+      struct ring_sqe sqe;
+      struct ring_cqe cqe;
+
+      if (ctl[0] == ctl[1] || ctl[3] - ctl[2] >= RING_SIZE)
+        break;
+      copy_in (&sqe, &uring->sq[ctl[0] % RING_SIZE], sizeof sqe);
+      cqe.user_data = sqe.user_data;
+      if (sqe.call_nr < sizeof syscall_table / sizeof *syscall_table
+          && ring_allowed (sqe.call_nr))
+        {
+          uint64_t start = rdtsc ();
+          cqe.result = syscall_table[sqe.call_nr].func (sqe.args[0],
+                                                        sqe.args[1],
+                                                        sqe.args[2],
+                                                        sqe.args[3]);
+          record_call (sqe.call_nr, rdtsc () - start);
+        }
+      else
+        cqe.result = -1;
+      copy_out (&uring->cq[ctl[3] % RING_SIZE], &cqe, sizeof cqe);
+      ctl[0]++;
+      ctl[3]++;
+    }
+  copy_out (&uring->sq_head, &ctl[0], sizeof ctl[0]);
+  copy_out (&uring->cq_tail, &ctl[3], sizeof ctl[3]);
+  return done;
+}
+
+/* Starts an asynchronous transfer of SIZE bytes between the file
+   open as HANDLE, at OFFSET, and user buffer UBUF, reading into
+   UBUF if WRITE is false.  Returns the request's id, or -1 if
+   HANDLE is the console or a directory, SIZE is 0 or more than
+   AIO_MAX_SIZE, the range reaches past the largest file offset,
+   the process already has AIO_MAX_REQUESTS requests outstanding,
+   or memory runs out. */
+static int
+aio_start (int handle, void *ubuf, unsigned size, unsigned offset,
+           bool write)
+{
+  struct file_descriptor *fd;
+  struct aio_request *r;
+
+  if (handle == STDIN_FILENO || handle == STDOUT_FILENO)
+    return -1;
+  fd = lookup_fd (handle);
+  if (fd->f_or_d || size == 0 || size > AIO_MAX_SIZE
+      || !is_file_range (offset, size)
+      || list_size (&thread_current ()->aio_requests) >= AIO_MAX_REQUESTS)
+    return -1;
+  if (!is_user_range (ubuf, size))
+    thread_exit ();
+
+  r = malloc (sizeof *r);
+  if (r == NULL)
+    return -1;
+  r->buffer = malloc (size);
+  if (r->buffer == NULL)
+    {
+      free (r);
+      return -1;
+    }
+  if (write && !copy_user_bytes (r->buffer, ubuf, size))
+    {
+      free (r->buffer);
+      free (r);
+      thread_exit ();
+    }
+  r->file = file_reopen ((struct file *) fd->ptr);
+  if (r->file == NULL)
+    {
+      free (r->buffer);
+      free (r);
+      return -1;
+    }
+  r->write = write;
+  r->udst = write ? NULL : ubuf;
+  r->size = size;
+  r->offset = offset;
+  return aio_submit (r);
+}
+
+/* Aio_read system call.  Starts reading SIZE bytes from the file
+   open as HANDLE, at OFFSET, into UDST, and returns at once with a
+   request id to pass to aio_wait(), which finishes the read.  The
+   read goes through a kernel buffer and reaches UDST only during
+   aio_wait().  Returns -1 on failure. */
+static int
+sys_aio_read (int handle, void *udst, unsigned size, unsigned offset)
+{
+  return aio_start (handle, udst, size, offset, false);
+}
+
+/* Aio_write system call.  Copies SIZE bytes from USRC and starts
+   writing them to the file open as HANDLE at OFFSET, returning at
+   once with a request id to pass to aio_wait().  USRC may be
+   reused as soon as the call returns.  Returns -1 on failure. */
+static int
+sys_aio_write (int handle, const void *usrc, unsigned size,
+               unsigned offset)
+{
+  return aio_start (handle, (void *) usrc, size, offset, true);
+}
+
+/* Aio_wait system call.  Waits for request ID to finish, copies
+   the data of a read out to its buffer, and forgets the request.
+   Returns the number of bytes transferred, or -1 if the transfer
+   failed or there is no request ID. */
+static int
+sys_aio_wait (int id)
+{
+  struct aio_request *r = aio_find (id);
+  int result;
+  bool ok;
+
+  if (r == NULL)
+    return -1;
+  aio_wait (r);
+  result = r->result;
+  ok = (r->write || result <= 0
+        || copy_user_bytes (r->udst, r->buffer, result));
+  aio_release (r);
+  if (!ok)
+    thread_exit ();
+  return result;
+}
+
+/* Aio_poll system call.  Returns 1 if request ID has finished, so
+   that aio_wait() will not block, 0 if it is still in progress,
+   or -1 if there is no request ID. */
+static int
+sys_aio_poll (int id)
+{
+  struct aio_request *r = aio_find (id);
+
+  if (r == NULL)
+    return -1;
+  return r->done;
+}
+
+/* Syscall_stats system call.  Copies accounting for up to CNT
+   system calls, in system call number order, to USTATS: for the
+   calling process if SCOPE is SYSCALL_STATS_SELF, or for every
+   process since boot if it is SYSCALL_STATS_ALL.  Returns the
+   number of system calls there are, or -1 if SCOPE is neither. */
+static int
+sys_syscall_stats (int scope, struct syscall_stat *ustats, unsigned cnt)
+{
+  const struct call_stats *src;
+  size_t i;
+
+  if (scope == SYSCALL_STATS_SELF)
+    src = thread_current ()->call_stats;
+  else if (scope == SYSCALL_STATS_ALL)
+    src = global_stats;
+  else
+    return -1;
+
+  for (i = 0; i < cnt && i < SYSCALL_CNT; i++)
+    {
+      struct syscall_stat st;
+
+      memset (&st, 0, sizeof st);
+      strlcpy (st.name, syscall_table[i].name, sizeof st.name);
+      if (src != NULL)
+        {
+          enum intr_level old_level = intr_disable ();
+          st.calls = src[i].calls;
+          st.cycles = src[i].cycles;
+          memcpy (st.hist, src[i].hist, sizeof st.hist);
+          intr_set_level (old_level);
+        }
+      copy_out (&ustats[i], &st, sizeof st);
+    }
+  return SYSCALL_CNT;
+}
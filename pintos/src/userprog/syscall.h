@@ -3,5 +3,6 @@
 
 void syscall_init (void);
 void syscall_exit (void);
+void syscall_print_stats (void);
 
 #endif /* userprog/syscall.h */
@@ -2,6 +2,7 @@
 #include <debug.h>
 #include <stddef.h>
 #include "userprog/gdt.h"
+#include "threads/intr-stubs.h"
 #include "threads/thread.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
@@ -75,6 +76,31 @@ struct tss
 /* Kernel TSS. */
 static struct tss *tss;
 
+/* Model-specific registers that set up SYSENTER.  See [IA32-v3a]
+   5.8.7 "Performing Fast Calls to System Procedures with the
+   SYSENTER and SYSEXIT Instructions". */
+#define MSR_SYSENTER_CS 0x174   /* Kernel code selector. */
+#define MSR_SYSENTER_ESP 0x175  /* Kernel stack pointer. */
+#define MSR_SYSENTER_EIP 0x176  /* Entry point. */
+
+/* Writes VALUE to model-specific register MSR. */
+static inline void
+wrmsr (uint32_t msr, uint32_t value)
+{
+  asm volatile ("wrmsr" : : "c" (msr), "a" (value), "d" (0));
+}
+
+/* Returns true if the processor has SYSENTER and SYSEXIT, as the
+   SEP bit of CPUID function 1 reports. */
+static bool
+has_sysenter (void)
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  return (edx & (1u << 11)) != 0;
+}
+
 /* Initializes the kernel TSS. */
 void
 tss_init (void) 
@@ -86,6 +112,19 @@ tss_init (void)
   tss->ss0 = SEL_KDSEG;
   tss->bitmap = 0xdfff;
   tss_update ();
+
+  /* SYSENTER loads its stack pointer straight from the MSR, which
+     cannot follow thread switches the way esp0 does.  Point it at
+     esp0 instead and let sysenter_entry load the stack from there.
+     SYSENTER also takes the kernel data selector and SYSEXIT the
+     user selectors from fixed offsets above SEL_KCSEG, which the
+     GDT's layout satisfies. */
+  if (has_sysenter ())
+    {
+      wrmsr (MSR_SYSENTER_CS, SEL_KCSEG);
+      wrmsr (MSR_SYSENTER_ESP, (uint32_t) &tss->esp0);
+      wrmsr (MSR_SYSENTER_EIP, (uint32_t) sysenter_entry);
+    }
 }
 
 /* Returns the kernel TSS. */